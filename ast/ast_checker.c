@@ -2,58 +2,113 @@
 #include "special_nodes.h"
 #include "token.h"
 #include <stdio.h>
-#include "da.h"
+#include "arena.h"
 #include <stdarg.h>
 #include "macros.h"
+#include "da.h"
+
+#define NOT_FOUND ((u32)-1)
+
+typedef struct {
+    Token name;
+    NodeIdx type;
+    isize scope;
+    u32 shadowed; // previous local with the same name or NOT_FOUND
+} LocalSymbol;
+
+typedef struct {
+    LocalSymbol *items;
+    usize count;
+    usize capacity;
+} LocalStack;
+
+typedef struct {
+    Token name;
+    NodeIdx decl;   // NULL_NODE for imported functions
+    ImportedFunction *import;
+    b32 proto;
+    usize idx;
+} FunctionSymbol;
+
+typedef struct {
+    FunctionSymbol *items;
+    size_t count;
+    size_t capacity;
+} FunctionTable;
 
 typedef struct {
     b32 error;
     b32 panic;
     b32 in_func;
-    AstNode *fn_ret_type;
+    NodeIdx fn_ret_type;
     b32 had_return;
     isize scope;
+    Arena arena; // symbol tables
+    Ast *ast;
+
+    // Types of the globals in declaration order, which is also
+    // the order the converter gives them their slots in
+    AstNodeArray global_types;
+    SymbolMap global_symbols; // name -> index into global_types
+
+    // Locals live on a stack, 'local_heads' maps a name to the innermost
+    // local with that name. Popping a local puts back the one it shadowed.
+    // A local's index in the stack is the frame slot the converter gives it.
+    LocalStack local_symbols;
+    SymbolMap local_heads;
+
+    FunctionTable global_functions;
+    SymbolMap function_idx; // name -> index into global_functions
+
+    Imports *imports;
+    usize next_import; // import declarations are met in source order
 } Checker;
 
-static Checker checker;
+#define CHECKER_ARENA_SIZE (16 * 1024)
 
 static inline
-void scope(void) {
-    checker.scope++;
+void scope(Checker *checker) {
+    checker->scope++;
 }
 
+static void _pop_locals(Checker *checker);
+
 static inline
-void rm_scope(void) {
-    checker.scope--;
+void rm_scope(Checker *checker) {
+    checker->scope--;
+    _pop_locals(checker);
 }
 
 static inline
-void _init_checker(void) {
-    checker = (Checker) {0};
+void _init_checker(Checker *checker, Ast *ast, Imports *imports) {
+    *checker = (Checker) {0};
+    checker->ast = ast;
+    checker->imports = imports;
+    checker->arena = arena_init(CHECKER_ARENA_SIZE);
 }
 
-#define no_panic(retval) do { if (checker.panic) return retval; } while (0)
+#define no_panic(retval) do { if (checker->panic) return retval; } while (0)
 
 static 
-void _semantic_error(const byte *fmt, ...) {
+void _semantic_error(Checker *checker, const byte *fmt, ...) {
     fprintf(stderr, "Semantic error: ");
     va_list args;
     va_start(args, fmt);
     vfprintf(stderr, fmt, args);
     va_end(args);
     fputc('\n', stderr);
-    checker.error = true;
-    checker.panic = true;
+    checker->error = true;
+    checker->panic = true;
 }
 
 static
-b32 _any_type(AstNode *node, i32 count, ...) {
+b32 _any_type(Checker *checker, NodeIdx node, i32 count, ...) {
     va_list args;
     va_start(args, count);
 
     for (int i = 0; i < count; ++i) {
         AstNodeType type = va_arg(args, AstNodeType);
-        if (node->ast_type == type) {
+        if (ast_type(checker->ast, node) == type) {
             va_end(args);
             return true;
         }
@@ -64,491 +119,563 @@ b32 _any_type(AstNode *node, i32 count, ...) {
 }
 
 static inline
-b32 _token_eq(Token a, Token b) {
-    return a.str.len == b.str.len &&
-        memcmp(a.str.s, b.str.s, a.str.len) == 0;
+s8 _str(Checker *checker, Token t) {
+    return token_str(checker->ast, t);
 }
 
-typedef struct {
-    Token name;
-    AstNode *type;
-} Symbol;
+static inline
+u32 _line(Checker *checker, Token t) {
+    return token_line(checker->ast, t);
+}
 
-typedef struct {
-    Symbol *items;
-    size_t count;
-    size_t capacity;
-} SymbolTable;
+// Identifiers are interned by the scanner
+static inline
+b32 _token_eq(Token a, Token b) {
+    return a.sym == b.sym;
+}
 
-static SymbolTable global_symbols;
 
-void _init_global(void) {
-    global_symbols = (SymbolTable) {0};
+static
+u32 _find_global(Checker *checker, Token name) {
+    return symbol_map_get(&checker->global_symbols, name.sym, NOT_FOUND);
 }
 
 static
-AstNode *_lookup_global(Token name) {
-    for (size_t i = 0; i < global_symbols.count; ++i) {
-        if (_token_eq(global_symbols.items[i].name, name))
-            return global_symbols.items[i].type;
-    }
-    return NULL;
+NodeIdx _lookup_global(Checker *checker, Token name) {
+    u32 idx = _find_global(checker, name);
+    return idx == NOT_FOUND ? NULL_NODE : checker->global_types.items[idx];
 }
 
 static inline
-void _add_global(Token name, AstNode *type) {
-    Symbol s = {.name = name, .type = type};
-    da_append(&global_symbols, s);
+void _add_global(Checker *checker, Token name, NodeIdx type) {
+    symbol_map_put(&checker->global_symbols, name.sym, checker->global_types.count);
+    arena_da_append(&checker->arena, &checker->global_types, type);
 }
 
-typedef struct {
-    Token name;
-    AstNode *type;
-    isize scope;
-} LocalSymbol;
 
-typedef struct {
-    LocalSymbol *items;
-    usize count;
-    usize capacity;
-} LocalStack;
 
-static LocalStack local_symbols;
+static void _pop_local(Checker *checker) {
+    LocalSymbol *local = &checker->local_symbols.items[--checker->local_symbols.count];
+    symbol_map_put(&checker->local_heads, local->name.sym, local->shadowed);
+}
 
-static void _init_local(void) {
-    local_symbols = (LocalStack) {0};
+static void _pop_locals(Checker *checker) {
+    while (checker->local_symbols.count > 0 &&
+           da_last(&checker->local_symbols).scope > checker->scope)
+        _pop_local(checker);
 }
 
-static void _clear_local(void) {
-    local_symbols.count = 0;
+static void _clear_local(Checker *checker) {
+    while (checker->local_symbols.count > 0) _pop_local(checker);
 }
 
-static void _push_local(LocalSymbol local) {
-    da_append(&local_symbols, local);
+static void _push_local(Checker *checker, LocalSymbol local) {
+    local.shadowed = symbol_map_get(&checker->local_heads, local.name.sym, NOT_FOUND);
+    symbol_map_put(&checker->local_heads, local.name.sym, checker->local_symbols.count);
+    arena_da_append(&checker->arena, &checker->local_symbols, local);
 }
 
-static LocalSymbol _new_local(Token name, AstNode *type) {
+static LocalSymbol _new_local(Checker *checker, Token name, NodeIdx type) {
     return (LocalSymbol) {
         .name = name,
         .type = type,
-        .scope = checker.scope,
+        .scope = checker->scope,
     };
 }
 
-static AstNode *_lookup_local(Token name) {
-    for (size_t i = 0; i < local_symbols.count; ++i) {
-        if (_token_eq(local_symbols.items[i].name, name) 
-            && local_symbols.items[i].scope <= checker.scope)
-            return local_symbols.items[i].type;
-    }
-    return NULL;
+static u32 _find_local(Checker *checker, Token name) {
+    return symbol_map_get(&checker->local_heads, name.sym, NOT_FOUND);
 }
 
-typedef struct {
-    Token name;
-    AstNode *decl;
-    b32 proto;
-    usize idx;
-} FunctionSymbol;
+static NodeIdx _lookup_local(Checker *checker, Token name) {
+    u32 idx = _find_local(checker, name);
+    if (idx == NOT_FOUND) return NULL_NODE;
+    return checker->local_symbols.items[idx].type;
+}
 
-typedef struct {
-    FunctionSymbol *items;
-    size_t count;
-    size_t capacity;
-} FunctionTable;
 
-static FunctionTable global_functions;
 
-static void _init_functions(void) {
-    global_functions = (FunctionTable){0};
+static FunctionSymbol *_lookup_function(Checker *checker, Token name) {
+    u32 idx = symbol_map_get(&checker->function_idx, name.sym, NOT_FOUND);
+    if (idx == NOT_FOUND) return NULL;
+    return &checker->global_functions.items[idx];
 }
 
-static FunctionSymbol *_lookup_function(Token name) {
-    for (size_t i = 0; i < global_functions.count; ++i) {
-        if (_token_eq(global_functions.items[i].name, name))
-            return &global_functions.items[i];
+static usize _add_function(Checker *checker, Token name, NodeIdx decl, b32 proto, isize idx) {
+    if (idx >= 0) {
+        checker->global_functions.items[idx].proto = proto;
+        return idx;
     }
-    return NULL;
+    idx = checker->global_functions.count;
+    FunctionSymbol s = {.name = name, .decl = decl, .proto = proto, .idx = idx};
+    arena_da_append(&checker->arena, &checker->global_functions, s);
+    symbol_map_put(&checker->function_idx, name.sym, idx);
+    return idx;
 }
 
-static void _add_function(Token name, AstNode *decl, b32 proto, isize idx) {
-    if (idx >= 0) {
-        global_functions.items[idx].proto = proto;
-        return;
+// Imported functions have no declaration in this Ast,
+// their types are builtin ones
+static
+NodeIdx _builtin_type(u8 type) {
+    switch (type) {
+        case AST_TYPE_NUM:    return BUILTIN_NUM_TYPE;
+        case AST_TYPE_STRING: return BUILTIN_STRING_TYPE;
+        case AST_TYPE_BOOL:   return BUILTIN_BOOL_TYPE;
+        case AST_TYPE_VOID:   return BUILTIN_VOID_TYPE;
+        default: UNREACHABLE();
     }
-    idx = global_functions.count;
-    FunctionSymbol s = {.name = name, .decl = decl, .proto = proto, .idx = idx};
-    da_append(&global_functions, s);
 }
 
-static PrimitiveTypeNode sentinel_type;
+static
+void _import_functions(Checker *checker, ImportedFunctions *functions) {
+    for (usize i = 0; i < functions->count; ++i) {
+        ImportedFunction *import = &functions->items[i];
+        FunctionSymbol *existing = _lookup_function(checker, (Token) { .sym = import->sym });
+        if (existing != NULL) {
+            // The same module imported twice, the names point into its text
+            if (existing->import != NULL && existing->import->name.s == import->name.s) {
+                import->idx = existing->idx;
+                continue;
+            }
+            _semantic_error(checker, "imported function '%.*s' is already declared",
+                (i32)import->name.len, import->name.s);
+            return;
+        }
+
+        usize idx = checker->global_functions.count;
+        FunctionSymbol s = {.name = {.sym = import->sym}, .decl = NULL_NODE, .import = import, .idx = idx};
+        arena_da_append(&checker->arena, &checker->global_functions, s);
+        symbol_map_put(&checker->function_idx, import->sym, idx);
+        import->idx = idx;
+    }
+}
+
+static NodeIdx _check_node(Checker *checker, NodeIdx node);
+
+// Literals stand for their own type, the checker only needs
+// to know which builtin type that is
 static inline
-AstNode *_get_type_of(AstNode *node) {
-    switch (node->ast_type) {
-        case AST_LITERAL_NUMBER:
-            sentinel_type.this.ast_type = AST_TYPE_NUM;
-            return (AstNode *)&sentinel_type;
-        case AST_LITERAL_STRING:
-            sentinel_type.this.ast_type = AST_TYPE_STRING;
-            return (AstNode *)&sentinel_type;
-        case AST_LITERAL_BOOL:
-            sentinel_type.this.ast_type = AST_TYPE_BOOL;
-            return (AstNode *)&sentinel_type;
-        default:
-            return node;
+NodeIdx _get_type_of(Checker *checker, NodeIdx node) {
+    switch (ast_type(checker->ast, node)) {
+        case AST_LITERAL_NUMBER: return BUILTIN_NUM_TYPE;
+        case AST_LITERAL_STRING: return BUILTIN_STRING_TYPE;
+        case AST_LITERAL_BOOL:   return BUILTIN_BOOL_TYPE;
+        default:                 return node;
     }
 }
 
 static inline
-b32 _types_compatible(AstNode *lhs_type, AstNode *rhs_type) {
-    if (!lhs_type || !rhs_type) return false;
-    return _get_type_of(lhs_type)->ast_type == _get_type_of(rhs_type)->ast_type;
+b32 _types_compatible(Checker *checker, NodeIdx lhs_type, NodeIdx rhs_type) {
+    if (lhs_type == NULL_NODE || rhs_type == NULL_NODE) return false;
+    return ast_type(checker->ast, _get_type_of(checker, lhs_type)) ==
+           ast_type(checker->ast, _get_type_of(checker, rhs_type));
 }
 
-static AstNode *_lookup_var(Token name) {
-    AstNode *local = _lookup_local(name);
-    if (local) return local;
+static
+NodeIdx _check_imported_call(Checker *checker, Token callee, AstNodeArray args, ImportedFunction *fn) {
+    if (fn->param_count != args.count) {
+        _semantic_error(checker, "Number of arguments to '%.*s' at line %d "
+                        "does not match the number of parameters of imported function '%.*s'",
+            (i32)_str(checker, callee).len, _str(checker, callee).s, _line(checker, callee),
+            (i32)fn->name.len, fn->name.s);
+        return NULL_NODE;
+    }
+
+    for (usize i = 0; i < args.count; ++i) {
+        NodeIdx arg_type = _check_node(checker, args.items[i]);
+        no_panic(arg_type);
 
-    return _lookup_global(name);
+        if (!_types_compatible(checker, _builtin_type(fn->param_types[i]), arg_type)) {
+            _semantic_error(checker, "The type of argument(idx: %d) for function '%.*s' at line %d "
+                            "does not match the type of the parameter of imported function '%.*s'",
+                i, (i32)_str(checker, callee).len, _str(checker, callee).s, _line(checker, callee),
+                (i32)fn->name.len, fn->name.s);
+            return NULL_NODE;
+        }
+    }
+
+    return _builtin_type(fn->return_type);
+}
+
+// Locals shadow globals
+static NodeIdx _resolve_var(Checker *checker, Token name, Binding *binding) {
+    u32 idx = _find_local(checker, name);
+    if (idx != NOT_FOUND) {
+        *binding = (Binding) { BIND_LOCAL, idx };
+        return checker->local_symbols.items[idx].type;
+    }
+
+    idx = _find_global(checker, name);
+    if (idx != NOT_FOUND) {
+        *binding = (Binding) { BIND_GLOBAL, idx };
+        return checker->global_types.items[idx];
+    }
+
+    return NULL_NODE;
 }
 
+#define TYPE(n) ast_type(checker->ast, (n))
+
 static
-AstNode *_check_node(AstNode *node) {
-    no_panic(NULL);
-    if (!node) return NULL;
+NodeIdx _check_node(Checker *checker, NodeIdx node) {
+    no_panic(NULL_NODE);
+    if (node == NULL_NODE) return NULL_NODE;
 
-    switch (node->ast_type) {
+    Ast *ast = checker->ast;
+    switch (TYPE(node)) {
         case AST_PROGRAM: {
-            ProgramNode *prog = (ProgramNode *)node;
-            for (usize i = 0; i < prog->declarations.count; ++i) {
-                _check_node(prog->declarations.items[i]);
-                checker.panic = false; // Reset panic for next declaration
+            ProgramNode prog = get_program_node(ast, node);
+            for (usize i = 0; i < prog.declarations.count; ++i) {
+                _check_node(checker, prog.declarations.items[i]);
+                checker->panic = false; // Reset panic for next declaration
             }
-            return NULL;
+            return NULL_NODE;
         }
 
         case AST_FUNCTION_DECL: {
-            FunctionDeclNode *fn = (FunctionDeclNode *)node;
+            FunctionDeclNode fn = get_function_decl_node(ast, node);
 
-            AstNodeArray params = ((ParameterListNode *) fn->parameters)->parameters;
+            AstNodeArray params = get_parameter_list_node(ast, fn.parameters).parameters;
             for (usize i = 0; i < params.count; ++i) {
-                ParameterNode *param_i = (ParameterNode *)params.items[i];
+                ParameterNode param_i = get_parameter_node(ast, params.items[i]);
                 for (usize j = i + 1; j < params.count; ++j) {
-                    ParameterNode *param_j = (ParameterNode *)params.items[j];
-                    if (_token_eq(param_i->name, param_j->name)) {
-                        _semantic_error("duplicate parameter name '%.*s' in function '%.*s' at line %d",
-                            (i32)param_i->name.str.len, param_i->name.str.s,
-                            (i32)fn->name.str.len, fn->name.str.s, fn->name.line);
-                        return NULL;
+                    ParameterNode param_j = get_parameter_node(ast, params.items[j]);
+                    if (_token_eq(param_i.name, param_j.name)) {
+                        _semantic_error(checker, "duplicate parameter name '%.*s' in function '%.*s' at line %d",
+                            (i32)_str(checker, param_i.name).len, _str(checker, param_i.name).s,
+                            (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name));
+                        return NULL_NODE;
                     }
                 }
             }
 
-            FunctionSymbol *fn_symbol = _lookup_function(fn->name);
+            FunctionSymbol *fn_symbol = _lookup_function(checker, fn.name);
             if (fn_symbol) {
                 if (!fn_symbol->proto) {
-                    _semantic_error("redeclaration of function '%.*s' at line %d",
-                        (i32)fn->name.str.len, fn->name.str.s, fn->name.line);
-                    return NULL;
+                    if (fn_symbol->import != NULL) {
+                        _semantic_error(checker, "function '%.*s' at line %d is already imported",
+                            (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name));
+                        return NULL_NODE;
+                    }
+                    _semantic_error(checker, "redeclaration of function '%.*s' at line %d",
+                        (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name));
+                    return NULL_NODE;
                 }
             }
 
             if (fn_symbol) {
-                FunctionDeclNode * fn_sym_decl = (FunctionDeclNode *)fn_symbol->decl;
-                AstNode *fn_sym_type = fn_sym_decl->return_type;
-                if (!_types_compatible(fn_sym_type, fn->return_type)) {
-                    _semantic_error("return type of function '%.*s' at line %d does "
+                FunctionDeclNode fn_sym_decl = get_function_decl_node(ast, fn_symbol->decl);
+                NodeIdx fn_sym_type = fn_sym_decl.return_type;
+                if (!_types_compatible(checker, fn_sym_type, fn.return_type)) {
+                    _semantic_error(checker, "return type of function '%.*s' at line %d does "
                                     "not match the one defined previously at line %d",
-                        (i32)fn->name.str.len, fn->name.str.s, fn->name.line,
-                        ((PrimitiveTypeNode *)fn_sym_type)->type_token.line);
-                    return NULL;
+                        (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name),
+                        _line(checker, get_primitive_type_node(ast, fn_sym_type).type_token));
+                    return NULL_NODE;
                 }
             }
 
             if (fn_symbol) {
-                FunctionDeclNode * fn_sym_decl = (FunctionDeclNode *)fn_symbol->decl;
-                AstNodeArray fn_sym_params = ((ParameterListNode *)fn_sym_decl->parameters)->parameters;
+                FunctionDeclNode fn_sym_decl = get_function_decl_node(ast, fn_symbol->decl);
+                AstNodeArray fn_sym_params = get_parameter_list_node(ast, fn_sym_decl.parameters).parameters;
 
                 if (fn_sym_params.count != params.count) {
-                    _semantic_error("number of parameters of function '%.*s' at line %d "
+                    _semantic_error(checker, "number of parameters of function '%.*s' at line %d "
                                     "does not match the one defined previously at line %d",
-                        (i32)fn->name.str.len, fn->name.str.s, fn->name.line,
-                            fn_sym_decl->name.line);
-                    return NULL;
+                        (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name),
+                            _line(checker, fn_sym_decl.name));
+                    return NULL_NODE;
                 }
 
                 for (usize i = 0; i < params.count; ++i) {
-                    ParameterNode *param_a = (ParameterNode *)params.items[i];
-                    ParameterNode *param_b = (ParameterNode *)fn_sym_params.items[i];
+                    ParameterNode param_a = get_parameter_node(ast, params.items[i]);
+                    ParameterNode param_b = get_parameter_node(ast, fn_sym_params.items[i]);
 
-                    if (!_token_eq(param_a->name, param_b->name)) {
-                        _semantic_error("name of parameter '%.*s' of function '%.*s' at line %d "
+                    if (!_token_eq(param_a.name, param_b.name)) {
+                        _semantic_error(checker, "name of parameter '%.*s' of function '%.*s' at line %d "
                                         "does not match the name of parameter '%.*s' at line %d",
-                            (i32)param_a->name.str.len, param_a->name.str.s,
-                            (i32)fn->name.str.len, fn->name.str.s, fn->name.line,
-                            (i32)param_b->name.str.len, param_b->name.str.s,
-                             fn_sym_decl->name.line);
-                        return NULL;
+                            (i32)_str(checker, param_a.name).len, _str(checker, param_a.name).s,
+                            (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name),
+                            (i32)_str(checker, param_b.name).len, _str(checker, param_b.name).s,
+                             _line(checker, fn_sym_decl.name));
+                        return NULL_NODE;
                     }
 
-                    if (!_types_compatible(param_a->type, param_b->type)) {
-                        _semantic_error("type of parameter '%.*s' of function '%.*s' at line %d "
+                    if (!_types_compatible(checker, param_a.type, param_b.type)) {
+                        _semantic_error(checker, "type of parameter '%.*s' of function '%.*s' at line %d "
                                         "does not match the type of parameter '%.*s' at line %d",
-                            (i32)param_a->name.str.len, param_a->name.str.s,
-                            (i32)fn->name.str.len, fn->name.str.s, fn->name.line,
-                            (i32)param_b->name.str.len, param_b->name.str.s,
-                             fn_sym_decl->name.line);
-                        return NULL;
+                            (i32)_str(checker, param_a.name).len, _str(checker, param_a.name).s,
+                            (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name),
+                            (i32)_str(checker, param_b.name).len, _str(checker, param_b.name).s,
+                             _line(checker, fn_sym_decl.name));
+                        return NULL_NODE;
                     }
                 }
             }
 
             isize idx = fn_symbol ? fn_symbol->idx : -1;
-            _add_function(fn->name, node, fn->body == NULL, idx);
+            idx = _add_function(checker, fn.name, node, fn.body == NULL_NODE, idx);
+            set_function_decl_idx(ast, node, idx);
 
-            if (fn->body) {
+            if (fn.body != NULL_NODE) {
                 for (usize i = 0; i < params.count; ++i) {
-                    ParameterNode *param = (ParameterNode *)params.items[i];
-                    _push_local(_new_local(param->name, param->type));
+                    ParameterNode param = get_parameter_node(ast, params.items[i]);
+                    _push_local(checker, _new_local(checker, param.name, param.type));
                 }
-                checker.in_func = true;
-                checker.fn_ret_type = fn->return_type;
-                checker.had_return = false;
+                checker->in_func = true;
+                checker->fn_ret_type = fn.return_type;
+                checker->had_return = false;
 
-                _check_node(fn->body);
+                _check_node(checker, fn.body);
 
-                if (fn->return_type->ast_type != AST_TYPE_VOID &&
-                    !checker.had_return) {
-                    _semantic_error("function '%.*s' at line %d does "
+                if (TYPE(fn.return_type) != AST_TYPE_VOID &&
+                    !checker->had_return) {
+                    _semantic_error(checker, "function '%.*s' at line %d does "
                                     "not have a return statement",
-                        (i32)fn->name.str.len, fn->name.str.s, fn->name.line);
-                    return NULL;
+                        (i32)_str(checker, fn.name).len, _str(checker, fn.name).s, _line(checker, fn.name));
+                    return NULL_NODE;
                 }
 
-                checker.in_func = false;
-                _clear_local();
-                no_panic(NULL);
+                checker->in_func = false;
+                _clear_local(checker);
+                no_panic(NULL_NODE);
             }
 
-            return NULL;
+            return NULL_NODE;
+        }
+
+        case AST_IMPORT: {
+            if (checker->imports == NULL || checker->next_import >= checker->imports->count) UNREACHABLE();
+            _import_functions(checker, &checker->imports->items[checker->next_import++]);
+            return NULL_NODE;
         }
 
         case AST_BLOCK: {
-            BlockNode *block = (BlockNode *)node;
-            scope();
-            for (usize i = 0; i < block->statements.count; ++i) {
-                _check_node(block->statements.items[i]);
-                checker.panic = false;
-            }
-            rm_scope();
-            return NULL;
+            BlockNode block = get_block_node(ast, node);
+            scope(checker);
+            for (usize i = 0; i < block.statements.count; ++i) {
+                _check_node(checker, block.statements.items[i]);
+                checker->panic = false;
+            }
+            rm_scope(checker);
+            return NULL_NODE;
         }
 
         case AST_RETURN_STMT: {
-            ReturnStmtNode *ret = (ReturnStmtNode *)node;
-            checker.had_return = true;
+            ReturnStmtNode ret = get_return_stmt_node(ast, node);
+            checker->had_return = true;
 
-            if (ret->expression && checker.fn_ret_type->ast_type == AST_TYPE_VOID ) {
-                _semantic_error("returning from a void function");
-                return NULL;
+            if (ret.expression != NULL_NODE && TYPE(checker->fn_ret_type) == AST_TYPE_VOID ) {
+                _semantic_error(checker, "returning from a void function");
+                return NULL_NODE;
             }
 
-            if (!ret->expression && checker.fn_ret_type->ast_type != AST_TYPE_VOID ) {
-                _semantic_error("not returning from a non-void function");
-                return NULL;
+            if (ret.expression == NULL_NODE && TYPE(checker->fn_ret_type) != AST_TYPE_VOID ) {
+                _semantic_error(checker, "not returning from a non-void function");
+                return NULL_NODE;
             }
 
-            if (!ret->expression) return NULL;
+            if (ret.expression == NULL_NODE) return NULL_NODE;
 
-            AstNode *ret_type = _check_node(ret->expression);
+            NodeIdx ret_type = _check_node(checker, ret.expression);
             no_panic(ret_type);
 
-            if (!_types_compatible(ret_type, checker.fn_ret_type)) {
-                _semantic_error("the type of returned value does not match "
+            if (!_types_compatible(checker, ret_type, checker->fn_ret_type)) {
+                _semantic_error(checker, "the type of returned value does not match "
                                 "the return type of function");
-                return NULL;
+                return NULL_NODE;
             }
 
-            return NULL;
+            return NULL_NODE;
         }
 
         case AST_PRINT_STMT: {
-            PrintStmtNode *p = (PrintStmtNode *)node;
-            AstNode *t = _check_node(p->expression);
+            PrintStmtNode p = get_print_stmt_node(ast, node);
+            NodeIdx t = _check_node(checker, p.expression);
 
-            if (t->ast_type == AST_TYPE_VOID) {
-                _semantic_error("cannot print argument of void type");
-                return NULL;
+            if (TYPE(t) == AST_TYPE_VOID) {
+                _semantic_error(checker, "cannot print argument of void type");
+                return NULL_NODE;
             }
-            return NULL;
+            return NULL_NODE;
         }
 
         case AST_WHILE_STMT: {
-            WhileStmtNode *w = (WhileStmtNode *)node;
+            WhileStmtNode w = get_while_stmt_node(ast, node);
             
-            AstNode *cond_type = _check_node(w->condition);
-            if (cond_type->ast_type != AST_TYPE_BOOL) {
-                _semantic_error("condition in while loop must evaluate to a boolean value");
-                return NULL;
+            NodeIdx cond_type = _check_node(checker, w.condition);
+            if (TYPE(cond_type) != AST_TYPE_BOOL) {
+                _semantic_error(checker, "condition in while loop must evaluate to a boolean value");
+                return NULL_NODE;
             }
 
-            return _check_node(w->body);
+            return _check_node(checker, w.body);
         }
 
         case AST_FOR_STMT: {
-            ForStmtNode *f = (ForStmtNode *)node;
-            scope();
-            AstNode *init = _check_node(f->init);
+            ForStmtNode f = get_for_stmt_node(ast, node);
+            scope(checker);
+            NodeIdx init = _check_node(checker, f.init);
             no_panic(init);
 
-            AstNode *cond_type = _check_node(f->condition);
+            NodeIdx cond_type = _check_node(checker, f.condition);
             no_panic(cond_type);
-            if (cond_type) {
-                if (cond_type->ast_type != AST_TYPE_BOOL) {
-                    _semantic_error("condition in for loop must evaluate to a boolean value");
-                    return NULL;
+            if (cond_type != NULL_NODE) {
+                if (TYPE(cond_type) != AST_TYPE_BOOL) {
+                    _semantic_error(checker, "condition in for loop must evaluate to a boolean value");
+                    return NULL_NODE;
                 }
             }
 
-            AstNode *increment = _check_node(f->increment);
+            NodeIdx increment = _check_node(checker, f.increment);
             no_panic(increment);
-            rm_scope();
-            return _check_node(f->body);
+
+            // The loop variable is visible in the body
+            NodeIdx body = _check_node(checker, f.body);
+            rm_scope(checker);
+            return body;
         }
 
         case AST_EXPR_STMT: {
-            ExprStmtNode *e = (ExprStmtNode *)node;
-            return _check_node(e->expression);
+            ExprStmtNode e = get_expr_stmt_node(ast, node);
+            return _check_node(checker, e.expression);
         }
 
         case AST_ASSIGN_STMT: {
-            AssignStmtNode *a = (AssignStmtNode *)node;
-            AstNode *lval_type = _check_node(a->lvalue);
+            AssignStmtNode a = get_assign_stmt_node(ast, node);
+            NodeIdx lval_type = _check_node(checker, a.lvalue);
             no_panic(lval_type);
-            AstNode *rval_type = _check_node(a->value);
+            NodeIdx rval_type = _check_node(checker, a.value);
             no_panic(rval_type);
 
-            if (!_types_compatible(lval_type, rval_type)) {
-                _semantic_error("type mismatch in assignment stmt at line %d", 
-                    ((IdentifierNode *)a->lvalue)->name.line);
-                return NULL;
+            if (!_types_compatible(checker, lval_type, rval_type)) {
+                _semantic_error(checker, "type mismatch in assignment stmt at line %d", 
+                    _line(checker, get_identifier_node(ast, a.lvalue).name));
+                return NULL_NODE;
             }
 
-            return NULL;
+            return NULL_NODE;
         }
 
         case AST_IF_STMT: {
-            IfStmtNode *i = (IfStmtNode *)node;
+            IfStmtNode i = get_if_stmt_node(ast, node);
 
-            AstNode *if_cond = _check_node(i->condition);
+            NodeIdx if_cond = _check_node(checker, i.condition);
             no_panic(if_cond);
-            if (if_cond->ast_type != AST_TYPE_BOOL) {
-                _semantic_error("condition in if stmt must evaluate to a boolean value");
-                return NULL;
+            if (TYPE(if_cond) != AST_TYPE_BOOL) {
+                _semantic_error(checker, "condition in if stmt must evaluate to a boolean value");
+                return NULL_NODE;
             }
 
-            _check_node(i->then_block);
+            _check_node(checker, i.then_block);
 
-            if (i->elifs) {
-                AstNodeArray elifs = ((ElifClauseListNode *)i->elifs)->elifs;
+            if (i.elifs != NULL_NODE) {
+                AstNodeArray elifs = get_elif_clause_list_node(ast, i.elifs).elifs;
                 for (usize i = 0; i < elifs.count; ++i) {
-                    ElifClauseNode *elif = (ElifClauseNode *)elifs.items[i];
-                    AstNode *elif_cond = _check_node(elif->condition);
+                    ElifClauseNode elif = get_elif_clause_node(ast, elifs.items[i]);
+                    NodeIdx elif_cond = _check_node(checker, elif.condition);
                     no_panic(elif_cond);
-                    if (elif_cond->ast_type != AST_TYPE_BOOL) {
-                        _semantic_error("condition in elif stmt must evaluate to a boolean value");
-                        return NULL;
+                    if (TYPE(elif_cond) != AST_TYPE_BOOL) {
+                        _semantic_error(checker, "condition in elif stmt must evaluate to a boolean value");
+                        return NULL_NODE;
                     }
 
-                    _check_node(elif->block);
+                    _check_node(checker, elif.block);
                 }
             }
 
-            if (i->else_block) {
-                _check_node(i->else_block);
+            if (i.else_block != NULL_NODE) {
+                _check_node(checker, i.else_block);
             }
 
-            return NULL;
+            return NULL_NODE;
         }
 
         case AST_CALL_EXPR: {
-            CallExprNode *call = (CallExprNode *)node;
-            IdentifierNode *callee = (IdentifierNode *)call->callee;
-            AstNodeArray args = ((ArgumentListNode *)call->arguments)->arguments;
+            CallExprNode call = get_call_expr_node(ast, node);
+            IdentifierNode callee = get_identifier_node(ast, call.callee);
+            AstNodeArray args = get_argument_list_node(ast, call.arguments).arguments;
 
-            FunctionSymbol *fn = _lookup_function(callee->name);
+            FunctionSymbol *fn = _lookup_function(checker, callee.name);
             if (!fn) {
-                _semantic_error("call to undefined function '%.*s' at line %d", 
-                    (i32)callee->name.str.len, callee->name.str.s, callee->name.line);
-                return NULL;
+                _semantic_error(checker, "call to undefined function '%.*s' at line %d", 
+                    (i32)_str(checker, callee.name).len, _str(checker, callee.name).s, _line(checker, callee.name));
+                return NULL_NODE;
             }
 
-            FunctionDeclNode *fn_decl = (FunctionDeclNode *)fn->decl;
-            AstNodeArray params = ((ParameterListNode *)fn_decl->parameters)->parameters;
+            set_identifier_binding(ast, call.callee, (Binding) { BIND_FUNCTION, fn->idx });
+            if (fn->import != NULL)
+                return _check_imported_call(checker, callee.name, args, fn->import);
+
+            FunctionDeclNode fn_decl = get_function_decl_node(ast, fn->decl);
+            AstNodeArray params = get_parameter_list_node(ast, fn_decl.parameters).parameters;
             if (params.count != args.count) {
-                _semantic_error("Number of arguments to '%.*s' at line %d "
+                _semantic_error(checker, "Number of arguments to '%.*s' at line %d "
                                 "does not match the number of parameters "
                                 "of '%.*s' at line %d", 
-                    (i32)callee->name.str.len, callee->name.str.s, callee->name.line,
-                    (i32)fn_decl->name.str.len, fn_decl->name.str.s, fn_decl->name.line);
-                return NULL;
+                    (i32)_str(checker, callee.name).len, _str(checker, callee.name).s, _line(checker, callee.name),
+                    (i32)_str(checker, fn_decl.name).len, _str(checker, fn_decl.name).s, _line(checker, fn_decl.name));
+                return NULL_NODE;
             }
 
             for (usize i = 0; i < args.count; ++i) {
-                ParameterNode *param = (ParameterNode *)params.items[i];
-                AstNode *arg_type = _check_node(args.items[i]);
+                ParameterNode param = get_parameter_node(ast, params.items[i]);
+                NodeIdx arg_type = _check_node(checker, args.items[i]);
                 no_panic(arg_type);
 
-                if (!_types_compatible(param->type, arg_type)) {
-                    _semantic_error("The type of argument(idx: %d) for function '%.*s' at line %d "
+                if (!_types_compatible(checker, param.type, arg_type)) {
+                    _semantic_error(checker, "The type of argument(idx: %d) for function '%.*s' at line %d "
                                     "does not match the type of parameter '%.*s' "
                                     "of function '%.*s' at line %d", 
-                        i, (i32)callee->name.str.len, callee->name.str.s, callee->name.line,
-                        (i32)param->name.str.len, param->name.str.s, 
-                        (i32)fn_decl->name.str.len, fn_decl->name.str.s, fn_decl->name.line);
-                    return NULL;
+                        i, (i32)_str(checker, callee.name).len, _str(checker, callee.name).s, _line(checker, callee.name),
+                        (i32)_str(checker, param.name).len, _str(checker, param.name).s, 
+                        (i32)_str(checker, fn_decl.name).len, _str(checker, fn_decl.name).s, _line(checker, fn_decl.name));
+                    return NULL_NODE;
                 }
             }
 
-            return fn_decl->return_type;
+            return fn_decl.return_type;
         }
 
         case AST_VAR_DECL: {
-            VarDeclNode *var = (VarDeclNode *)node;
+            VarDeclNode var = get_var_decl_node(ast, node);
             
-            if (var->type->ast_type == AST_TYPE_VOID) {
-                _semantic_error("variable '%.*s' of type 'void' at line %d",
-                    (i32)var->name.str.len, var->name.str.s, var->name.line);
-                return NULL;
+            if (TYPE(var.type) == AST_TYPE_VOID) {
+                _semantic_error(checker, "variable '%.*s' of type 'void' at line %d",
+                    (i32)_str(checker, var.name).len, _str(checker, var.name).s, _line(checker, var.name));
+                return NULL_NODE;
             }
 
-            if (!checker.in_func) {
-                if (_lookup_global(var->name)) {
-                    _semantic_error("redeclaration of global variable '%.*s' at line %d",
-                        (i32)var->name.str.len, var->name.str.s, var->name.line);
-                    return NULL;
-                }
-    
-                _add_global(var->name, var->type);
-            } else {
-                if (_lookup_local(var->name)) {
-                    _semantic_error("redeclaration of local variable '%.*s' at line %d",
-                        (i32)var->name.str.len, var->name.str.s, var->name.line);
-                    return NULL;
-                }
+            if (!checker->in_func && _lookup_global(checker, var.name) != NULL_NODE) {
+                _semantic_error(checker, "redeclaration of global variable '%.*s' at line %d",
+                    (i32)_str(checker, var.name).len, _str(checker, var.name).s, _line(checker, var.name));
+                return NULL_NODE;
+            }
+
+            if (checker->in_func && _lookup_local(checker, var.name) != NULL_NODE) {
+                _semantic_error(checker, "redeclaration of local variable '%.*s' at line %d",
+                    (i32)_str(checker, var.name).len, _str(checker, var.name).s, _line(checker, var.name));
+                return NULL_NODE;
+            }
+
+            // The variable is not in scope in its own initializer, the
+            // converter evaluates it before the variable gets its slot
+            NodeIdx init_type = _check_node(checker, var.initializer);
 
-                _push_local(_new_local(var->name, var->type));
+            if (!checker->in_func) {
+                _add_global(checker, var.name, var.type);
+            } else {
+                _push_local(checker, _new_local(checker, var.name, var.type));
             }
 
-            if (var->initializer) {
-                AstNode *init_type = _check_node(var->initializer);
-                no_panic(init_type);
-                if (!_types_compatible(var->type, init_type)) {
-                    _semantic_error("type mismatch in assignment to '%.*s' at line %d",
-                        (i32)var->name.str.len, var->name.str.s, var->name.line);
+            no_panic(NULL_NODE);
+            if (var.initializer != NULL_NODE) {
+                if (!_types_compatible(checker, var.type, init_type)) {
+                    _semantic_error(checker, "type mismatch in assignment to '%.*s' at line %d",
+                        (i32)_str(checker, var.name).len, _str(checker, var.name).s, _line(checker, var.name));
                 }
             }
-            return NULL;
+            return NULL_NODE;
         }
 
         case AST_LITERAL_NUMBER:
@@ -561,63 +688,65 @@ AstNode *_check_node(AstNode *node) {
             return node;
 
         case AST_IDENTIFIER: {
-            IdentifierNode *id = (IdentifierNode *)node;
-            AstNode *type = _lookup_var(id->name);
-            if (!type) {
-                _semantic_error("use of unknown variable '%.*s' at line %d",
-                    (i32)id->name.str.len, id->name.str.s, id->name.line);
-                return NULL;
+            IdentifierNode id = get_identifier_node(ast, node);
+            Binding binding;
+            NodeIdx type = _resolve_var(checker, id.name, &binding);
+            if (type == NULL_NODE) {
+                _semantic_error(checker, "use of unknown variable '%.*s' at line %d",
+                    (i32)_str(checker, id.name).len, _str(checker, id.name).s, _line(checker, id.name));
+                return NULL_NODE;
             }
 
+            set_identifier_binding(ast, node, binding);
             return type;
         }
 
         case AST_ASSIGN_EXPR: {
-            AssignExprNode *assign = (AssignExprNode *)node;
-            AstNode *rhs_type = _check_node(assign->value);
+            AssignExprNode assign = get_assign_expr_node(ast, node);
+            NodeIdx rhs_type = _check_node(checker, assign.value);
             no_panic(rhs_type);
-            AstNode *lhs_type = _check_node(assign->lvalue);
+            NodeIdx lhs_type = _check_node(checker, assign.lvalue);
             no_panic(lhs_type);
 
-            if (assign->lvalue->ast_type != AST_IDENTIFIER) {
-                _semantic_error("cannot assign to an expression. "
-                                "The type was %d", lhs_type->ast_type);
-                return NULL;
+            if (TYPE(assign.lvalue) != AST_IDENTIFIER) {
+                _semantic_error(checker, "cannot assign to an expression. "
+                                "The type was %d", TYPE(lhs_type));
+                return NULL_NODE;
             }
 
-            if (!_types_compatible(lhs_type, rhs_type)) {
-                _semantic_error("type mismatch in assignment at line %d",
-                    ((IdentifierNode *)assign->lvalue)->name.line);
-                return NULL;
+            if (!_types_compatible(checker, lhs_type, rhs_type)) {
+                _semantic_error(checker, "type mismatch in assignment at line %d",
+                    _line(checker, get_identifier_node(ast, assign.lvalue).name));
+                return NULL_NODE;
             }
             return lhs_type;
         }
 
         case AST_BINARY_EXPR: {
-            BinaryExprNode *bin = (BinaryExprNode *)node;
-            AstNode *left_type = _check_node(bin->left);
+            BinaryExprNode bin = get_binary_expr_node(ast, node);
+            NodeIdx left_type = _check_node(checker, bin.left);
             no_panic(left_type);
-            AstNode *right_type = _check_node(bin->right);
+            NodeIdx right_type = _check_node(checker, bin.right);
             no_panic(right_type);
 
-            if (!_types_compatible(left_type, right_type)) {
-                _semantic_error("type mismatch in binary expression '%.*s' at line %d",
-                    (i32)bin->op_token.str.len, bin->op_token.str.s, bin->op_token.line);
-                return NULL;
+            if (!_types_compatible(checker, left_type, right_type)) {
+                _semantic_error(checker, "type mismatch in binary expression '%.*s' at line %d",
+                    (i32)_str(checker, bin.op_token).len, _str(checker, bin.op_token).s, _line(checker, bin.op_token));
+                return NULL_NODE;
             }
 
             // enforce types depending on the operation
             // here both values have the same type
-            switch (bin->op_token.type) {
+            switch (bin.op_token.type) {
                 case TOKEN_PLUS:
                 case TOKEN_MINUS:
                 case TOKEN_STAR:
                 case TOKEN_SLASH:
                     // num, num -> num
-                    if (!_any_type(left_type, 2, AST_TYPE_NUM, AST_LITERAL_NUMBER)) {
-                        _semantic_error("Operation '%.*s' is only defined for numbers. Error at line %d",
-                            (i32)bin->op_token.str.len, bin->op_token.str.s, bin->op_token.line);
-                        return NULL;
+                    if (!_any_type(checker, left_type, 2, AST_TYPE_NUM, AST_LITERAL_NUMBER)) {
+                        _semantic_error(checker, "Operation '%.*s' is only defined for numbers. Error at line %d",
+                            (i32)_str(checker, bin.op_token).len, _str(checker, bin.op_token).s, _line(checker, bin.op_token));
+                        return NULL_NODE;
                     }
                     break;
 
@@ -626,36 +755,34 @@ AstNode *_check_node(AstNode *node) {
                 case TOKEN_LESS:
                 case TOKEN_LESS_EQUAL:
                     // num, num -> bool
-                    if (!_any_type(left_type, 2, AST_TYPE_NUM, AST_LITERAL_NUMBER)) {
-                        _semantic_error("Operation '%.*s' is only defined for numbers. Error at line %d",
-                            (i32)bin->op_token.str.len, bin->op_token.str.s, bin->op_token.line);
-                        return NULL;
+                    if (!_any_type(checker, left_type, 2, AST_TYPE_NUM, AST_LITERAL_NUMBER)) {
+                        _semantic_error(checker, "Operation '%.*s' is only defined for numbers. Error at line %d",
+                            (i32)_str(checker, bin.op_token).len, _str(checker, bin.op_token).s, _line(checker, bin.op_token));
+                        return NULL_NODE;
                     }
                     // enforce bool type
-                    sentinel_type.this.ast_type = AST_TYPE_BOOL;
-                    return (AstNode *)&sentinel_type;
+                    return BUILTIN_BOOL_TYPE;
 
                 case TOKEN_AND:
                 case TOKEN_OR:
                     // bool, bool -> bool
-                    if (!_any_type(left_type, 2, AST_TYPE_BOOL, AST_LITERAL_BOOL)) {
-                        _semantic_error("Operation '%.*s' is only defined for booleans. Error at line %d",
-                            (i32)bin->op_token.str.len, bin->op_token.str.s, bin->op_token.line);
-                        return NULL;
+                    if (!_any_type(checker, left_type, 2, AST_TYPE_BOOL, AST_LITERAL_BOOL)) {
+                        _semantic_error(checker, "Operation '%.*s' is only defined for booleans. Error at line %d",
+                            (i32)_str(checker, bin.op_token).len, _str(checker, bin.op_token).s, _line(checker, bin.op_token));
+                        return NULL_NODE;
                     }
                     break;
 
                 case TOKEN_EQUAL_EQUAL:
                 case TOKEN_BANG_EQUAL:
                     // num, num -> bool or bool, bool -> bool
-                    if (!_any_type(left_type, 4, AST_TYPE_NUM, AST_LITERAL_NUMBER, AST_TYPE_BOOL, AST_LITERAL_BOOL)) {
-                        _semantic_error("Operation '%.*s' is only defined for numbers and booleans. Error at line %d",
-                            (i32)bin->op_token.str.len, bin->op_token.str.s, bin->op_token.line);
-                        return NULL;
+                    if (!_any_type(checker, left_type, 4, AST_TYPE_NUM, AST_LITERAL_NUMBER, AST_TYPE_BOOL, AST_LITERAL_BOOL)) {
+                        _semantic_error(checker, "Operation '%.*s' is only defined for numbers and booleans. Error at line %d",
+                            (i32)_str(checker, bin.op_token).len, _str(checker, bin.op_token).s, _line(checker, bin.op_token));
+                        return NULL_NODE;
                     }
                     // enforce bool type
-                    sentinel_type.this.ast_type = AST_TYPE_BOOL;
-                    return (AstNode *)&sentinel_type;
+                    return BUILTIN_BOOL_TYPE;
 
                 default: UNREACHABLE();
             }
@@ -664,61 +791,57 @@ AstNode *_check_node(AstNode *node) {
         }
 
         case AST_UNARY_EXPR: {
-            UnaryExprNode *un = (UnaryExprNode *)node;
-            AstNode *operand_type = _check_node(un->operand);
+            UnaryExprNode un = get_unary_expr_node(ast, node);
+            NodeIdx operand_type = _check_node(checker, un.operand);
             no_panic(operand_type);
 
-            if (!_any_type(operand_type, 2, AST_TYPE_BOOL, AST_LITERAL_BOOL)
-                && un->op_token.type == TOKEN_BANG) {
-                _semantic_error("type mismatch in unary expression '%.*s' at line %d",
-                    (i32)un->op_token.str.len, un->op_token.str.s, un->op_token.line);
-                return NULL;
+            if (!_any_type(checker, operand_type, 2, AST_TYPE_BOOL, AST_LITERAL_BOOL)
+                && un.op_token.type == TOKEN_BANG) {
+                _semantic_error(checker, "type mismatch in unary expression '%.*s' at line %d",
+                    (i32)_str(checker, un.op_token).len, _str(checker, un.op_token).s, _line(checker, un.op_token));
+                return NULL_NODE;
             }
 
-            if (!_any_type(operand_type, 2, AST_TYPE_NUM, AST_LITERAL_NUMBER)
-                && un->op_token.type == TOKEN_MINUS) {
-                _semantic_error("type mismatch in unary expression '%.*s' at line %d",
-                    (i32)un->op_token.str.len, un->op_token.str.s, un->op_token.line);
-                return NULL;
+            if (!_any_type(checker, operand_type, 2, AST_TYPE_NUM, AST_LITERAL_NUMBER)
+                && un.op_token.type == TOKEN_MINUS) {
+                _semantic_error(checker, "type mismatch in unary expression '%.*s' at line %d",
+                    (i32)_str(checker, un.op_token).len, _str(checker, un.op_token).s, _line(checker, un.op_token));
+                return NULL_NODE;
             }
 
             return operand_type;
         }
 
         case AST_PAREN_EXPR: {
-            ParenExprNode *paren = (ParenExprNode *)node;
-            AstNode *expr_type = _check_node(paren->expression);
+            ParenExprNode paren = get_paren_expr_node(ast, node);
+            NodeIdx expr_type = _check_node(checker, paren.expression);
             no_panic(expr_type);
             return expr_type;
         }
 
         default:
-            _semantic_error("unknown node type");
-            return NULL;
+            _semantic_error(checker, "unknown node type");
+            return NULL_NODE;
     }
 }
 
-void _free_checker(void) {
-    if (global_symbols.count > 0) {
-        da_free(global_symbols);
-    }
-    if (global_functions.count > 0) {
-        da_free(global_functions);
-    }
-    if (local_symbols.count > 0) {
-        da_free(local_symbols);
-    }
+#undef TYPE
+
+void _free_checker(Checker *checker) {
+    arena_free(&checker->arena);
+    symbol_map_free(&checker->global_symbols);
+    symbol_map_free(&checker->local_heads);
+    symbol_map_free(&checker->function_idx);
 }
 
-b32 semantic_errors(AstNode *program) {
-    _init_checker();
-    _init_global();
-    _init_functions();
-    _init_local();
+b32 semantic_errors(Ast *ast, Imports *imports, ArenaStats *stats) {
+    Checker checker;
+    _init_checker(&checker, ast, imports);
 
-    _check_node(program);
+    _check_node(&checker, ast->root);
+    if (stats != NULL) *stats = checker.arena.stats;
 
-    _free_checker();
+    _free_checker(&checker);
 
     return checker.error;
 }
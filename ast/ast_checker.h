@@ -3,7 +3,37 @@
 
 #include "node.h"
 #include "types.h"
+#include "symbols.h"
+#include "arena.h"
 
-b32 semantic_errors(AstNode *program);
+// A function another module defines. Its types are AstNodeTypes of
+// the builtin types, the name is interned into the importing
+// module's symbols.
+typedef struct {
+    s8 name;
+    SymbolId sym;
+    u8 return_type;
+    u8 *param_types;
+    u32 param_count;
+    u32 idx; // function index in the importing module, set by the checker
+} ImportedFunction;
 
-#endif
\ No newline at end of file
+// What one import declaration brings in
+typedef struct {
+    ImportedFunction *items;
+    usize count;
+    usize capacity;
+} ImportedFunctions;
+
+// One entry per import declaration, in source order
+typedef struct {
+    ImportedFunctions *items;
+    usize count;
+    usize capacity;
+} Imports;
+
+// 'imports' may be NULL if the program has no import declarations.
+// 'stats' gets those of the symbol table arena, if not NULL.
+b32 semantic_errors(Ast *ast, Imports *imports, ArenaStats *stats);
+
+#endif
@@ -7,229 +7,234 @@ void _indent(i32 indent) {
     for (i32 i = 0; i < indent; ++i) putchar(' ');
 }
 
-void print_ast(AstNode *node, i32 indent) {
-    if (!node) {
+void print_ast(Ast *ast, NodeIdx node, i32 indent) {
+    if (node == NULL_NODE) {
         _indent(indent);
         printf("(null)\n");
         return;
     }
 
-    switch (node->ast_type) {
+    switch (ast_type(ast, node)) {
         case AST_PROGRAM: {
-            ProgramNode *prog = (ProgramNode *)node;
+            ProgramNode prog = get_program_node(ast, node);
             _indent(indent); printf("Program\n");
-            for (usize i = 0; i < prog->declarations.count; ++i) {
-                print_ast(prog->declarations.items[i], indent + 2);
+            for (usize i = 0; i < prog.declarations.count; ++i) {
+                print_ast(ast, prog.declarations.items[i], indent + 2);
             }
             break;
         }
         case AST_FUNCTION_DECL: {
-            FunctionDeclNode *fn = (FunctionDeclNode *)node;
-            _indent(indent); printf("FunctionDecl: %.*s\n", (i32)fn->name.str.len, fn->name.str.s);
+            FunctionDeclNode fn = get_function_decl_node(ast, node);
+            _indent(indent); printf("FunctionDecl: %.*s\n", (i32)token_str(ast, fn.name).len, token_str(ast, fn.name).s);
             _indent(indent + 2); printf("Return type:\n");
-            print_ast(fn->return_type, indent + 4);
+            print_ast(ast, fn.return_type, indent + 4);
             _indent(indent + 2); printf("Parameters:\n");
-            print_ast(fn->parameters, indent + 4);
-            if (fn->body) {
+            print_ast(ast, fn.parameters, indent + 4);
+            if (fn.body != NULL_NODE) {
                 _indent(indent + 2); printf("Body:\n");
-                print_ast(fn->body, indent + 4);
+                print_ast(ast, fn.body, indent + 4);
             } else {
                 _indent(indent + 2); printf("Prototype (no body)\n");
             }
             break;
         }
         case AST_PARAMETER_LIST: {
-            ParameterListNode *plist = (ParameterListNode *)node;
-            for (usize i = 0; i < plist->parameters.count; ++i) {
-                print_ast(plist->parameters.items[i], indent + 2);
+            ParameterListNode plist = get_parameter_list_node(ast, node);
+            for (usize i = 0; i < plist.parameters.count; ++i) {
+                print_ast(ast, plist.parameters.items[i], indent + 2);
             }
             break;
         }
         case AST_PARAMETER: {
-            ParameterNode *param = (ParameterNode *)node;
-            _indent(indent); printf("Parameter: %.*s\n", (i32)param->name.str.len, param->name.str.s);
-            print_ast(param->type, indent + 2);
+            ParameterNode param = get_parameter_node(ast, node);
+            _indent(indent); printf("Parameter: %.*s\n", (i32)token_str(ast, param.name).len, token_str(ast, param.name).s);
+            print_ast(ast, param.type, indent + 2);
             break;
         }
         case AST_BLOCK: {
-            BlockNode *block = (BlockNode *)node;
+            BlockNode block = get_block_node(ast, node);
             _indent(indent); printf("Block\n");
-            for (usize i = 0; i < block->statements.count; ++i) {
-                print_ast(block->statements.items[i], indent + 2);
+            for (usize i = 0; i < block.statements.count; ++i) {
+                print_ast(ast, block.statements.items[i], indent + 2);
             }
             break;
         }
         case AST_RETURN_STMT: {
-            ReturnStmtNode *ret = (ReturnStmtNode *)node;
+            ReturnStmtNode ret = get_return_stmt_node(ast, node);
             _indent(indent); printf("Return\n");
-            print_ast(ret->expression, indent + 2);
+            print_ast(ast, ret.expression, indent + 2);
             break;
         }
         case AST_PRINT_STMT: {
-            PrintStmtNode *p = (PrintStmtNode *)node;
+            PrintStmtNode p = get_print_stmt_node(ast, node);
             _indent(indent); printf("PrintStmt\n");
-            print_ast(p->expression, indent + 2);
+            print_ast(ast, p.expression, indent + 2);
             break;
         }
         case AST_WHILE_STMT: {
-            WhileStmtNode *w = (WhileStmtNode *)node;
+            WhileStmtNode w = get_while_stmt_node(ast, node);
             _indent(indent); printf("While\n");
             _indent(indent); printf("Condition\n");
-            print_ast(w->condition, indent + 2);
+            print_ast(ast, w.condition, indent + 2);
             _indent(indent); printf("Body\n");
-            print_ast(w->body, indent + 2);
+            print_ast(ast, w.body, indent + 2);
             break;
         }
         case AST_EXPR_STMT: {
-            ExprStmtNode *e = (ExprStmtNode *)node;
+            ExprStmtNode e = get_expr_stmt_node(ast, node);
             _indent(indent); printf("ExprStmt\n");
-            print_ast(e->expression, indent + 2);
+            print_ast(ast, e.expression, indent + 2);
             break;
         }
         case AST_ASSIGN_STMT: {
-            AssignStmtNode *a = (AssignStmtNode *)node;
+            AssignStmtNode a = get_assign_stmt_node(ast, node);
             _indent(indent); printf("AssignStmt\n");
             _indent(indent + 2); printf("LHS:\n");
-            print_ast(a->lvalue, indent + 4);
+            print_ast(ast, a.lvalue, indent + 4);
             _indent(indent + 2); printf("RHS:\n");
-            print_ast(a->value, indent + 4);
+            print_ast(ast, a.value, indent + 4);
             break;
         }
         case AST_FOR_STMT: {
-            ForStmtNode *f = (ForStmtNode *)node;
+            ForStmtNode f = get_for_stmt_node(ast, node);
             _indent(indent); printf("For\n");
             _indent(indent); printf("Initializer\n");
-            print_ast(f->init, indent + 2);
+            print_ast(ast, f.init, indent + 2);
             _indent(indent); printf("Condition\n");
-            print_ast(f->condition, indent + 2);
+            print_ast(ast, f.condition, indent + 2);
             _indent(indent); printf("Increment\n");
-            print_ast(f->increment, indent + 2);
+            print_ast(ast, f.increment, indent + 2);
             _indent(indent); printf("Body\n");
-            print_ast(f->body, indent + 2);
+            print_ast(ast, f.body, indent + 2);
             break;
         }
         case AST_IF_STMT: {
-            IfStmtNode *i = (IfStmtNode *)node;
+            IfStmtNode i = get_if_stmt_node(ast, node);
             _indent(indent); printf("If\n");
             _indent(indent); printf("Condition\n");
-            print_ast(i->condition, indent + 2);
+            print_ast(ast, i.condition, indent + 2);
             _indent(indent); printf("Then\n");
-            print_ast(i->then_block, indent + 2);
+            print_ast(ast, i.then_block, indent + 2);
 
-            if (i->elifs) {
-                AstNodeArray elifs = ((ElifClauseListNode *)i->elifs)->elifs;
+            if (i.elifs != NULL_NODE) {
+                AstNodeArray elifs = get_elif_clause_list_node(ast, i.elifs).elifs;
                 for (usize i = 0; i < elifs.count; ++i) {
-                    ElifClauseNode *elif = (ElifClauseNode *)elifs.items[i];
+                    ElifClauseNode elif = get_elif_clause_node(ast, elifs.items[i]);
                     _indent(indent); printf("Elif\n");
                     _indent(indent); printf("Condition\n");
-                    print_ast(elif->condition, indent + 2);
+                    print_ast(ast, elif.condition, indent + 2);
                     _indent(indent); printf("Then\n");
-                    print_ast(elif->block, indent + 2);
+                    print_ast(ast, elif.block, indent + 2);
                 }
             }
 
-            if (i->else_block) {
+            if (i.else_block != NULL_NODE) {
                 _indent(indent); printf("Else\n");
-                print_ast(i->else_block, indent + 2);
+                print_ast(ast, i.else_block, indent + 2);
             }
             break;
         }
         case AST_CALL_EXPR: {
-            CallExprNode *call = (CallExprNode *)node;
+            CallExprNode call = get_call_expr_node(ast, node);
             _indent(indent); printf("CallExpr\n");
             _indent(indent + 2); printf("Callee:\n");
-            print_ast(call->callee, indent + 4);
+            print_ast(ast, call.callee, indent + 4);
             _indent(indent + 2); printf("Arguments:\n");
-            print_ast(call->arguments, indent + 4);
+            print_ast(ast, call.arguments, indent + 4);
             break;
         }
         case AST_ARGUMENT_LIST: {
-            ArgumentListNode *args = (ArgumentListNode *)node;
-            for (usize i = 0; i < args->arguments.count; ++i) {
-                print_ast(args->arguments.items[i], indent + 2);
+            ArgumentListNode args = get_argument_list_node(ast, node);
+            for (usize i = 0; i < args.arguments.count; ++i) {
+                print_ast(ast, args.arguments.items[i], indent + 2);
             }
             break;
         }
         case AST_VAR_DECL: {
-            VarDeclNode *var = (VarDeclNode *)node;
-            _indent(indent); printf("VarDecl: %.*s\n", (i32)var->name.str.len, var->name.str.s);
-            print_ast(var->type, indent + 2);
-            if (var->initializer) {
+            VarDeclNode var = get_var_decl_node(ast, node);
+            _indent(indent); printf("VarDecl: %.*s\n", (i32)token_str(ast, var.name).len, token_str(ast, var.name).s);
+            print_ast(ast, var.type, indent + 2);
+            if (var.initializer != NULL_NODE) {
                 _indent(indent + 2); printf("Initializer:\n");
-                print_ast(var->initializer, indent + 4);
+                print_ast(ast, var.initializer, indent + 4);
             }
             break;
         }
+        case AST_IMPORT: {
+            ImportNode import = get_import_node(ast, node);
+            _indent(indent); printf("Import: %.*s\n", (i32)token_str(ast, import.path).len, token_str(ast, import.path).s);
+            break;
+        }
         case AST_TYPE_NUM:
         case AST_TYPE_STRING:
         case AST_TYPE_BOOL:
         case AST_TYPE_VOID: {
-            PrimitiveTypeNode *type = (PrimitiveTypeNode *)node;
-            _indent(indent); printf("Type: %.*s\n", (i32)type->type_token.str.len, type->type_token.str.s);
+            PrimitiveTypeNode type = get_primitive_type_node(ast, node);
+            _indent(indent); printf("Type: %.*s\n", (i32)token_str(ast, type.type_token).len, token_str(ast, type.type_token).s);
             break;
         }
         case AST_TYPE_STRUCT: {
-            StructTypeNode *type = (StructTypeNode *)node;
-            _indent(indent); printf("Type: %.*s\n", (i32)type->name.str.len, type->name.str.s);
+            StructTypeNode type = get_struct_type_node(ast, node);
+            _indent(indent); printf("Type: %.*s\n", (i32)token_str(ast, type.name).len, token_str(ast, type.name).s);
             break;
         }
         case AST_LITERAL_NUMBER: {
-            NumberLiteralNode *num = (NumberLiteralNode *)node;
-            _indent(indent); printf("Number: %.*s\n", (i32)num->value.str.len, num->value.str.s);
+            NumberLiteralNode num = get_number_literal_node(ast, node);
+            _indent(indent); printf("Number: %.*s\n", (i32)token_str(ast, num.value).len, token_str(ast, num.value).s);
             break;
         }
         case AST_LITERAL_STRING: {
-            StringLiteralNode *str = (StringLiteralNode *)node;
-            _indent(indent); printf("String: %.*s\n", (i32)str->value.str.len, str->value.str.s);
+            StringLiteralNode str = get_string_literal_node(ast, node);
+            _indent(indent); printf("String: %.*s\n", (i32)token_str(ast, str.value).len, token_str(ast, str.value).s);
             break;
         }
         case AST_LITERAL_BOOL: {
-            BoolLiteralNode *b = (BoolLiteralNode *)node;
-            _indent(indent); printf("Bool: %.*s\n", (i32)b->token.str.len, b->token.str.s);
+            BoolLiteralNode b = get_bool_literal_node(ast, node);
+            _indent(indent); printf("Bool: %.*s\n", (i32)token_str(ast, b.token).len, token_str(ast, b.token).s);
             break;
         }
         case AST_IDENTIFIER: {
-            IdentifierNode *id = (IdentifierNode *)node;
-            _indent(indent); printf("Identifier: %.*s\n", (i32)id->name.str.len, id->name.str.s);
+            IdentifierNode id = get_identifier_node(ast, node);
+            _indent(indent); printf("Identifier: %.*s\n", (i32)token_str(ast, id.name).len, token_str(ast, id.name).s);
             break;
         }
         case AST_ASSIGN_EXPR: {
-            AssignExprNode *assign = (AssignExprNode *)node;
+            AssignExprNode assign = get_assign_expr_node(ast, node);
             _indent(indent); printf("AssignExpr\n");
             _indent(indent + 2); printf("LHS:\n");
-            print_ast(assign->lvalue, indent + 4);
+            print_ast(ast, assign.lvalue, indent + 4);
             _indent(indent + 2); printf("RHS:\n");
-            print_ast(assign->value, indent + 4);
+            print_ast(ast, assign.value, indent + 4);
             break;
         }
         case AST_BINARY_EXPR: {
-            BinaryExprNode *bin = (BinaryExprNode *)node;
-            _indent(indent); printf("BinaryExpr: %.*s\n", (i32)bin->op_token.str.len, bin->op_token.str.s);
+            BinaryExprNode bin = get_binary_expr_node(ast, node);
+            _indent(indent); printf("BinaryExpr: %.*s\n", (i32)token_str(ast, bin.op_token).len, token_str(ast, bin.op_token).s);
             _indent(indent + 2); printf("Left:\n");
-            print_ast(bin->left, indent + 4);
+            print_ast(ast, bin.left, indent + 4);
             _indent(indent + 2); printf("Right:\n");
-            print_ast(bin->right, indent + 4);
+            print_ast(ast, bin.right, indent + 4);
             break;
         }
         case AST_UNARY_EXPR: {
-            UnaryExprNode *un = (UnaryExprNode *)node;
-            _indent(indent); printf("UnaryExpr: %.*s\n", (i32)un->op_token.str.len, un->op_token.str.s);
-            print_ast(un->operand, indent + 2);
+            UnaryExprNode un = get_unary_expr_node(ast, node);
+            _indent(indent); printf("UnaryExpr: %.*s\n", (i32)token_str(ast, un.op_token).len, token_str(ast, un.op_token).s);
+            print_ast(ast, un.operand, indent + 2);
             break;
         }
         case AST_PAREN_EXPR: {
-            ParenExprNode *paren = (ParenExprNode *)node;
+            ParenExprNode paren = get_paren_expr_node(ast, node);
             _indent(indent); printf("ParenExpr\n");
-            print_ast(paren->expression, indent + 2);
+            print_ast(ast, paren.expression, indent + 2);
             break;
         }
         case AST_ERROR: {
-            ErrorNode *err = (ErrorNode *)node;
-            _indent(indent); printf("Error: %s at line %d\n", err->msg, err->error_token.line);
+            ErrorNode err = get_error_node(ast, node);
+            _indent(indent); printf("Error: %s at line %d\n", err.msg, token_line(ast, err.error_token));
             break;
         }
         default:
-            _indent(indent); printf("Unknown node type %d\n", node->ast_type);
+            _indent(indent); printf("Unknown node type %d\n", ast_type(ast, node));
             break;
     }
 }
@@ -4,6 +4,6 @@
 #include "types.h"
 #include "node.h"
 
-void print_ast(AstNode *node, i32 indent);
+void print_ast(Ast *ast, NodeIdx node, i32 indent);
 
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define AST_NODE
 
 #include "types.h"
+#include "token.h"
+#include "source.h"
 
 typedef enum {
     // --- Top-level ---
@@ -66,15 +68,57 @@ typedef enum {
     AST_ERROR
 } AstNodeType;
 
+// Nodes live in parallel arrays of an Ast and refer to each other
+// and to their tokens by 32-bit index
+typedef u32 NodeIdx;
+typedef u32 TokenIdx;
+
+#define NO_TOKEN ((TokenIdx)-1)
+
+// Nodes every Ast starts with. NULL_NODE stands for a missing child,
+// the builtin types are given to expressions that have no type node
+// of their own.
+enum {
+    NULL_NODE,
+    BUILTIN_NUM_TYPE,
+    BUILTIN_STRING_TYPE,
+    BUILTIN_BOOL_TYPE,
+    BUILTIN_VOID_TYPE,
+    FIRST_NODE
+};
+
+// Two child slots, their meaning depends on the node kind.
+// Nodes with more children keep them in Ast.extra.
 typedef struct {
-    AstNodeType ast_type;
-} AstNode;
+    NodeIdx lhs;
+    NodeIdx rhs;
+} AstData;
 
-// Array of pointers to AstNode structs
+// Array of node indices. Lists in a finished Ast point into Ast.extra.
 typedef struct {
-    AstNode **items;
+    NodeIdx *items;
     usize capacity;
     usize count;
 } AstNodeArray;
 
+typedef struct {
+    byte **items;
+    usize count;
+    usize capacity;
+} ErrorMessages;
+
+typedef struct {
+    u8 *tags;             // AstNodeType of every node
+    TokenIdx *tokens;     // main token of every node
+    AstData *data;
+    usize count;
+    usize capacity;
+
+    AstNodeArray extra;   // child lists and children that do not fit in AstData
+    ErrorMessages messages;
+    TokenArray source;    // only the tokens nodes refer to
+    SourceText text;      // what the tokens point into, not owned
+    NodeIdx root;
+} Ast;
+
 #endif
\ No newline at end of file
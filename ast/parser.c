@@ -1,60 +1,116 @@
 #include "parser.h"
+#include "scanner.h"
 #include "special_nodes.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include "macros.h"
-#include "da.h"
+#include "arena.h"
+
+// Tokens are pulled from the scanner as the parser gets to them. The
+// ring holds the previous token, the current one and two more for
+// _look(parser, 2). A token is copied into the Ast only once a node refers
+// to it.
+#define LOOKAHEAD 4
+
+typedef struct {
+    Token token;
+    TokenIdx kept; // index in Ast.source, NO_TOKEN until kept
+} Lookahead;
 
 typedef struct {
-    TokenArray tokens;
-    size_t current;
+    Scanner scanner;
+    Lookahead ring[LOOKAHEAD];
+    usize current; // position of the current token in the stream
+    usize scanned; // tokens pulled so far
     b32 error;
     b32 panic;
+    Arena scratch;
+    Ast *ast;
 } Parser;
 
-static Parser parser;
+// Child lists are collected in scratch memory, the node constructors
+// copy them into the AST arena. Lists nest like the calls building
+// them, so the list being filled is always the newest allocation and
+// grows in place.
+#define PARSER_SCRATCH_SIZE (16 * 1024)
+
+#define list_append(list, item) arena_da_append(&parser->scratch, (list), (item))
+
+#define ring_slot(pos) (&parser->ring[(pos) % LOOKAHEAD])
+
+static inline
+void _fill(Parser *parser, usize pos) {
+    while (parser->scanned <= pos) {
+        *ring_slot(parser->scanned++) = (Lookahead) {
+            .token = next_token(&parser->scanner),
+            .kept = NO_TOKEN
+        };
+    }
+}
 
+// The current token is always scanned already
 static inline 
-Token _peek(void) {
-    return parser.tokens.items[parser.current];
+Token _peek(Parser *parser) {
+    return ring_slot(parser->current)->token;
 }
 
 static inline
-Token _look(i32 i) {
-    if (parser.current + i >= parser.tokens.count)
-        return parser.tokens.items[parser.tokens.count - 1];
-
-    return parser.tokens.items[parser.current + i];
+Token _look(Parser *parser, i32 i) {
+    _fill(parser, parser->current + i);
+    return ring_slot(parser->current + i)->token;
 }
 
 static inline 
-b32 _at_end(void) {
-    return _peek().type == TOKEN_EOF;
+b32 _at_end(Parser *parser) {
+    return _peek(parser).type == TOKEN_EOF;
+}
+
+// Nodes refer to tokens by their index in the Ast
+static inline
+TokenIdx _keep(Parser *parser, usize pos) {
+    Lookahead *l = ring_slot(pos);
+    if (l->kept == NO_TOKEN) l->kept = keep_token(parser->ast, l->token);
+    return l->kept;
+}
+
+static inline
+TokenIdx _cur(Parser *parser) {
+    return _keep(parser, parser->current);
+}
+
+static inline
+TokenIdx _prev(Parser *parser) {
+    return _keep(parser, parser->current - 1);
 }
 
 static inline 
-Token _advance(void) {
-    if (!_at_end()) ++parser.current;
-    return _peek();
+Token _advance(Parser *parser) {
+    if (!_at_end(parser)) _fill(parser, ++parser->current);
+    return _peek(parser);
 }
 
 static inline 
-b32 _match(TokenType type) {
-    if (_peek().type == type) {
-        _advance();
+b32 _match(Parser *parser, TokenType type) {
+    if (_peek(parser).type == type) {
+        _advance(parser);
         return true;
     }
     return false;
 }
 
 static inline 
-AstNode *_error(byte *expected) {
-    Token t = _peek();
-    fprintf(stderr, "Parse error: expected '%s' but got '%.*s' at line %d\n", 
-        expected, (i32) t.str.len, t.str.s, t.line);
-    parser.error = true;
-    parser.panic = true;
-    return new_error_node(t, expected);
+NodeIdx _error(Parser *parser, byte *expected) {
+    Token t = _peek(parser);
+    // Errors after a bad token are most likely caused by it,
+    // the scanner has already reported that one
+    if (!parser->scanner.error) {
+        s8 str = token_str(parser->ast, t);
+        fprintf(stderr, "Parse error: expected '%s' but got '%.*s' at line %d\n", 
+            expected, (i32) str.len, str.s, token_line(parser->ast, t));
+    }
+    parser->error = true;
+    parser->panic = true;
+    return new_error_node(parser->ast, _cur(parser), expected);
 }
 
 static inline
@@ -65,572 +121,622 @@ b32 _is_type(Token t) {
            t.type == TOKEN_VOID;
 }
 
-#define no_panic(node) do { if (parser.panic) return node; } while (0)
-
-static AstNode *parse_var_decl(void);
-static AstNode *parse_type(void);
-static AstNode *parse_expression(void);
-static AstNode *parse_assignment(void);
-static AstNode *parse_logic_or(void);
-static AstNode *parse_logic_and(void);
-static AstNode *parse_equality(void);
-static AstNode *parse_comparison(void);
-static AstNode *parse_term(void);
-static AstNode *parse_factor(void);
-static AstNode *parse_unary(void);
-static AstNode *parse_primary(void);
-static AstNode *parse_declaration(void);
-static AstNode *parse_fun_decl(void);
-static AstNode *parse_parameters(void);
-static AstNode *parse_block(void);
-static AstNode *parse_call(void);
-static AstNode *parse_arguments(void);
-static AstNode *parse_statement(void);
-static AstNode *parse_return_stmt(void);
-static AstNode *parse_print_stmt(void);
-static AstNode *parse_while_stmt(void);
-static AstNode *parse_assignment_stmt(void);
-static AstNode *parse_for_stmt(void);
-static AstNode *parse_expr_stmt(void);
-static AstNode *parse_if_stmt(void);
+#define no_panic(node) do { if (parser->panic) return node; } while (0)
+
+// Same as no_panic and _error, for returns out of a scratch scope
+#define no_panic_scratch(node, scratch) \
+    do { if (parser->panic) { scratch_end(scratch); return node; } } while (0)
 
 static inline
-void _synchronize(void) {
-    while (!_at_end()) {
-        TokenType t = _peek().type;
+NodeIdx _scratch_error(Parser *parser, ScratchArena scratch, byte *expected) {
+    NodeIdx error = _error(parser, expected);
+    scratch_end(scratch);
+    return error;
+}
+
+static NodeIdx parse_var_decl(Parser *parser);
+static NodeIdx parse_type(Parser *parser);
+static NodeIdx parse_expression(Parser *parser);
+static NodeIdx parse_assignment(Parser *parser);
+static NodeIdx parse_logic_or(Parser *parser);
+static NodeIdx parse_logic_and(Parser *parser);
+static NodeIdx parse_equality(Parser *parser);
+static NodeIdx parse_comparison(Parser *parser);
+static NodeIdx parse_term(Parser *parser);
+static NodeIdx parse_factor(Parser *parser);
+static NodeIdx parse_unary(Parser *parser);
+static NodeIdx parse_primary(Parser *parser);
+static NodeIdx parse_declaration(Parser *parser);
+static NodeIdx parse_import(Parser *parser);
+static NodeIdx parse_fun_decl(Parser *parser);
+static NodeIdx parse_parameters(Parser *parser);
+static NodeIdx parse_block(Parser *parser);
+static NodeIdx parse_call(Parser *parser);
+static NodeIdx parse_arguments(Parser *parser);
+static NodeIdx parse_statement(Parser *parser);
+static NodeIdx parse_return_stmt(Parser *parser);
+static NodeIdx parse_print_stmt(Parser *parser);
+static NodeIdx parse_while_stmt(Parser *parser);
+static NodeIdx parse_assignment_stmt(Parser *parser);
+static NodeIdx parse_for_stmt(Parser *parser);
+static NodeIdx parse_expr_stmt(Parser *parser);
+static NodeIdx parse_if_stmt(Parser *parser);
+
+static inline
+void _synchronize(Parser *parser) {
+    while (!_at_end(parser)) {
+        TokenType t = _peek(parser).type;
         if (t == TOKEN_SEMICOLON || t == TOKEN_RIGHT_BRACE) {
-            _advance(); // Go past the semicolon
+            _advance(parser); // Go past the semicolon
             break;
         }
 
         if (t == TOKEN_LEFT_BRACE) {
-            parse_block();
+            parse_block(parser);
             return;
         }
 
-        _advance();
+        _advance(parser);
     }
 }
 
 static 
-AstNode *parse_program(void) {
+NodeIdx parse_program(Parser *parser) {
+    ScratchArena scratch = scratch_begin(&parser->scratch);
     AstNodeArray decls = {0};
-    while (!_at_end()) {
-        AstNode *decl = parse_declaration();
-        da_append(&decls, decl);
+    while (!_at_end(parser)) {
+        NodeIdx decl = parse_declaration(parser);
+        list_append(&decls, decl);
 
-        if (parser.panic) {
-            parser.panic = false;
-            _synchronize();
+        if (parser->panic) {
+            parser->panic = false;
+            _synchronize(parser);
         }
     }
-    return new_program_node(decls);
+    NodeIdx program = new_program_node(parser->ast, decls);
+    scratch_end(scratch);
+    return program;
 }
 
-static AstNode *parse_declaration(void) {
-    Token lookahead = _look(2);
+static NodeIdx parse_declaration(Parser *parser) {
+    if (_peek(parser).type == TOKEN_IMPORT)
+        return parse_import(parser);
+
+    Token lookahead = _look(parser, 2);
     
     if (lookahead.type == TOKEN_LEFT_PAREN)
-        return parse_fun_decl();
+        return parse_fun_decl(parser);
+
+    return parse_var_decl(parser);
+}
+
+static NodeIdx parse_import(Parser *parser) {
+    _advance(parser); // 'import'
+
+    TokenIdx path = _cur(parser);
+    if (!_match(parser, TOKEN_STRING_LITERAL))
+        return _error(parser, "module path");
+
+    if (!_match(parser, TOKEN_SEMICOLON))
+        return _error(parser, ";");
 
-    return parse_var_decl();
+    return new_import_node(parser->ast, path);
 }
 
-static AstNode *parse_fun_decl(void) {
-    AstNode *type = parse_type();
+static NodeIdx parse_fun_decl(Parser *parser) {
+    NodeIdx type = parse_type(parser);
     no_panic(type);
 
-    Token name = _peek();
-    if (!_match(TOKEN_IDENTIFIER_LITERAL))
-        return _error("function name");
+    TokenIdx name = _cur(parser);
+    if (!_match(parser, TOKEN_IDENTIFIER_LITERAL))
+        return _error(parser, "function name");
 
-    if (!_match(TOKEN_LEFT_PAREN))
-        return _error("(");
+    if (!_match(parser, TOKEN_LEFT_PAREN))
+        return _error(parser, "(");
 
-    AstNode *params = parse_parameters();
+    NodeIdx params = parse_parameters(parser);
     no_panic(params);
 
-    if (!_match(TOKEN_RIGHT_PAREN))
-        return _error("')'");
+    if (!_match(parser, TOKEN_RIGHT_PAREN))
+        return _error(parser, "')'");
 
-    if (_peek().type == TOKEN_LEFT_BRACE) {
-        AstNode *body = parse_block();
+    if (_peek(parser).type == TOKEN_LEFT_BRACE) {
+        NodeIdx body = parse_block(parser);
         no_panic(body);
 
-        return new_function_decl_node(type, name, params, body);
+        return new_function_decl_node(parser->ast, type, name, params, body);
     } 
 
-    if (_match(TOKEN_SEMICOLON))
-        return new_function_decl_node(type, name, params, NULL);
+    if (_match(parser, TOKEN_SEMICOLON))
+        return new_function_decl_node(parser->ast, type, name, params, NULL_NODE);
 
-    return _error("function body or ';'");
+    return _error(parser, "function body or ';'");
 }
 
 static 
-AstNode *parse_parameters(void) {
+NodeIdx parse_parameters(Parser *parser) {
     AstNodeArray params = {0};
-    if (_peek().type == TOKEN_RIGHT_PAREN)
-        return new_parameter_list_node(params);
+    if (_peek(parser).type == TOKEN_RIGHT_PAREN)
+        return new_parameter_list_node(parser->ast, params);
 
+    ScratchArena scratch = scratch_begin(&parser->scratch);
     do {
-        AstNode *type = parse_type();
-        no_panic(type);
+        NodeIdx type = parse_type(parser);
+        no_panic_scratch(type, scratch);
 
-        Token name = _peek();
-        if (!_match(TOKEN_IDENTIFIER_LITERAL))
-            return _error("parameter name");
+        TokenIdx name = _cur(parser);
+        if (!_match(parser, TOKEN_IDENTIFIER_LITERAL))
+            return _scratch_error(parser, scratch, "parameter name");
 
-        AstNode *param = new_parameter_node(type, name);
-        da_append(&params, param);
-    } while (_match(TOKEN_COMMA));
+        NodeIdx param = new_parameter_node(parser->ast, type, name);
+        list_append(&params, param);
+    } while (_match(parser, TOKEN_COMMA));
 
-    return new_parameter_list_node(params);
+    NodeIdx list = new_parameter_list_node(parser->ast, params);
+    scratch_end(scratch);
+    return list;
 }
 
 static 
-AstNode *parse_block(void) {
-    _match(TOKEN_LEFT_BRACE);
+NodeIdx parse_block(Parser *parser) {
+    _match(parser, TOKEN_LEFT_BRACE);
+    ScratchArena scratch = scratch_begin(&parser->scratch);
     AstNodeArray stmts = {0};
 
-    while (_peek().type != TOKEN_RIGHT_BRACE && !_at_end()) {
-        AstNode *stmt;
-        if (_is_type(_peek())) {
-            stmt = parse_var_decl();
+    while (_peek(parser).type != TOKEN_RIGHT_BRACE && !_at_end(parser)) {
+        NodeIdx stmt;
+        if (_is_type(_peek(parser))) {
+            stmt = parse_var_decl(parser);
         } else {
-            stmt = parse_statement();
+            stmt = parse_statement(parser);
         }
         
-        if (parser.panic) {
-            parser.panic = false;
-            _synchronize();
+        if (parser->panic) {
+            parser->panic = false;
+            _synchronize(parser);
         }
 
-        da_append(&stmts, stmt);
+        list_append(&stmts, stmt);
     }
 
-    if (!_match(TOKEN_RIGHT_BRACE))
-            return _error("}");
+    if (!_match(parser, TOKEN_RIGHT_BRACE))
+        return _scratch_error(parser, scratch, "}");
 
-    return new_block_node(stmts);
+    NodeIdx block = new_block_node(parser->ast, stmts);
+    scratch_end(scratch);
+    return block;
 }
 
 static 
-AstNode *parse_statement(void) {
-    Token t = _peek();
+NodeIdx parse_statement(Parser *parser) {
+    Token t = _peek(parser);
     switch (t.type) {
         case TOKEN_RETURN:
-            return parse_return_stmt();
+            return parse_return_stmt(parser);
         case TOKEN_LEFT_BRACE:
-            return parse_block();
+            return parse_block(parser);
         case TOKEN_PRINT: 
-            return parse_print_stmt();
+            return parse_print_stmt(parser);
         case TOKEN_WHILE:
-            return parse_while_stmt();
+            return parse_while_stmt(parser);
         case TOKEN_IDENTIFIER_LITERAL: {
-            if (_look(1).type == TOKEN_LEFT_PAREN)
+            if (_look(parser, 1).type == TOKEN_LEFT_PAREN)
                 break;
-            return parse_assignment_stmt();
+            return parse_assignment_stmt(parser);
         }
         case TOKEN_FOR: 
-            return parse_for_stmt();
+            return parse_for_stmt(parser);
         case TOKEN_IF: 
-            return parse_if_stmt();
+            return parse_if_stmt(parser);
         // case TOKEN_BREAK: return parse_break_stmt();
         // case TOKEN_CONTINUE: return parse_continue_stmt();
         default: break;
     }
-    return parse_expr_stmt();
+    return parse_expr_stmt(parser);
 }
 
 static 
-AstNode *parse_return_stmt(void) {
-    _match(TOKEN_RETURN);
-    AstNode *expr = parse_expression();
+NodeIdx parse_return_stmt(Parser *parser) {
+    _match(parser, TOKEN_RETURN);
+    NodeIdx expr = parse_expression(parser);
     no_panic(expr);
 
-    if (!_match(TOKEN_SEMICOLON))
-        return _error(";");
+    if (!_match(parser, TOKEN_SEMICOLON))
+        return _error(parser, ";");
 
-    return new_return_stmt_node(expr);
+    return new_return_stmt_node(parser->ast, expr);
 }
 
 static 
-AstNode *parse_print_stmt(void) {
-    _match(TOKEN_PRINT);
-    AstNode *expr = parse_expression();
+NodeIdx parse_print_stmt(Parser *parser) {
+    _match(parser, TOKEN_PRINT);
+    NodeIdx expr = parse_expression(parser);
     no_panic(expr);
 
-    if (!_match(TOKEN_SEMICOLON))
-        return _error(";");
+    if (!_match(parser, TOKEN_SEMICOLON))
+        return _error(parser, ";");
 
-    return new_print_stmt_node(expr);
+    return new_print_stmt_node(parser->ast, expr);
 }
 
 static 
-AstNode *parse_while_stmt(void) {
-    _match(TOKEN_WHILE);
+NodeIdx parse_while_stmt(Parser *parser) {
+    _match(parser, TOKEN_WHILE);
 
-    if (!_match(TOKEN_LEFT_PAREN))
-        return _error("(");
+    if (!_match(parser, TOKEN_LEFT_PAREN))
+        return _error(parser, "(");
 
-    AstNode *condition = parse_expression();
+    NodeIdx condition = parse_expression(parser);
     no_panic(condition);
 
-    if (!_match(TOKEN_RIGHT_PAREN))
-        return _error(")");
+    if (!_match(parser, TOKEN_RIGHT_PAREN))
+        return _error(parser, ")");
 
-    AstNode *body = parse_block();
+    NodeIdx body = parse_block(parser);
     no_panic(condition);
 
-    return new_while_stmt_node(condition, body);
+    return new_while_stmt_node(parser->ast, condition, body);
 }
 
 static
-AstNode *parse_assignment_stmt(void) {
-    Token t = _peek();
-    _match(TOKEN_IDENTIFIER_LITERAL);
-    AstNode *lvalue = new_identifier_node(t);
+NodeIdx parse_assignment_stmt(Parser *parser) {
+    TokenIdx t = _cur(parser);
+    _match(parser, TOKEN_IDENTIFIER_LITERAL);
+    NodeIdx lvalue = new_identifier_node(parser->ast, t);
     no_panic(lvalue);
 
-    if (!_match(TOKEN_EQUAL)) 
-        return _error("=");
+    if (!_match(parser, TOKEN_EQUAL)) 
+        return _error(parser, "=");
 
-    AstNode *rvalue = parse_assignment();
+    NodeIdx rvalue = parse_assignment(parser);
     no_panic(rvalue);
 
-    if (!_match(TOKEN_SEMICOLON))
-        return _error(";");
+    if (!_match(parser, TOKEN_SEMICOLON))
+        return _error(parser, ";");
     
-    return new_assign_stmt_node(lvalue, rvalue);
+    return new_assign_stmt_node(parser->ast, lvalue, rvalue);
 }
 
 static 
-AstNode *parse_expr_stmt(void) {
-    AstNode *expr = parse_expression();
+NodeIdx parse_expr_stmt(Parser *parser) {
+    NodeIdx expr = parse_expression(parser);
     no_panic(expr);
 
-    if (!_match(TOKEN_SEMICOLON))
-        return _error("';'");
+    if (!_match(parser, TOKEN_SEMICOLON))
+        return _error(parser, "';'");
 
-    return new_expr_stmt_node(expr);
+    return new_expr_stmt_node(parser->ast, expr);
 }
 
 static 
-AstNode *parse_for_stmt(void) {
-    _match(TOKEN_FOR);
+NodeIdx parse_for_stmt(Parser *parser) {
+    _match(parser, TOKEN_FOR);
 
-    if (!_match(TOKEN_LEFT_PAREN))
-        return _error("(");
+    if (!_match(parser, TOKEN_LEFT_PAREN))
+        return _error(parser, "(");
     
-    AstNode *first = NULL;
-    if (_is_type(_peek())) {
-        first = parse_var_decl();
-    } else if (!_match(TOKEN_SEMICOLON)) {
-        first = parse_assignment_stmt();
+    NodeIdx first = NULL_NODE;
+    if (_is_type(_peek(parser))) {
+        first = parse_var_decl(parser);
+    } else if (!_match(parser, TOKEN_SEMICOLON)) {
+        first = parse_assignment_stmt(parser);
     }
     no_panic(first);
 
-    AstNode *second = NULL;
-    if (_peek().type != TOKEN_SEMICOLON) {
-        second = parse_expression();
+    NodeIdx second = NULL_NODE;
+    if (_peek(parser).type != TOKEN_SEMICOLON) {
+        second = parse_expression(parser);
     }
     no_panic(second);
 
-    if (!_match(TOKEN_SEMICOLON))
-        return _error(";");
+    if (!_match(parser, TOKEN_SEMICOLON))
+        return _error(parser, ";");
 
-    AstNode *third = NULL;
-    if (_peek().type != TOKEN_RIGHT_PAREN) {
-        third = parse_expression();
+    NodeIdx third = NULL_NODE;
+    if (_peek(parser).type != TOKEN_RIGHT_PAREN) {
+        third = parse_expression(parser);
     }
     no_panic(third);
 
-    if (!_match(TOKEN_RIGHT_PAREN))
-        return _error(")");
+    if (!_match(parser, TOKEN_RIGHT_PAREN))
+        return _error(parser, ")");
 
-    AstNode *body = parse_block();
+    NodeIdx body = parse_block(parser);
     no_panic(body);
 
-    return new_for_stmt_node(first, second, third, body);
+    return new_for_stmt_node(parser->ast, first, second, third, body);
 }
 
 static
-AstNode *parse_if_stmt(void) {
-    _match(TOKEN_IF);
+NodeIdx parse_if_stmt(Parser *parser) {
+    _match(parser, TOKEN_IF);
 
-    if (!_match(TOKEN_LEFT_PAREN))
-        return _error("(");
+    if (!_match(parser, TOKEN_LEFT_PAREN))
+        return _error(parser, "(");
 
-    AstNode *if_cond = parse_expression();
+    NodeIdx if_cond = parse_expression(parser);
     no_panic(if_cond);
 
-    if (!_match(TOKEN_RIGHT_PAREN))
-        return _error(")");
+    if (!_match(parser, TOKEN_RIGHT_PAREN))
+        return _error(parser, ")");
 
-    AstNode *then_block = parse_block();
+    NodeIdx then_block = parse_block(parser);
     no_panic(then_block);
 
+    ScratchArena scratch = scratch_begin(&parser->scratch);
     AstNodeArray elifs = {0};
-    while (_match(TOKEN_ELIF)) {
-        if (!_match(TOKEN_LEFT_PAREN))
-            return _error("(");
+    while (_match(parser, TOKEN_ELIF)) {
+        if (!_match(parser, TOKEN_LEFT_PAREN))
+            return _scratch_error(parser, scratch, "(");
 
-        AstNode *elif_cond = parse_expression();
-        no_panic(elif_cond);
+        NodeIdx elif_cond = parse_expression(parser);
+        no_panic_scratch(elif_cond, scratch);
 
-        if (!_match(TOKEN_RIGHT_PAREN))
-            return _error(")");
+        if (!_match(parser, TOKEN_RIGHT_PAREN))
+            return _scratch_error(parser, scratch, ")");
 
-        AstNode *elif_then_block = parse_block();
-        no_panic(elif_then_block);
+        NodeIdx elif_then_block = parse_block(parser);
+        no_panic_scratch(elif_then_block, scratch);
         
-        da_append(&elifs, new_elif_clause_node(elif_cond, elif_then_block));
+        list_append(&elifs, new_elif_clause_node(parser->ast, elif_cond, elif_then_block));
     }
     
-    AstNode *else_block = NULL;
-    if (_match(TOKEN_ELSE)) {
-        else_block = parse_block();
-        no_panic(else_block);
+    NodeIdx else_block = NULL_NODE;
+    if (_match(parser, TOKEN_ELSE)) {
+        else_block = parse_block(parser);
+        no_panic_scratch(else_block, scratch);
     }
 
-    AstNode *elif_node = elifs.count == 0 ? NULL : new_elif_clause_list_node(elifs);
-    return new_if_stmt_node(if_cond, then_block, elif_node, else_block);
+    NodeIdx elif_node = elifs.count == 0 ? NULL_NODE : new_elif_clause_list_node(parser->ast, elifs);
+    scratch_end(scratch);
+    return new_if_stmt_node(parser->ast, if_cond, then_block, elif_node, else_block);
 }
 
 static 
-AstNode *parse_var_decl(void) {
-    AstNode *type = parse_type();
+NodeIdx parse_var_decl(Parser *parser) {
+    NodeIdx type = parse_type(parser);
     no_panic(type);
 
-    Token name = _peek();
-    if (!_match(TOKEN_IDENTIFIER_LITERAL)) {
-        return _error("var_name");
+    TokenIdx name = _cur(parser);
+    if (!_match(parser, TOKEN_IDENTIFIER_LITERAL)) {
+        return _error(parser, "var_name");
     }
 
-    AstNode *initializer = NULL;
-    if (_match(TOKEN_EQUAL)) {
-        initializer = parse_expression();
+    NodeIdx initializer = NULL_NODE;
+    if (_match(parser, TOKEN_EQUAL)) {
+        initializer = parse_expression(parser);
         no_panic(initializer);
     }
 
-    if (!_match(TOKEN_SEMICOLON)) {
-        return _error(";");
+    if (!_match(parser, TOKEN_SEMICOLON)) {
+        return _error(parser, ";");
     }
-    return new_var_decl_node(type, name, initializer);
+    return new_var_decl_node(parser->ast, type, name, initializer);
 }
 
 static 
-AstNode *parse_type(void) {
-    Token t = _peek();
-    if (_match(TOKEN_NUM) ||
-        _match(TOKEN_STRING) ||
-        _match(TOKEN_BOOL) ||
-        _match(TOKEN_VOID)) {
-        return new_primitive_type_node(t);
+NodeIdx parse_type(Parser *parser) {
+    TokenIdx t = _cur(parser);
+    if (_match(parser, TOKEN_NUM) ||
+        _match(parser, TOKEN_STRING) ||
+        _match(parser, TOKEN_BOOL) ||
+        _match(parser, TOKEN_VOID)) {
+        return new_primitive_type_node(parser->ast, t);
     } else {
-        return _error("type");
+        return _error(parser, "type");
     }
 }
 
 static 
-AstNode *parse_expression(void) {
-    return parse_assignment();
+NodeIdx parse_expression(Parser *parser) {
+    return parse_assignment(parser);
 }
 
 static 
-AstNode *parse_assignment(void) {
-    AstNode *left = parse_logic_or();
+NodeIdx parse_assignment(Parser *parser) {
+    NodeIdx left = parse_logic_or(parser);
     no_panic(left);
 
-    if (_match(TOKEN_EQUAL)) {
-        AstNode *value = parse_assignment();
+    if (_match(parser, TOKEN_EQUAL)) {
+        NodeIdx value = parse_assignment(parser);
         no_panic(value);
         // Only lvalues can be assigned to; for now, just wrap as assign expr
-        return new_assign_expr_node(left, value);
+        return new_assign_expr_node(parser->ast, left, value);
     }
 
     return left;
 }
 
 static 
-AstNode *parse_logic_or(void) {
-    AstNode *left = parse_logic_and();
+NodeIdx parse_logic_or(Parser *parser) {
+    NodeIdx left = parse_logic_and(parser);
     no_panic(left);
 
-    while (_match(TOKEN_OR)) {
-        Token op = _look(-1);
-        AstNode *right = parse_logic_and();
+    while (_match(parser, TOKEN_OR)) {
+        TokenIdx op = _prev(parser);
+        NodeIdx right = parse_logic_and(parser);
         no_panic(right);
-        left = new_binary_expr_node(left, right, op);
+        left = new_binary_expr_node(parser->ast, left, right, op);
     }
 
     return left;
 }
 
 static 
-AstNode *parse_logic_and(void) {
-    AstNode *left = parse_equality();
+NodeIdx parse_logic_and(Parser *parser) {
+    NodeIdx left = parse_equality(parser);
     no_panic(left);
 
-    while (_match(TOKEN_AND)) {
-        Token op = _look(-1);
-        AstNode *right = parse_equality();
+    while (_match(parser, TOKEN_AND)) {
+        TokenIdx op = _prev(parser);
+        NodeIdx right = parse_equality(parser);
         no_panic(right);
-        left = new_binary_expr_node(left, right, op);
+        left = new_binary_expr_node(parser->ast, left, right, op);
     }
 
     return left;
 }
 
 static 
-AstNode *parse_equality(void) {
-    AstNode *left = parse_comparison();
+NodeIdx parse_equality(Parser *parser) {
+    NodeIdx left = parse_comparison(parser);
     no_panic(left);
 
-    while (_match(TOKEN_BANG_EQUAL) || _match(TOKEN_EQUAL_EQUAL)) {
-        Token op = _look(-1);
-        AstNode *right = parse_comparison();
+    while (_match(parser, TOKEN_BANG_EQUAL) || _match(parser, TOKEN_EQUAL_EQUAL)) {
+        TokenIdx op = _prev(parser);
+        NodeIdx right = parse_comparison(parser);
         no_panic(right);
-        left = new_binary_expr_node(left, right, op);
+        left = new_binary_expr_node(parser->ast, left, right, op);
     }
 
     return left;
 }
 
 static 
-AstNode *parse_comparison(void) {
-    AstNode *left = parse_term();
+NodeIdx parse_comparison(Parser *parser) {
+    NodeIdx left = parse_term(parser);
     no_panic(left);
 
-    while (_match(TOKEN_GREATER) || _match(TOKEN_GREATER_EQUAL) ||
-           _match(TOKEN_LESS) || _match(TOKEN_LESS_EQUAL)) {
-        Token op = _look(-1);
-        AstNode *right = parse_term();
+    while (_match(parser, TOKEN_GREATER) || _match(parser, TOKEN_GREATER_EQUAL) ||
+           _match(parser, TOKEN_LESS) || _match(parser, TOKEN_LESS_EQUAL)) {
+        TokenIdx op = _prev(parser);
+        NodeIdx right = parse_term(parser);
         no_panic(right);
-        left = new_binary_expr_node(left, right, op);
+        left = new_binary_expr_node(parser->ast, left, right, op);
     }
 
     return left;
 }
 
 static 
-AstNode *parse_term(void) {
-    AstNode *left = parse_factor();
+NodeIdx parse_term(Parser *parser) {
+    NodeIdx left = parse_factor(parser);
     no_panic(left);
 
-    while (_match(TOKEN_MINUS) || _match(TOKEN_PLUS)) {
-        Token op = _look(-1);
-        AstNode *right = parse_factor();
+    while (_match(parser, TOKEN_MINUS) || _match(parser, TOKEN_PLUS)) {
+        TokenIdx op = _prev(parser);
+        NodeIdx right = parse_factor(parser);
         no_panic(right);
-        left = new_binary_expr_node(left, right, op);
+        left = new_binary_expr_node(parser->ast, left, right, op);
     }
 
     return left;
 }
 
 static 
-AstNode *parse_factor(void) {
-    AstNode *left = parse_unary();
+NodeIdx parse_factor(Parser *parser) {
+    NodeIdx left = parse_unary(parser);
     no_panic(left);
 
-    while (_match(TOKEN_SLASH) || _match(TOKEN_STAR)) {
-        Token op = _look(-1);
-        AstNode *right = parse_unary();
+    while (_match(parser, TOKEN_SLASH) || _match(parser, TOKEN_STAR)) {
+        TokenIdx op = _prev(parser);
+        NodeIdx right = parse_unary(parser);
         no_panic(right);
-        left = new_binary_expr_node(left, right, op);
+        left = new_binary_expr_node(parser->ast, left, right, op);
     }
 
     return left;
 }
 
 static 
-AstNode *parse_unary(void) {
-    if (_match(TOKEN_BANG) || _match(TOKEN_MINUS)) {
-        Token op = _look(-1);
-        AstNode *operand = parse_unary();
+NodeIdx parse_unary(Parser *parser) {
+    if (_match(parser, TOKEN_BANG) || _match(parser, TOKEN_MINUS)) {
+        TokenIdx op = _prev(parser);
+        NodeIdx operand = parse_unary(parser);
         no_panic(operand);
-        return new_unary_expr_node(operand, op);
+        return new_unary_expr_node(parser->ast, operand, op);
     }
-    return parse_call();
+    return parse_call(parser);
 }
 
 static 
-AstNode *parse_call(void) {
-    AstNode *expr = parse_primary();
+NodeIdx parse_call(Parser *parser) {
+    NodeIdx expr = parse_primary(parser);
     no_panic(expr);
 
-    if (_match(TOKEN_LEFT_PAREN)) {
-        AstNode *args = parse_arguments();
+    if (_match(parser, TOKEN_LEFT_PAREN)) {
+        NodeIdx args = parse_arguments(parser);
         no_panic(args);
 
-        if (!_match(TOKEN_RIGHT_PAREN))
-            return _error("')' after arguments");
+        if (!_match(parser, TOKEN_RIGHT_PAREN))
+            return _error(parser, "')' after arguments");
 
-        return new_call_expr_node(expr, args);
+        return new_call_expr_node(parser->ast, expr, args);
     }
 
     return expr;
 }
 
 static 
-AstNode *parse_arguments(void) {
+NodeIdx parse_arguments(Parser *parser) {
     AstNodeArray args = {0};
-    if (_peek().type == TOKEN_RIGHT_PAREN)
-        return new_argument_list_node(args);
+    if (_peek(parser).type == TOKEN_RIGHT_PAREN)
+        return new_argument_list_node(parser->ast, args);
 
+    ScratchArena scratch = scratch_begin(&parser->scratch);
     do {
-        AstNode *arg = parse_expression();
-        no_panic(arg);
-        da_append(&args, arg);
-    } while (_match(TOKEN_COMMA));
+        NodeIdx arg = parse_expression(parser);
+        no_panic_scratch(arg, scratch);
+        list_append(&args, arg);
+    } while (_match(parser, TOKEN_COMMA));
     
-    return new_argument_list_node(args);
+    NodeIdx list = new_argument_list_node(parser->ast, args);
+    scratch_end(scratch);
+    return list;
 }
 
 static 
-AstNode *parse_primary(void) {
-    Token t = _peek();
+NodeIdx parse_primary(Parser *parser) {
+    TokenIdx t = _cur(parser);
 
-    if (_match(TOKEN_NUMBER_LITERAL))
-        return new_number_literal_node(t);
+    if (_match(parser, TOKEN_NUMBER_LITERAL))
+        return new_number_literal_node(parser->ast, t);
 
-    if (_match(TOKEN_STRING_LITERAL))
-        return new_string_literal_node(t);
+    if (_match(parser, TOKEN_STRING_LITERAL))
+        return new_string_literal_node(parser->ast, t);
 
-    if (_match(TOKEN_BOOL_LITERAL))
-        return new_bool_literal_node(t);
+    if (_match(parser, TOKEN_BOOL_LITERAL))
+        return new_bool_literal_node(parser->ast, t);
 
-    if (_match(TOKEN_IDENTIFIER_LITERAL))
-        return new_identifier_node(t);
+    if (_match(parser, TOKEN_IDENTIFIER_LITERAL))
+        return new_identifier_node(parser->ast, t);
 
-    if (_match(TOKEN_LEFT_PAREN)) {
-        AstNode *expr = parse_expression();
+    if (_match(parser, TOKEN_LEFT_PAREN)) {
+        NodeIdx expr = parse_expression(parser);
         no_panic(expr);
 
-        if (!_match(TOKEN_RIGHT_PAREN))
-            return _error(")");
+        if (!_match(parser, TOKEN_RIGHT_PAREN))
+            return _error(parser, ")");
 
-        return new_paren_expr_node(expr);
+        return new_paren_expr_node(parser->ast, expr);
     }
     
-    return _error("primary");
+    return _error(parser, "primary");
 }
 
 static inline
-void _init_parser(TokenArray tokens) {
-    parser.tokens = tokens;
-    parser.current = 0;
-    parser.error = false;
-    parser.panic = false;
-}
-
-ParseResult parse(TokenArray tokens) {
-    _init_parser(tokens);
-    init_special_nodes();
-    return (ParseResult) { parse_program(), parser.error };
-}
-
-void free_ast(AstNode *program) {
-    UNUSED(program);
-    free_special_nodes();
+void _init_parser(Parser *parser, Ast *ast, SymbolTable *symbols) {
+    *parser = (Parser) {0};
+    parser->ast = ast;
+    init_scanner(&parser->scanner, &ast->text, symbols);
+    _fill(parser, 0);
+    parser->scratch = arena_init(PARSER_SCRATCH_SIZE);
+}
+
+ParseResult parse(byte *source, SymbolTable *symbols) {
+    ParseResult res = {0};
+    init_special_nodes(&res.ast);
+    res.ast.text.s = source;
+
+    Parser parser;
+    _init_parser(&parser, &res.ast, symbols);
+    res.ast.root = parse_program(&parser);
+    res.error = parser.error || parser.scanner.error;
+    res.scratch = parser.scratch.stats;
+    arena_free(&parser.scratch);
+    return res;
+}
+
+void free_ast(Ast *ast) {
+    free_special_nodes(ast);
 }
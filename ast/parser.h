@@ -3,13 +3,18 @@
 
 #include "node.h"
 #include "token.h"
+#include "arena.h"
 
 typedef struct {
-    AstNode *program;
+    Ast ast; // ast.root is the program node
+    ArenaStats scratch; // of the parser's scratch arena, as it was freed
     b32 error;
 } ParseResult;
 
-ParseResult parse(TokenArray tokens);
-void free_ast(AstNode *program);
+// Scans the source while parsing it. The tokens kept in the Ast
+// point into the source, so it has to outlive the Ast. Identifiers
+// are interned into 'symbols'.
+ParseResult parse(byte *source, SymbolTable *symbols);
+void free_ast(Ast *ast);
 
 #endif
\ No newline at end of file
@@ -1,22 +1,141 @@
 #include "scanner.h"
 #include <stdio.h>
 #include <string.h>
-#include "da.h"
+#include <pthread.h>
+
+// The keyword table is filled in by the first scanner
+static void _init_keywords(void);
+static pthread_once_t keywords_once = PTHREAD_ONCE_INIT;
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void init_scanner(Scanner *scanner, SourceText *text, SymbolTable *symbols) {
+    scanner->text = text;
+    scanner->symbols = symbols;
+    scanner->current = text->s;
+    scanner->start = text->s;
+    scanner->end = text->s + strlen(text->s);
+    scanner->error = false;
+
+    pthread_once(&keywords_once, _init_keywords);
+
+    // Tokens keep 32-bit offsets
+    if (scanner->end - text->s >= (isize)(u32)-1) {
+        fprintf(stderr, "Scan error: source is larger than %u bytes\n", (u32)-1);
+        // Nothing is scanned, the first token is EOF
+        scanner->current = scanner->start = scanner->end;
+        scanner->error = true;
+    }
+}
+
+// Byte classes the scanner skips runs of
+typedef enum {
+    CLASS_SPACE,       // ' ', '\t', '\r', '\n'
+    CLASS_IDENT,       // letters, digits and '_'
+    CLASS_DIGIT,
+    CLASS_NOT_QUOTE,   // string literal contents
+    CLASS_NOT_NEWLINE  // comment contents
+} ByteClass;
+
+static inline
+b32 _in_class(byte c, ByteClass class) {
+    switch (class) {
+        case CLASS_SPACE:       return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        case CLASS_IDENT:       return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                                       (c >= '0' && c <= '9') || c == '_';
+        case CLASS_DIGIT:       return c >= '0' && c <= '9';
+        case CLASS_NOT_QUOTE:   return c != '"';
+        case CLASS_NOT_NEWLINE: return c != '\n';
+        default:                return false;
+    }
+}
+
+// The vector paths look at SCAN_WIDTH bytes at once and turn every
+// test into a bit mask with one bit per byte. These are macros so
+// that they collapse into the intrinsics even without optimizations.
+#if defined(__AVX2__)
+
+#define SCAN_WIDTH 32
+typedef __m256i Chunk;
+
+#define chunk_load(p)       _mm256_loadu_si256((const __m256i *)(p))
+#define chunk_splat(c)      _mm256_set1_epi8(c)
+#define chunk_mask(v)       ((u32)_mm256_movemask_epi8(v))
+#define chunk_eq(v, c)      _mm256_cmpeq_epi8((v), chunk_splat(c))
+#define chunk_or(a, b)      _mm256_or_si256((a), (b))
+#define chunk_and(a, b)     _mm256_and_si256((a), (b))
+#define chunk_gt(v, c)      _mm256_cmpgt_epi8((v), chunk_splat(c))
+#define chunk_lt(v, c)      _mm256_cmpgt_epi8(chunk_splat(c), (v))
+
+#elif defined(__SSE2__)
 
-typedef struct Scanner {
-    byte *start;
-    byte *current;
-    u32 line;
-    b32 error;
-} Scanner;
+#define SCAN_WIDTH 16
+typedef __m128i Chunk;
 
-static Scanner scanner;
+#define chunk_load(p)       _mm_loadu_si128((const __m128i *)(p))
+#define chunk_splat(c)      _mm_set1_epi8(c)
+#define chunk_mask(v)       ((u32)_mm_movemask_epi8(v))
+#define chunk_eq(v, c)      _mm_cmpeq_epi8((v), chunk_splat(c))
+#define chunk_or(a, b)      _mm_or_si128((a), (b))
+#define chunk_and(a, b)     _mm_and_si128((a), (b))
+#define chunk_gt(v, c)      _mm_cmpgt_epi8((v), chunk_splat(c))
+#define chunk_lt(v, c)      _mm_cmplt_epi8((v), chunk_splat(c))
 
+#endif
+
+#ifdef SCAN_WIDTH
+
+// Compares are signed, bytes >= 0x80 never fall into a range
+#define chunk_in_range(v, lo, hi) chunk_and(chunk_gt((v), (lo) - 1), chunk_lt((v), (hi) + 1))
+
+static inline
+u32 _class_mask(Chunk v, ByteClass class) {
+    switch (class) {
+        case CLASS_SPACE:
+            return chunk_mask(chunk_or(chunk_or(chunk_eq(v, ' '), chunk_eq(v, '\t')),
+                                       chunk_or(chunk_eq(v, '\r'), chunk_eq(v, '\n'))));
+        case CLASS_IDENT: {
+            // Setting bit 5 folds upper case letters onto lower case
+            Chunk lower = chunk_or(v, chunk_splat(0x20));
+            return chunk_mask(chunk_or(chunk_or(chunk_in_range(lower, 'a', 'z'),
+                                                chunk_in_range(v, '0', '9')),
+                                       chunk_eq(v, '_')));
+        }
+        case CLASS_DIGIT:       return chunk_mask(chunk_in_range(v, '0', '9'));
+        case CLASS_NOT_QUOTE:   return ~chunk_mask(chunk_eq(v, '"'));
+        case CLASS_NOT_NEWLINE: return ~chunk_mask(chunk_eq(v, '\n'));
+        default:                return 0;
+    }
+}
+
+#endif
+
+// Length of the run of 'class' bytes at 'p'
 static inline
-void _init_scanner(byte *source) {
-    scanner.current = source;
-    scanner.start = source;
-    scanner.line = 1;
+isize _span(Scanner *scanner, byte *p, ByteClass class) {
+    byte *start = p;
+
+    // Most runs are a few bytes long, those are not worth a load
+    for (byte *short_end = p + 8; p < short_end; ++p) {
+        if (p == scanner->end || !_in_class(*p, class)) return p - start;
+    }
+
+#ifdef SCAN_WIDTH
+    const u32 all = SCAN_WIDTH == 32 ? 0xFFFFFFFFu : (1u << SCAN_WIDTH) - 1;
+    while (scanner->end - p >= SCAN_WIDTH) {
+        Chunk v = chunk_load(p);
+        u32 stop = ~_class_mask(v, class) & all;
+        if (stop) return p + __builtin_ctz(stop) - start;
+        p += SCAN_WIDTH;
+    }
+#endif
+
+    while (p < scanner->end && _in_class(*p, class)) p++;
+    return p - start;
 }
 
 static inline 
@@ -32,227 +151,215 @@ b32 _is_digit(byte c) {
 }
 
 static inline 
-b32 _is_at_end(void) {
-    return *scanner.current == '\0';
+b32 _is_at_end(Scanner *scanner) {
+    return *scanner->current == '\0';
 }
 
 static inline 
-byte _advance(void) {
-    scanner.current++;
-    return scanner.current[-1];
+byte _advance(Scanner *scanner) {
+    scanner->current++;
+    return scanner->current[-1];
 }
 
 static inline 
-byte _peek(void) {
-    return *scanner.current;
+byte _peek(Scanner *scanner) {
+    return *scanner->current;
 }
 
 static inline 
-byte _peek_next(void) {
-    if (_is_at_end()) return '\0';
-    return scanner.current[1];
+byte _peek_next(Scanner *scanner) {
+    if (_is_at_end(scanner)) return '\0';
+    return scanner->current[1];
 }
 
 static inline 
-b32 _match(byte expected) {
-    if (_is_at_end()) return false;
-    if (*scanner.current != expected) return false;
-    scanner.current++;
+b32 _match(Scanner *scanner, byte expected) {
+    if (_is_at_end(scanner)) return false;
+    if (*scanner->current != expected) return false;
+    scanner->current++;
     return true;
 }
 
 static inline
-Token _new_token(TokenType type) {
+Token _new_token(Scanner *scanner, TokenType type) {
     return (Token) {
-        .line = scanner.line,
         .type = type,
-        .str = s8(scanner.start, scanner.current - scanner.start)
+        .offset = scanner->start - scanner->text->s,
+        .len = scanner->current - scanner->start
     };
 }
 
 static inline
-Token _error_token(byte *msg) {
-    fprintf(stderr, "Scan error: '%s' at line %d\n", msg, scanner.line);
-    scanner.error = true;
-    return (Token) {
-        .line = scanner.line,
-        .type = TOKEN_ERROR,
-        .str = s8(msg, scanner.current - scanner.start)
-    };
+Token _error_token(Scanner *scanner, byte *msg) {
+    fprintf(stderr, "Scan error: '%s' at line %d\n", msg,
+        source_line(scanner->text, scanner->current - scanner->text->s));
+    scanner->error = true;
+    return _new_token(scanner, TOKEN_ERROR);
 }
 
 static inline
-void _skip_whitespace(void) {
+void _skip_whitespace(Scanner *scanner) {
     for (;;) {
-        byte c = _peek();
-        switch (c) {
-        case ' ':
-        case '\r':
-        case '\t':
-            _advance();
-            break;
-        case '\n':
-            scanner.line++;
-            _advance();
-            break;
-        case '/':
-            if (_peek_next() == '/') {
-                while (_peek() != '\n' && !_is_at_end()) _advance();
-            } else {
-                return;
-            }
-            break;
-        default:
-            return;
-        }
+        scanner->current += _span(scanner, scanner->current, CLASS_SPACE);
+        if (_peek(scanner) != '/' || _peek_next(scanner) != '/') return;
+
+        // The newline ending the comment is left for the next round
+        scanner->current += _span(scanner, scanner->current, CLASS_NOT_NEWLINE);
     }
 }
 
-static inline 
-TokenType _check_keyword(i32 start, i32 length, const byte *rest, TokenType type) {
-    if ((scanner.current - scanner.start) == start + length &&
-        memcmp(scanner.start + start, rest, length) == 0) {
-        return type;
-    }
-    return TOKEN_IDENTIFIER_LITERAL;
+// Keywords are looked up in a table indexed by a hash of the first
+// byte, the last byte and the length. Adding a keyword only takes a
+// line here, its slot is worked out from the string. Keywords landing
+// in a taken slot go to the next free one, that slot is then probed
+// after the first.
+#define KEYWORDS(X)                     \
+    X("and",      TOKEN_AND)            \
+    X("bool",     TOKEN_BOOL)           \
+    X("break",    TOKEN_BREAK)          \
+    X("continue", TOKEN_CONTINUE)       \
+    X("elif",     TOKEN_ELIF)           \
+    X("else",     TOKEN_ELSE)           \
+    X("false",    TOKEN_BOOL_LITERAL)   \
+    X("fn",       TOKEN_FN)             \
+    X("for",      TOKEN_FOR)            \
+    X("if",       TOKEN_IF)             \
+    X("import",   TOKEN_IMPORT)         \
+    X("num",      TOKEN_NUM)            \
+    X("or",       TOKEN_OR)             \
+    X("print",    TOKEN_PRINT)          \
+    X("return",   TOKEN_RETURN)         \
+    X("string",   TOKEN_STRING)         \
+    X("struct",   TOKEN_STRUCT)         \
+    X("true",     TOKEN_BOOL_LITERAL)   \
+    X("void",     TOKEN_VOID)           \
+    X("while",    TOKEN_WHILE)
+
+#define KEYWORD_SLOTS 64
+#define KEYWORD_HASH(first, last, len) \
+    (((u32)(first) + ((u32)(last) << 2) + (u32)(len) * 5) & (KEYWORD_SLOTS - 1))
+
+// A free slot ends every probe
+#define KEYWORD_COUNT(name, type) 1 +
+_Static_assert(KEYWORDS(KEYWORD_COUNT) 0 < KEYWORD_SLOTS, "KEYWORD_SLOTS is too small");
+
+typedef struct {
+    const byte *name;
+    isize len; // 0 marks an empty slot
+    TokenType type;
+} Keyword;
+
+static Keyword keywords[KEYWORD_SLOTS];
+
+static
+void _add_keyword(const byte *name, isize len, TokenType type) {
+    u32 slot = KEYWORD_HASH((u8)name[0], (u8)name[len - 1], len);
+    while (keywords[slot].len != 0) slot = (slot + 1) & (KEYWORD_SLOTS - 1);
+    keywords[slot] = (Keyword) {name, len, type};
+}
+
+#define KEYWORD_ADD(name, type) _add_keyword(name, sizeof(name) - 1, type);
+
+// Scanners on other threads wait for it, see init_scanner()
+static
+void _init_keywords(void) {
+    KEYWORDS(KEYWORD_ADD)
 }
 
 static inline 
-TokenType _identifier_type(void) {
-    isize len = scanner.current - scanner.start;
-    switch (scanner.start[0]) {
-        case 'a': return _check_keyword(1, 2, "nd", TOKEN_AND);
-        case 'b': 
-            if (len > 1) {
-                switch (scanner.start[1]) {
-                    case 'o': return _check_keyword(2, 2, "ol", TOKEN_BOOL);
-                    case 'r': return _check_keyword(2, 3, "eak", TOKEN_BREAK);
-                }
-            }
-            break;
-        case 'c': return _check_keyword(1, 7, "ontinue", TOKEN_CONTINUE);
-        case 'e':
-            if (len > 2) {
-                switch (scanner.start[1]) {
-                    case 'l':
-                        if (scanner.start[2] == 'i')
-                            return _check_keyword(3, 1, "f", TOKEN_ELIF);
-                        else
-                            return _check_keyword(2, 2, "se", TOKEN_ELSE);
-                }
-            }
-            break;
-        case 'f':
-            if (len > 1) {
-                switch (scanner.start[1]) {
-                    case 'a': return _check_keyword(2, 3, "lse", TOKEN_BOOL_LITERAL);
-                    case 'n': return _check_keyword(2, 0, "", TOKEN_FN);
-                    case 'o': return _check_keyword(2, 1, "r", TOKEN_FOR);
-                }
-            }
-            break;
-        case 'i':
-            if (len > 1) {
-                switch (scanner.start[1]) {
-                    case 'm': return _check_keyword(2, 4, "port", TOKEN_IMPORT);
-                    case 'f': return _check_keyword(2, 0, "", TOKEN_IF);
-                }
-            }
-            break;
-        case 'n':
-            if ((len) == 3)
-                return _check_keyword(1, 2, "um", TOKEN_NUM);
-            break;
-        case 'o': return _check_keyword(1, 1, "r", TOKEN_OR);
-        case 'p': return _check_keyword(1, 4, "rint", TOKEN_PRINT);
-        case 'r': return _check_keyword(1, 5, "eturn", TOKEN_RETURN);
-        case 's': 
-            if (len > 3 && memcmp(scanner.start, "str", 3) == 0) {
-                switch (scanner.start[3]) {
-                    case 'u': return _check_keyword(4, 2, "ct", TOKEN_STRUCT);
-                    case 'i': return _check_keyword(4, 2, "ng", TOKEN_STRING);
-                }
-            }
-            break;
-        case 't': return _check_keyword(1, 3, "rue", TOKEN_BOOL_LITERAL);
-        case 'v': return _check_keyword(1, 3, "oid", TOKEN_VOID);
-        case 'w': return _check_keyword(1, 4, "hile", TOKEN_WHILE);
+TokenType _identifier_type(Scanner *scanner) {
+    isize len = scanner->current - scanner->start;
+    u32 slot = KEYWORD_HASH((u8)scanner->start[0], (u8)scanner->current[-1], len);
+    for (; keywords[slot].len != 0; slot = (slot + 1) & (KEYWORD_SLOTS - 1)) {
+        const Keyword *kw = &keywords[slot];
+        if (kw->len == len && memcmp(kw->name, scanner->start, len) == 0)
+            return kw->type;
     }
     return TOKEN_IDENTIFIER_LITERAL;
 }
 
-static inline Token _identifier(void) {
-    while (_is_alpha(_peek()) || _is_digit(_peek())) _advance();
-    return _new_token(_identifier_type());
+static inline Token _identifier(Scanner *scanner) {
+    scanner->current += _span(scanner, scanner->current, CLASS_IDENT);
+    Token token = _new_token(scanner, _identifier_type(scanner));
+    if (token.type == TOKEN_IDENTIFIER_LITERAL)
+        token.sym = intern(scanner->symbols, s8(scanner->start, token.len));
+    return token;
 }
 
-static inline Token _number(void) {
-    while (_is_digit(_peek())) _advance();
-    if (_peek() == '.' && _is_digit(_peek_next())) {
-        _advance();
-        while (_is_digit(_peek())) _advance();
+static inline Token _number(Scanner *scanner) {
+    scanner->current += _span(scanner, scanner->current, CLASS_DIGIT);
+    if (_peek(scanner) == '.' && _is_digit(_peek_next(scanner))) {
+        _advance(scanner);
+        scanner->current += _span(scanner, scanner->current, CLASS_DIGIT);
     }
-    return _new_token(TOKEN_NUMBER_LITERAL);
+    return _new_token(scanner, TOKEN_NUMBER_LITERAL);
 }
 
-static inline Token _string(void) {
-    while (_peek() != '"' && !_is_at_end()) {
-        if (_peek() == '\n') scanner.line++;
-        _advance();
-    }
-    if (_is_at_end()) return _error_token("Unterminated string");
+static inline Token _string(Scanner *scanner) {
+    scanner->current += _span(scanner, scanner->current, CLASS_NOT_QUOTE);
+    if (_is_at_end(scanner)) return _error_token(scanner, "Unterminated string");
 
-    _advance(); // Consume closing quote
-    return _new_token(TOKEN_STRING_LITERAL);
+    _advance(scanner); // Consume closing quote
+    return _new_token(scanner, TOKEN_STRING_LITERAL);
 }
 
 static inline
-Token _scanToken(void) {
-    _skip_whitespace();
-    scanner.start = scanner.current;
+Token _scanToken(Scanner *scanner) {
+    _skip_whitespace(scanner);
+    scanner->start = scanner->current;
 
-    if (_is_at_end()) return _new_token(TOKEN_EOF);
+    if (_is_at_end(scanner)) return _new_token(scanner, TOKEN_EOF);
 
-    byte c = _advance();
-    if (_is_alpha(c)) return _identifier();
-    if (_is_digit(c)) return _number();
+    byte c = _advance(scanner);
+    if (_is_alpha(c)) return _identifier(scanner);
+    if (_is_digit(c)) return _number(scanner);
 
     switch (c) {
-        case '(': return _new_token(TOKEN_LEFT_PAREN);
-        case ')': return _new_token(TOKEN_RIGHT_PAREN);
-        case '[': return _new_token(TOKEN_LEFT_BRACKET);
-        case ']': return _new_token(TOKEN_RIGHT_BRACKET);
-        case '{': return _new_token(TOKEN_LEFT_BRACE);
-        case '}': return _new_token(TOKEN_RIGHT_BRACE);
-        case ';': return _new_token(TOKEN_SEMICOLON);
-        case ',': return _new_token(TOKEN_COMMA);
-        case '.': return _new_token(TOKEN_DOT);
-        case '-': return _new_token(TOKEN_MINUS);
-        case '+': return _new_token(TOKEN_PLUS);
-        case '/': return _new_token(TOKEN_SLASH);
-        case '*': return _new_token(TOKEN_STAR);
-        case '!': return _new_token(_match('=') ? TOKEN_BANG_EQUAL : TOKEN_BANG);
-        case '=': return _new_token(_match('=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL);
-        case '<': return _new_token(_match('=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
-        case '>': return _new_token(_match('=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER);
-        case '"': return _string();
+        case '(': return _new_token(scanner, TOKEN_LEFT_PAREN);
+        case ')': return _new_token(scanner, TOKEN_RIGHT_PAREN);
+        case '[': return _new_token(scanner, TOKEN_LEFT_BRACKET);
+        case ']': return _new_token(scanner, TOKEN_RIGHT_BRACKET);
+        case '{': return _new_token(scanner, TOKEN_LEFT_BRACE);
+        case '}': return _new_token(scanner, TOKEN_RIGHT_BRACE);
+        case ';': return _new_token(scanner, TOKEN_SEMICOLON);
+        case ',': return _new_token(scanner, TOKEN_COMMA);
+        case '.': return _new_token(scanner, TOKEN_DOT);
+        case '-': return _new_token(scanner, TOKEN_MINUS);
+        case '+': return _new_token(scanner, TOKEN_PLUS);
+        case '/': return _new_token(scanner, TOKEN_SLASH);
+        case '*': return _new_token(scanner, TOKEN_STAR);
+        case '!': return _new_token(scanner, _match(scanner, '=') ? TOKEN_BANG_EQUAL : TOKEN_BANG);
+        case '=': return _new_token(scanner, _match(scanner, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL);
+        case '<': return _new_token(scanner, _match(scanner, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
+        case '>': return _new_token(scanner, _match(scanner, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER);
+        case '"': return _string(scanner);
   }
 
-  return _error_token("Unexpected character");
+  return _error_token(scanner, "Unexpected character");
+}
+
+Token next_token(Scanner *scanner) {
+    return _scanToken(scanner);
 }
 
-ScanResult scan(byte *source) {
-    _init_scanner(source);
+ScanResult scan(SourceText *text, SymbolTable *symbols) {
+    Scanner scanner;
+    init_scanner(&scanner, text, symbols);
+
+    // Every token but EOF takes at least one byte, so this reservation
+    // is never outgrown and the array keeps growing in place
+    Arena arena = arena_reserve((strlen(text->s) + 1) * sizeof(Token));
 
     TokenArray tokens = {0};
     while (true) {
-        Token token = _scanToken();
-        da_append(&tokens, token);
+        Token token = next_token(&scanner);
+        arena_da_append(&arena, &tokens, token);
         if (token.type == TOKEN_EOF) break;
     }
 
     return (ScanResult) {
         .tokens = tokens,
+        .arena = arena,
         .error = scanner.error
     };
 }
@@ -310,16 +417,21 @@ byte *_token_type_to_str(TokenType type) {
     }
 }
 
-void pretty_print_tokens(TokenArray tokens) {
+static inline
+u32 _line(SourceText *text, Token token) {
+    return source_line(text, token.offset);
+}
+
+void pretty_print_tokens(SourceText *text, TokenArray tokens) {
     if (tokens.count == 0) return;
 
-    u32 current_line = tokens.items[0].line;
+    u32 current_line = _line(text, tokens.items[0]);
     printf("%u: ", current_line);
 
     // Print the first line's lexemes
     for (usize i = 0; i < tokens.count; ++i) {
-        if (tokens.items[i].line != current_line) break;
-        fwrite(tokens.items[i].str.s, 1, tokens.items[i].str.len, stdout);
+        if (_line(text, tokens.items[i]) != current_line) break;
+        fwrite(text->s + tokens.items[i].offset, 1, tokens.items[i].len, stdout);
         putchar(' ');
     }
     putchar('\n');
@@ -327,31 +439,31 @@ void pretty_print_tokens(TokenArray tokens) {
     // Print the first line's token types
     printf("%u: ", current_line);
     for (usize i = 0; i < tokens.count; ++i) {
-        if (tokens.items[i].line != current_line) break;
+        if (_line(text, tokens.items[i]) != current_line) break;
         printf("%s ", _token_type_to_str(tokens.items[i].type));
     }
     putchar('\n');
 
     // Print subsequent lines
     for (usize i = 0; i < tokens.count;) {
-        u32 line = tokens.items[i].line;
+        u32 line = _line(text, tokens.items[i]);
         if (line == current_line) {
             // Already printed above
-            while (i < tokens.count && tokens.items[i].line == current_line) ++i;
+            while (i < tokens.count && _line(text, tokens.items[i]) == current_line) ++i;
             continue;
         }
         current_line = line;
         printf("%u: ", current_line);
         usize j = i;
-        while (j < tokens.count && tokens.items[j].line == current_line) {
-            fwrite(tokens.items[j].str.s, 1, tokens.items[j].str.len, stdout);
+        while (j < tokens.count && _line(text, tokens.items[j]) == current_line) {
+            fwrite(text->s + tokens.items[j].offset, 1, tokens.items[j].len, stdout);
             putchar(' ');
             ++j;
         }
         putchar('\n');
         printf("%u: ", current_line);
         j = i;
-        while (j < tokens.count && tokens.items[j].line == current_line) {
+        while (j < tokens.count && _line(text, tokens.items[j]) == current_line) {
             printf("%s ", _token_type_to_str(tokens.items[j].type));
             ++j;
         }
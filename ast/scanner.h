@@ -3,13 +3,31 @@
 
 #include "types.h"
 #include "token.h"
+#include "arena.h"
+#include "source.h"
 
 typedef struct {
     TokenArray tokens;
+    Arena arena; // owns the tokens
     b32 error;
 } ScanResult;
 
-ScanResult scan(byte *path);
-void pretty_print_tokens(TokenArray tokens);
+typedef struct {
+    SourceText *text;
+    SymbolTable *symbols; // identifiers are interned here
+    byte *start;
+    byte *current;
+    byte *end; // the terminating '\0'
+    b32 error; // an error token was returned
+} Scanner;
+
+// The parser pulls tokens one at a time. Once the source is used up
+// every call returns TOKEN_EOF.
+void init_scanner(Scanner *scanner, SourceText *text, SymbolTable *symbols);
+Token next_token(Scanner *scanner);
+
+// Tokenizes the whole source at once, only meant for debugging
+ScanResult scan(SourceText *text, SymbolTable *symbols);
+void pretty_print_tokens(SourceText *text, TokenArray tokens);
 
 #endif
\ No newline at end of file
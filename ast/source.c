@@ -0,0 +1,90 @@
+#include "source.h"
+#include "da.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The file is mapped read-only in front of at least one zero byte,
+// which is the '\0' the scanner stops at. Bytes past the end of a
+// file in its last page read as zero. When the file fills its last
+// page exactly, the anonymous page behind it provides the zero.
+byte *map_source(byte *path, usize *mapped) {
+    i32 fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Could not open file \"%s\".\n", path);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Could not read file \"%s\".\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    usize file_size = st.st_size;
+    usize page = sysconf(_SC_PAGESIZE);
+    usize size = (file_size / page + 1) * page;
+
+    byte *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    if (file_size > 0 &&
+        mmap(base, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        fprintf(stderr, "Could not read file \"%s\".\n", path);
+        munmap(base, size);
+        close(fd);
+        return NULL;
+    }
+
+    close(fd);
+    *mapped = size;
+    return base;
+}
+
+void unmap_source(byte *source, usize mapped) {
+    munmap(source, mapped);
+}
+
+typedef struct {
+    u32 *items;
+    usize count;
+    usize capacity;
+} OffsetArray;
+
+static
+void _find_lines(SourceText *text) {
+    OffsetArray starts = {0};
+    da_append(&starts, 0);
+    for (byte *p = text->s; *p; ++p) {
+        if (*p == '\n') da_append(&starts, (u32)(p + 1 - text->s));
+    }
+    text->line_starts = starts.items;
+    text->line_count = starts.count;
+}
+
+u32 source_line(SourceText *text, u32 offset) {
+    if (text->line_starts == NULL) _find_lines(text);
+
+    // Last line starting at or before the offset
+    usize lo = 0, hi = text->line_count;
+    while (hi - lo > 1) {
+        usize mid = lo + (hi - lo) / 2;
+        if (text->line_starts[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+    return lo + 1;
+}
+
+void free_source_lines(SourceText *text) {
+    free(text->line_starts);
+    text->line_starts = NULL;
+    text->line_count = 0;
+}
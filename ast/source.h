@@ -0,0 +1,24 @@
+#ifndef SOURCE_INCLUDE
+#define SOURCE_INCLUDE
+
+#include "types.h"
+
+// Maps a source file read-only, terminated by a '\0'. Tokens point
+// straight into the mapping, so it has to outlive them. Reports
+// errors on stderr and returns NULL on failure.
+byte *map_source(byte *path, usize *mapped);
+void unmap_source(byte *source, usize mapped);
+
+// Tokens keep offsets into the text. Line numbers are only needed for
+// messages, so the line starts are collected the first time one is
+// asked for.
+typedef struct {
+    byte *s;
+    u32 *line_starts;
+    usize line_count;
+} SourceText;
+
+u32 source_line(SourceText *text, u32 offset);
+void free_source_lines(SourceText *text);
+
+#endif
@@ -3,50 +3,94 @@
 #include <stdlib.h>
 #include "da.h"
 
-static AstNodeArray array;
+#define AST_INIT_CAP 1024
 
-void init_special_nodes(void) {
-    array = (AstNodeArray) {0};
-}
-
-static inline
-b32 _has_array(AstNodeType t) {
-    return t == AST_PARAMETER_LIST   ||
-           t == AST_ARGUMENT_LIST    ||
-           t == AST_ELIF_CLAUSE_LIST ||
-           t == AST_BLOCK            ||
-           t == AST_PROGRAM;
+static
+void *_grow(void *items, usize capacity, usize item_size) {
+    items = realloc(items, capacity * item_size);
+    if (!items) {
+        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+        exit(-1);
+    }
+    return items;
 }
 
-void free_special_nodes(void) { 
-    for (usize i = 0; i < array.count; ++i) {
-        AstNode *item = array.items[i];
-        if (_has_array(item->ast_type)) {
-            BlockNode *b = (BlockNode *)item;
-            da_free(b->statements);
+static
+NodeIdx _add_node(Ast *ast, AstNodeType tag, TokenIdx token, AstData data) {
+    if (ast->count >= ast->capacity) {
+        if (ast->count >= (NodeIdx)-1) {
+            fprintf(stderr, "Too many AST nodes, %s, %d\n", __FILE__, __LINE__);
+            exit(-1);
         }
-        free(item);
+        ast->capacity = ast->capacity ? ast->capacity * 2 : AST_INIT_CAP;
+        ast->tags   = _grow(ast->tags, ast->capacity, sizeof(*ast->tags));
+        ast->tokens = _grow(ast->tokens, ast->capacity, sizeof(*ast->tokens));
+        ast->data   = _grow(ast->data, ast->capacity, sizeof(*ast->data));
     }
-    free(array.items);
+
+    ast->tags[ast->count] = tag;
+    ast->tokens[ast->count] = token;
+    ast->data[ast->count] = data;
+    return ast->count++;
 }
 
-void *my_malloc(usize x) {
-    AstNode *n = malloc(x);
-    if (!n) {
-        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+// Children that do not fit into AstData go to 'extra',
+// the node keeps the index of the first one
+static
+NodeIdx _add_extra(Ast *ast, NodeIdx *children, usize count) {
+    usize start = ast->extra.count;
+    if (count > 0) da_append_many(&ast->extra, children, count);
+    return start;
+}
+
+// Copies a child list the parser collected in scratch memory
+static
+AstData _add_list(Ast *ast, AstNodeArray list) {
+    return (AstData) {
+        .lhs = _add_extra(ast, list.items, list.count),
+        .rhs = list.count
+    };
+}
+
+static
+NodeIdx _add_message(Ast *ast, byte *msg) {
+    da_append(&ast->messages, msg);
+    return ast->messages.count - 1;
+}
+
+TokenIdx keep_token(Ast *ast, Token token) {
+    if (ast->source.count >= NO_TOKEN) {
+        fprintf(stderr, "Too many tokens, %s, %d\n", __FILE__, __LINE__);
         exit(-1);
     }
-    da_append(&array, n);
-    return n;
+    da_append(&ast->source, token);
+    return ast->source.count - 1;
 }
 
-#define malloc(x) my_malloc(x)
+void init_special_nodes(Ast *ast) {
+    *ast = (Ast) {0};
 
-AstNode *new_primitive_type_node(Token t) {
-    PrimitiveTypeNode *n = malloc(sizeof(*n));
-    
+    _add_node(ast, AST_ERROR, NO_TOKEN, (AstData) {0});
+    _add_node(ast, AST_TYPE_NUM, NO_TOKEN, (AstData) {0});
+    _add_node(ast, AST_TYPE_STRING, NO_TOKEN, (AstData) {0});
+    _add_node(ast, AST_TYPE_BOOL, NO_TOKEN, (AstData) {0});
+    _add_node(ast, AST_TYPE_VOID, NO_TOKEN, (AstData) {0});
+}
+
+void free_special_nodes(Ast *target) {
+    free(target->tags);
+    free(target->tokens);
+    free(target->data);
+    da_free(target->extra);
+    da_free(target->messages);
+    da_free(target->source);
+    free_source_lines(&target->text);
+    *target = (Ast) {0};
+}
+
+NodeIdx new_primitive_type_node(Ast *ast, TokenIdx t) {
     AstNodeType type;
-    switch (t.type) {
+    switch (ast->source.items[t].type) {
         case TOKEN_NUM:    type = AST_TYPE_NUM;    break;
         case TOKEN_STRING: type = AST_TYPE_STRING; break;
         case TOKEN_BOOL:   type = AST_TYPE_BOOL;   break;
@@ -54,499 +98,237 @@ AstNode *new_primitive_type_node(Token t) {
         default:           type = AST_TYPE_VOID;   break;
     }
 
-    *n = (PrimitiveTypeNode){
-        .this.ast_type = type,
-        .type_token    = t
-    };
-
-    return (AstNode *)n;
+    return _add_node(ast, type, t, (AstData) {0});
 }
 
-AstNode *new_struct_type_node(Token name) {
-    StructTypeNode *n = malloc(sizeof(*n));
-
-    *n = (StructTypeNode){
-        .this.ast_type = AST_TYPE_STRUCT,
-        .name          = name
-    };
-
-    return (AstNode *)n;
+NodeIdx new_struct_type_node(Ast *ast, TokenIdx name) {
+    return _add_node(ast, AST_TYPE_STRUCT, name, (AstData) {0});
 }
 
-AstNode *new_array_type_node(AstNode *base_type, usize dimensions) {
-    ArrayTypeNode *n = malloc(sizeof(*n));
-
-    *n = (ArrayTypeNode){
-        .this.ast_type = AST_TYPE_ARRAY,
-        .base_type     = base_type,
-        .dimensions    = dimensions
-    };
-
-    return (AstNode *)n;
+NodeIdx new_array_type_node(Ast *ast, NodeIdx base_type, usize dimensions) {
+    return _add_node(ast, AST_TYPE_ARRAY, NO_TOKEN, (AstData) {
+        .lhs = base_type,
+        .rhs = (NodeIdx)dimensions
+    });
 }
 
-AstNode *new_fn_type_node(AstNode *param_types, AstNode *return_type) {
-    FnTypeNode *n = malloc(sizeof(*n));
-
-    *n = (FnTypeNode){
-        .this.ast_type = AST_TYPE_FN,
-        .param_types   = param_types,
-        .return_type   = return_type
-    };
-
-    return (AstNode *)n;
+NodeIdx new_fn_type_node(Ast *ast, NodeIdx param_types, NodeIdx return_type) {
+    return _add_node(ast, AST_TYPE_FN, NO_TOKEN, (AstData) {
+        .lhs = param_types,
+        .rhs = return_type
+    });
 }
 
-AstNode *new_parameter_list_node(AstNodeArray parameters) {
-    ParameterListNode *n = malloc(sizeof(*n));
-
-    *n = (ParameterListNode){
-        .this.ast_type = AST_PARAMETER_LIST,
-        .parameters    = parameters
-    };
-
-    return (AstNode *)n;
+NodeIdx new_parameter_list_node(Ast *ast, AstNodeArray parameters) {
+    return _add_node(ast, AST_PARAMETER_LIST, NO_TOKEN, _add_list(ast, parameters));
 }
 
-AstNode *new_argument_list_node(AstNodeArray arguments) {
-    ArgumentListNode *n = malloc(sizeof(*n));
-
-    *n = (ArgumentListNode){
-        .this.ast_type = AST_ARGUMENT_LIST,
-        .arguments     = arguments
-    };
-
-    return (AstNode *)n;
+NodeIdx new_argument_list_node(Ast *ast, AstNodeArray arguments) {
+    return _add_node(ast, AST_ARGUMENT_LIST, NO_TOKEN, _add_list(ast, arguments));
 }
 
-AstNode *new_struct_field_list_node(AstNodeArray fields) {
-    StructFieldListNode *n = malloc(sizeof(*n));
-
-    *n = (StructFieldListNode){
-        .this.ast_type = AST_STRUCT_FIELD_LIST,
-        .fields        = fields
-    };
-
-    return (AstNode *)n;
+NodeIdx new_elif_clause_node(Ast *ast, NodeIdx condition, NodeIdx block) {
+    return _add_node(ast, AST_ELIF_CLAUSE, NO_TOKEN, (AstData) {
+        .lhs = condition,
+        .rhs = block
+    });
 }
 
-AstNode *new_elif_clause_node(AstNode *condition, AstNode *block) {
-    ElifClauseNode *n = malloc(sizeof(*n));
-
-    *n = (ElifClauseNode){
-        .this.ast_type = AST_ELIF_CLAUSE,
-        .condition     = condition,
-        .block         = block
-    };
-
-    return (AstNode *)n;
+NodeIdx new_elif_clause_list_node(Ast *ast, AstNodeArray elifs) {
+    return _add_node(ast, AST_ELIF_CLAUSE_LIST, NO_TOKEN, _add_list(ast, elifs));
 }
 
-AstNode *new_if_stmt_node(AstNode *condition, AstNode *then_block, AstNode *elifs, AstNode *else_block) {
-    IfStmtNode *n = malloc(sizeof(*n));
-
-    *n = (IfStmtNode){
-        .this.ast_type = AST_IF_STMT,
-        .condition     = condition,
-        .then_block    = then_block,
-        .elifs         = elifs,
-        .else_block    = else_block
-    };
-
-    return (AstNode *)n;
+NodeIdx new_if_stmt_node(Ast *ast, NodeIdx condition, NodeIdx then_block, NodeIdx elifs, NodeIdx else_block) {
+    NodeIdx children[] = {condition, then_block, elifs, else_block};
+    return _add_node(ast, AST_IF_STMT, NO_TOKEN, (AstData) {
+        .lhs = _add_extra(ast, children, countof(children))
+    });
 }
 
-AstNode *new_for_stmt_node(AstNode *init, AstNode *condition, AstNode *increment, AstNode *body) {
-    ForStmtNode *n = malloc(sizeof(*n));
-
-    *n = (ForStmtNode){
-        .this.ast_type = AST_FOR_STMT,
-        .init          = init,
-        .condition     = condition,
-        .increment     = increment,
-        .body          = body
-    };
-
-    return (AstNode *)n;
+NodeIdx new_for_stmt_node(Ast *ast, NodeIdx init, NodeIdx condition, NodeIdx increment, NodeIdx body) {
+    NodeIdx children[] = {init, condition, increment, body};
+    return _add_node(ast, AST_FOR_STMT, NO_TOKEN, (AstData) {
+        .lhs = _add_extra(ast, children, countof(children))
+    });
 }
 
-AstNode *new_while_stmt_node(AstNode *condition, AstNode *body) {
-    WhileStmtNode *n = malloc(sizeof(*n));
-
-    *n = (WhileStmtNode){
-        .this.ast_type = AST_WHILE_STMT,
-        .condition     = condition,
-        .body          = body
-    };
-
-    return (AstNode *)n;
+NodeIdx new_while_stmt_node(Ast *ast, NodeIdx condition, NodeIdx body) {
+    return _add_node(ast, AST_WHILE_STMT, NO_TOKEN, (AstData) {
+        .lhs = condition,
+        .rhs = body
+    });
 }
 
-AstNode *new_assign_stmt_node(AstNode *lvalue, AstNode *value) {
-    AssignStmtNode *n = malloc(sizeof(*n));
-
-    *n = (AssignStmtNode){
-        .this.ast_type = AST_ASSIGN_STMT,
-        .lvalue        = lvalue,
-        .value         = value
-    };
-
-    return (AstNode *)n;
+NodeIdx new_assign_stmt_node(Ast *ast, NodeIdx lvalue, NodeIdx value) {
+    return _add_node(ast, AST_ASSIGN_STMT, NO_TOKEN, (AstData) {
+        .lhs = lvalue,
+        .rhs = value
+    });
 }
 
-AstNode *new_expr_stmt_node(AstNode *expression) {
-    ExprStmtNode *n = malloc(sizeof(*n));
-
-    *n = (ExprStmtNode){
-        .this.ast_type = AST_EXPR_STMT,
-        .expression    = expression
-    };
-
-    return (AstNode *)n;
+NodeIdx new_expr_stmt_node(Ast *ast, NodeIdx expression) {
+    return _add_node(ast, AST_EXPR_STMT, NO_TOKEN, (AstData) {
+        .lhs = expression
+    });
 }
 
-AstNode *new_print_stmt_node(AstNode *expression) {
-    PrintStmtNode *n = malloc(sizeof(*n));
-
-    *n = (PrintStmtNode){
-        .this.ast_type = AST_PRINT_STMT,
-        .expression    = expression
-    };
-
-    return (AstNode *)n;
+NodeIdx new_print_stmt_node(Ast *ast, NodeIdx expression) {
+    return _add_node(ast, AST_PRINT_STMT, NO_TOKEN, (AstData) {
+        .lhs = expression
+    });
 }
 
-AstNode *new_return_stmt_node(AstNode *expression) {
-    ReturnStmtNode *n = malloc(sizeof(*n));
-
-    *n = (ReturnStmtNode){
-        .this.ast_type = AST_RETURN_STMT,
-        .expression    = expression
-    };
-
-    return (AstNode *)n;
+NodeIdx new_return_stmt_node(Ast *ast, NodeIdx expression) {
+    return _add_node(ast, AST_RETURN_STMT, NO_TOKEN, (AstData) {
+        .lhs = expression
+    });
 }
 
-AstNode *new_break_stmt_node(void) {
-    BreakStmtNode *n = malloc(sizeof(*n));
-
-    *n = (BreakStmtNode){
-        .this.ast_type = AST_BREAK_STMT
-    };
-
-    return (AstNode *)n;
+NodeIdx new_break_stmt_node(Ast *ast) {
+    return _add_node(ast, AST_BREAK_STMT, NO_TOKEN, (AstData) {0});
 }
 
-AstNode *new_continue_stmt_node(void) {
-    ContinueStmtNode *n = malloc(sizeof(*n));
-
-    *n = (ContinueStmtNode){
-        .this.ast_type = AST_CONTINUE_STMT
-    };
-
-    return (AstNode *)n;
+NodeIdx new_continue_stmt_node(Ast *ast) {
+    return _add_node(ast, AST_CONTINUE_STMT, NO_TOKEN, (AstData) {0});
 }
 
-AstNode *new_block_node(AstNodeArray statements) {
-    BlockNode *n = malloc(sizeof(*n));
-
-    *n = (BlockNode){
-        .this.ast_type = AST_BLOCK,
-        .statements    = statements
-    };
-
-    return (AstNode *)n;
+NodeIdx new_block_node(Ast *ast, AstNodeArray statements) {
+    return _add_node(ast, AST_BLOCK, NO_TOKEN, _add_list(ast, statements));
 }
 
-AstNode *new_program_node(AstNodeArray declarations) {
-    ProgramNode *n = malloc(sizeof(*n));
-
-    *n = (ProgramNode){
-        .this.ast_type = AST_PROGRAM,
-        .declarations  = declarations
-    };
-
-    return (AstNode *)n;
+NodeIdx new_program_node(Ast *ast, AstNodeArray declarations) {
+    return _add_node(ast, AST_PROGRAM, NO_TOKEN, _add_list(ast, declarations));
 }
 
-AstNode *new_number_literal_node(Token value) {
-    NumberLiteralNode *n = malloc(sizeof(*n));
-
-    *n = (NumberLiteralNode){
-        .this.ast_type = AST_LITERAL_NUMBER,
-        .value         = value
-    };
-
-    return (AstNode *)n;
+NodeIdx new_number_literal_node(Ast *ast, TokenIdx value) {
+    return _add_node(ast, AST_LITERAL_NUMBER, value, (AstData) {0});
 }
 
-AstNode *new_string_literal_node(Token value) {
-    StringLiteralNode *n = malloc(sizeof(*n));
-
-    *n = (StringLiteralNode){
-        .this.ast_type = AST_LITERAL_STRING,
-        .value         = value
-    };
-
-    return (AstNode *)n;
+NodeIdx new_string_literal_node(Ast *ast, TokenIdx value) {
+    return _add_node(ast, AST_LITERAL_STRING, value, (AstData) {0});
 }
 
-AstNode *new_bool_literal_node(Token token) {
-    BoolLiteralNode *n = malloc(sizeof(*n));
-
-    *n = (BoolLiteralNode){
-        .this.ast_type = AST_LITERAL_BOOL,
-        .token         = token
-    };
-
-    return (AstNode *)n;
+NodeIdx new_bool_literal_node(Ast *ast, TokenIdx token) {
+    return _add_node(ast, AST_LITERAL_BOOL, token, (AstData) {0});
 }
 
-AstNode *new_identifier_node(Token name) {
-    IdentifierNode *n = malloc(sizeof(*n));
-
-    *n = (IdentifierNode){
-        .this.ast_type = AST_IDENTIFIER,
-        .name          = name
-    };
-
-    return (AstNode *)n;
+NodeIdx new_identifier_node(Ast *ast, TokenIdx name) {
+    return _add_node(ast, AST_IDENTIFIER, name, (AstData) {0});
 }
 
-AstNode *new_binary_expr_node(AstNode *left, AstNode *right, Token op_token) {
-    BinaryExprNode *n = malloc(sizeof(*n));
-
-    *n = (BinaryExprNode){
-        .this.ast_type = AST_BINARY_EXPR,
-        .left          = left,
-        .right         = right,
-        .op_token      = op_token
-    };
-
-    return (AstNode *)n;
+NodeIdx new_binary_expr_node(Ast *ast, NodeIdx left, NodeIdx right, TokenIdx op_token) {
+    return _add_node(ast, AST_BINARY_EXPR, op_token, (AstData) {
+        .lhs = left,
+        .rhs = right
+    });
 }
 
-AstNode *new_unary_expr_node(AstNode *operand, Token op_token) {
-    UnaryExprNode *n = malloc(sizeof(*n));
-
-    *n = (UnaryExprNode){
-        .this.ast_type = AST_UNARY_EXPR,
-        .operand       = operand,
-        .op_token      = op_token
-    };
-
-    return (AstNode *)n;
+NodeIdx new_unary_expr_node(Ast *ast, NodeIdx operand, TokenIdx op_token) {
+    return _add_node(ast, AST_UNARY_EXPR, op_token, (AstData) {
+        .lhs = operand
+    });
 }
 
-AstNode *new_paren_expr_node(AstNode *expression) {
-    ParenExprNode *n = malloc(sizeof(*n));
-
-    *n = (ParenExprNode){
-        .this.ast_type = AST_PAREN_EXPR,
-        .expression    = expression
-    };
-
-    return (AstNode *)n;
+NodeIdx new_paren_expr_node(Ast *ast, NodeIdx expression) {
+    return _add_node(ast, AST_PAREN_EXPR, NO_TOKEN, (AstData) {
+        .lhs = expression
+    });
 }
 
-AstNode *new_assign_expr_node(AstNode *lvalue, AstNode *value) {
-    AssignExprNode *n = malloc(sizeof(*n));
-
-    *n = (AssignExprNode){
-        .this.ast_type = AST_ASSIGN_EXPR,
-        .lvalue        = lvalue,
-        .value         = value
-    };
-
-    return (AstNode *)n;
+NodeIdx new_assign_expr_node(Ast *ast, NodeIdx lvalue, NodeIdx value) {
+    return _add_node(ast, AST_ASSIGN_EXPR, NO_TOKEN, (AstData) {
+        .lhs = lvalue,
+        .rhs = value
+    });
 }
 
-AstNode *new_function_decl_node(AstNode *return_type, Token name, AstNode *parameters, AstNode *body) {
-    FunctionDeclNode *n = malloc(sizeof(*n));
-
-    *n = (FunctionDeclNode){
-        .this.ast_type = AST_FUNCTION_DECL,
-        .return_type   = return_type,
-        .name          = name,
-        .parameters    = parameters,
-        .body          = body
-    };
-
-    return (AstNode *)n;
+NodeIdx new_function_decl_node(Ast *ast, NodeIdx return_type, TokenIdx name, NodeIdx parameters, NodeIdx body) {
+    NodeIdx children[] = {return_type, parameters, body};
+    return _add_node(ast, AST_FUNCTION_DECL, name, (AstData) {
+        .lhs = _add_extra(ast, children, countof(children))
+    });
 }
 
-AstNode *new_struct_decl_node(Token name, AstNode *fields) {
-    StructDeclNode *n = malloc(sizeof(*n));
-
-    *n = (StructDeclNode){
-        .this.ast_type = AST_STRUCT_DECL,
-        .name          = name,
-        .fields        = fields
-    };
-
-    return (AstNode *)n;
+NodeIdx new_struct_decl_node(Ast *ast, TokenIdx name, NodeIdx fields) {
+    return _add_node(ast, AST_STRUCT_DECL, name, (AstData) {
+        .lhs = fields
+    });
 }
 
-AstNode *new_var_decl_node(AstNode *type, Token name, AstNode *initializer) {
-    VarDeclNode *n = malloc(sizeof(*n));
-
-    *n = (VarDeclNode){
-        .this.ast_type = AST_VAR_DECL,
-        .type          = type,
-        .name          = name,
-        .initializer   = initializer
-    };
-
-    return (AstNode *)n;
+NodeIdx new_var_decl_node(Ast *ast, NodeIdx type, TokenIdx name, NodeIdx initializer) {
+    return _add_node(ast, AST_VAR_DECL, name, (AstData) {
+        .lhs = type,
+        .rhs = initializer
+    });
 }
 
-AstNode *new_import_node(Token path) {
-    ImportNode *n = malloc(sizeof(*n));
-
-    *n = (ImportNode){
-        .this.ast_type = AST_IMPORT,
-        .path          = path
-    };
-
-    return (AstNode *)n;
+NodeIdx new_import_node(Ast *ast, TokenIdx path) {
+    return _add_node(ast, AST_IMPORT, path, (AstData) {0});
 }
 
-AstNode *new_lvalue_node(AstNode *base, AstNode *accesses) {
-    LValueNode *n = malloc(sizeof(*n));
-
-    *n = (LValueNode){
-        .this.ast_type = AST_LVALUE,
-        .base          = base,
-        .accesses      = accesses
-    };
-
-    return (AstNode *)n;
+NodeIdx new_lvalue_node(Ast *ast, NodeIdx base, NodeIdx accesses) {
+    return _add_node(ast, AST_LVALUE, NO_TOKEN, (AstData) {
+        .lhs = base,
+        .rhs = accesses
+    });
 }
 
-AstNode *new_field_access_node(AstNode *object, Token field_name) {
-    FieldAccessNode *n = malloc(sizeof(*n));
-
-    *n = (FieldAccessNode){
-        .this.ast_type = AST_FIELD_ACCESS_EXPR,
-        .object        = object,
-        .field_name    = field_name
-    };
-
-    return (AstNode *)n;
+NodeIdx new_access_list_node(Ast *ast, AstNodeArray accesses) {
+    return _add_node(ast, AST_ACCESS_LIST, NO_TOKEN, _add_list(ast, accesses));
 }
 
-AstNode *new_index_access_node(AstNode *array, AstNode *index) {
-    IndexAccessNode *n = malloc(sizeof(*n));
-
-    *n = (IndexAccessNode){
-        .this.ast_type = AST_INDEX_EXPR,
-        .array         = array,
-        .index         = index
-    };
-
-    return (AstNode *)n;
+NodeIdx new_field_access_node(Ast *ast, NodeIdx object, TokenIdx field_name) {
+    return _add_node(ast, AST_FIELD_ACCESS_EXPR, field_name, (AstData) {
+        .lhs = object
+    });
 }
 
-AstNode *new_call_expr_node(AstNode *callee, AstNode *arguments) {
-    CallExprNode *n = malloc(sizeof(*n));
-
-    *n = (CallExprNode){
-        .this.ast_type = AST_CALL_EXPR,
-        .callee        = callee,
-        .arguments     = arguments
-    };
-
-    return (AstNode *)n;
+NodeIdx new_index_access_node(Ast *ast, NodeIdx array, NodeIdx index) {
+    return _add_node(ast, AST_INDEX_EXPR, NO_TOKEN, (AstData) {
+        .lhs = array,
+        .rhs = index
+    });
 }
 
-AstNode *new_array_literal_node(AstNodeArray elements) {
-    ArrayLiteralNode *n = malloc(sizeof(*n));
-
-    *n = (ArrayLiteralNode){
-        .this.ast_type = AST_ARRAY_LITERAL,
-        .elements      = elements
-    };
-
-    return (AstNode *)n;
+NodeIdx new_call_expr_node(Ast *ast, NodeIdx callee, NodeIdx arguments) {
+    return _add_node(ast, AST_CALL_EXPR, NO_TOKEN, (AstData) {
+        .lhs = callee,
+        .rhs = arguments
+    });
 }
 
-AstNode *new_struct_literal_node(AstNodeArray fields) {
-    StructLiteralNode *n = malloc(sizeof(*n));
-
-    *n = (StructLiteralNode){
-        .this.ast_type = AST_STRUCT_LITERAL,
-        .fields        = fields
-    };
-
-    return (AstNode *)n;
+NodeIdx new_array_literal_node(Ast *ast, AstNodeArray elements) {
+    return _add_node(ast, AST_ARRAY_LITERAL, NO_TOKEN, _add_list(ast, elements));
 }
 
-AstNode *new_struct_field_assign_node(Token field_name, AstNode *value) {
-    StructFieldAssignNode *n = malloc(sizeof(*n));
-
-    *n = (StructFieldAssignNode){
-        .this.ast_type = AST_STRUCT_FIELD_ASSIGN,
-        .field_name    = field_name,
-        .value         = value
-    };
-
-    return (AstNode *)n;
+NodeIdx new_struct_literal_node(Ast *ast, AstNodeArray fields) {
+    return _add_node(ast, AST_STRUCT_LITERAL, NO_TOKEN, _add_list(ast, fields));
 }
 
-AstNode *new_parameter_node(AstNode *type, Token name) {
-    ParameterNode *n = malloc(sizeof(*n));
-
-    *n = (ParameterNode){
-        .this.ast_type = AST_PARAMETER,
-        .type          = type,
-        .name          = name
-    };
-
-    return (AstNode *)n;
+NodeIdx new_struct_field_assign_node(Ast *ast, TokenIdx field_name, NodeIdx value) {
+    return _add_node(ast, AST_STRUCT_FIELD_ASSIGN, field_name, (AstData) {
+        .lhs = value
+    });
 }
 
-AstNode *new_struct_field_node(AstNode *type, Token name) {
-    StructFieldNode *n = malloc(sizeof(*n));
-
-    *n = (StructFieldNode){
-        .this.ast_type = AST_STRUCT_FIELD,
-        .type          = type,
-        .name          = name
-    };
-
-    return (AstNode *)n;
+NodeIdx new_parameter_node(Ast *ast, NodeIdx type, TokenIdx name) {
+    return _add_node(ast, AST_PARAMETER, name, (AstData) {
+        .lhs = type
+    });
 }
 
-AstNode *new_error_node(Token error_token, byte *message) {
-    ErrorNode *n = malloc(sizeof(*n));
-
-    *n = (ErrorNode){
-        .this.ast_type = AST_ERROR,
-        .error_token   = error_token,
-        .msg           = message
-    };
-
-    return (AstNode *)n;
+NodeIdx new_struct_field_node(Ast *ast, NodeIdx type, TokenIdx name) {
+    return _add_node(ast, AST_STRUCT_FIELD, name, (AstData) {
+        .lhs = type
+    });
 }
 
-AstNode *new_elif_clause_list_node(AstNodeArray elifs) {
-    ElifClauseListNode *n = malloc(sizeof(*n));
-
-    *n = (ElifClauseListNode){
-        .this.ast_type = AST_ELIF_CLAUSE_LIST,
-        .elifs = elifs
-    };
-
-    return (AstNode *)n;
+NodeIdx new_struct_field_list_node(Ast *ast, AstNodeArray fields) {
+    return _add_node(ast, AST_STRUCT_FIELD_LIST, NO_TOKEN, _add_list(ast, fields));
 }
 
-AstNode *new_access_list_node(AstNodeArray accesses) {
-    AccessListNode *n = malloc(sizeof(*n));
-
-    *n = (AccessListNode){
-        .this.ast_type = AST_ACCESS_LIST,
-        .accesses = accesses
-    };
-
-    return (AstNode *)n;
+NodeIdx new_error_node(Ast *ast, TokenIdx error_token, byte *message) {
+    return _add_node(ast, AST_ERROR, error_token, (AstData) {
+        .lhs = _add_message(ast, message)
+    });
 }
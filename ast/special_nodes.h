@@ -4,313 +4,646 @@
 #include "node.h"
 #include "token.h"
 
+// The structs below are views of single nodes. Nodes are not stored
+// this way, the get_*_node functions decode them from the Ast arrays.
+
 // --- Type Nodes ---
 
 // Primitive type (num, string, bool, void)
 typedef struct {
-    AstNode this;
     Token type_token; // e.g., TOKEN_NUM, TOKEN_STRING, TOKEN_BOOL, TOKEN_VOID
 } PrimitiveTypeNode;
 
 // User-defined struct type
 typedef struct {
-    AstNode this;
     Token name; // struct name
 } StructTypeNode;
 
 // Array type (baseType[])
 typedef struct {
-    AstNode this;
-    AstNode *base_type; // can be PrimitiveTypeNode, StructTypeNode, or FnTypeNode
-    usize dimensions;   // number of []
+    NodeIdx base_type; // can be PrimitiveTypeNode, StructTypeNode, or FnTypeNode
+    usize dimensions; // number of []
 } ArrayTypeNode;
 
 // Function type (fn(...) -> ...)
 typedef struct {
-    AstNode this;
-    AstNode *param_types; // ParameterListNode*
-    AstNode *return_type; // may be NULL for no return type (void)
+    NodeIdx param_types; // ParameterListNode
+    NodeIdx return_type; // may be NULL_NODE for no return type (void)
 } FnTypeNode;
 
 // --- Parameter List Node ---
 typedef struct {
-    AstNode this;
-    AstNodeArray parameters; // array of ParameterNode*
+    AstNodeArray parameters; // array of ParameterNode
 } ParameterListNode;
 
 // --- Argument List Node ---
 typedef struct {
-    AstNode this;
-    AstNodeArray arguments; // array of AstNode* (expressions)
+    AstNodeArray arguments; // array of expressions
 } ArgumentListNode;
 
 // --- Elif Clause Node ---
 typedef struct {
-    AstNode this;
-    AstNode *condition;
-    AstNode *block; // BlockNode*
+    NodeIdx condition;
+    NodeIdx block; // BlockNode
 } ElifClauseNode;
 
 typedef struct {
-    AstNode this;
-    AstNodeArray elifs; // ElifClauseNode*
+    AstNodeArray elifs; // ElifClauseNode
 } ElifClauseListNode;
 
 // --- If Statement Node (with elifs and else) ---
 typedef struct {
-    AstNode this;
-    AstNode *condition;
-    AstNode *then_block; // BlockNode*
-    AstNode *elifs;      // ElifClauseListNode*
-    AstNode *else_block; // BlockNode* or NULL
+    NodeIdx condition;
+    NodeIdx then_block; // BlockNode
+    NodeIdx elifs; // ElifClauseListNode or NULL_NODE
+    NodeIdx else_block; // BlockNode or NULL_NODE
 } IfStmtNode;
 
 // --- For Statement Node ---
 typedef struct {
-    AstNode this;
-    AstNode *init;      // VarDeclNode*, ExprStmtNode*, or NULL
-    AstNode *condition; // Expression or NULL
-    AstNode *increment; // Expression or NULL
-    AstNode *body;      // BlockNode*
+    NodeIdx init; // VarDeclNode, AssignStmtNode, or NULL_NODE
+    NodeIdx condition; // Expression or NULL_NODE
+    NodeIdx increment; // Expression or NULL_NODE
+    NodeIdx body; // BlockNode
 } ForStmtNode;
 
 // --- While Statement Node ---
 typedef struct {
-    AstNode this;
-    AstNode *condition;
-    AstNode *body; // BlockNode*
+    NodeIdx condition;
+    NodeIdx body; // BlockNode
 } WhileStmtNode;
 
 // --- Assignment Statement Node ---
 typedef struct {
-    AstNode this;
-    AstNode *lvalue;
-    AstNode *value;
+    NodeIdx lvalue;
+    NodeIdx value;
 } AssignStmtNode;
 
 // --- Expression Statement Node ---
 typedef struct {
-    AstNode this;
-    AstNode *expression;
+    NodeIdx expression;
 } ExprStmtNode;
 
 // --- Print Statement Node ---
 typedef struct {
-    AstNode this;
-    AstNode *expression;
+    NodeIdx expression;
 } PrintStmtNode;
 
 // --- Return Statement Node ---
 typedef struct {
-    AstNode this;
-    AstNode *expression; // may be NULL
+    NodeIdx expression; // may be NULL_NODE
 } ReturnStmtNode;
 
-// --- Break Statement Node ---
-typedef struct {
-    AstNode this;
-} BreakStmtNode;
-
-// --- Continue Statement Node ---
-typedef struct {
-    AstNode this;
-} ContinueStmtNode;
-
-// --- Block Node (already present, but for completeness) ---
+// --- Block Node ---
 typedef struct {
-    AstNode this;
-    AstNodeArray statements; // Dynamic array of AstNode*
+    AstNodeArray statements;
 } BlockNode;
 
 // --- Program Node (root) ---
 typedef struct {
-    AstNode this;
-    AstNodeArray declarations; // array of FunctionDeclNode*, StructDeclNode*, VarDeclNode*, ImportNode*
+    AstNodeArray declarations; // FunctionDeclNode, StructDeclNode, VarDeclNode, ImportNode
 } ProgramNode;
 
 typedef struct {
-    AstNode this;
     Token value; // number token
 } NumberLiteralNode;
 
 typedef struct {
-    AstNode this;
     Token value; // string token
 } StringLiteralNode;
 
 typedef struct {
-    AstNode this;
     Token token;
 } BoolLiteralNode;
 
+// What a name refers to, filled in by the checker
+typedef enum {
+    BIND_NONE,
+    BIND_GLOBAL,   // index into the program's globals
+    BIND_LOCAL,    // slot in the function's frame
+    BIND_FUNCTION  // index into the function table
+} BindingKind;
+
+typedef struct {
+    BindingKind kind;
+    u32 idx;
+} Binding;
+
 typedef struct {
-    AstNode this;
     Token name; // identifier token
+    Binding binding;
 } IdentifierNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *left;
-    AstNode *right;
+    NodeIdx left;
+    NodeIdx right;
     Token op_token; // e.g., +, -, *, /, ==, !=, etc.
 } BinaryExprNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *operand;
+    NodeIdx operand;
     Token op_token; // e.g., !, -
 } UnaryExprNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *expression;
+    NodeIdx expression;
 } ParenExprNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *lvalue;
-    AstNode *value;
+    NodeIdx lvalue;
+    NodeIdx value;
 } AssignExprNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *return_type;
+    NodeIdx return_type;
     Token name;
-    AstNode *parameters; // ParameterListNode*
-    AstNode *body; // BlockNode*
+    NodeIdx parameters; // ParameterListNode
+    NodeIdx body; // BlockNode or NULL_NODE for a prototype
+    u32 idx; // function table index, set by the checker
 } FunctionDeclNode;
 
 typedef struct {
-    AstNode this;
     Token name;
-    AstNode *fields; // StructFieldListNode*
+    NodeIdx fields; // StructFieldListNode
 } StructDeclNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *type;
+    NodeIdx type;
     Token name;
-    AstNode *initializer; // may be NULL
+    NodeIdx initializer; // may be NULL_NODE
 } VarDeclNode;
 
 typedef struct {
-    AstNode this;
     Token path; // string token
 } ImportNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *base; // IdentifierNode* or another LValueNode*
-    AstNode *accesses; // AccessListNode*
+    NodeIdx base; // IdentifierNode or another LValueNode
+    NodeIdx accesses; // AccessListNode
 } LValueNode;
 
 typedef struct {
-    AstNode this;
-    AstNodeArray accesses; // FieldAccessNode* / IndexAccessNode*
+    AstNodeArray accesses; // FieldAccessNode / IndexAccessNode
 } AccessListNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *object;
+    NodeIdx object;
     Token field_name;
 } FieldAccessNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *array;
-    AstNode *index;
+    NodeIdx array;
+    NodeIdx index;
 } IndexAccessNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *callee;
-    AstNode *arguments; // ArgumentListNode*
+    NodeIdx callee;
+    NodeIdx arguments; // ArgumentListNode
 } CallExprNode;
 
 typedef struct {
-    AstNode this;
     AstNodeArray elements; // expressions
 } ArrayLiteralNode;
 
 typedef struct {
-    AstNode this;
-    AstNodeArray fields; // StructFieldAssignNode*
+    AstNodeArray fields; // StructFieldAssignNode
 } StructLiteralNode;
 
 typedef struct {
-    AstNode this;
     Token field_name;
-    AstNode *value;
+    NodeIdx value;
 } StructFieldAssignNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *type;
+    NodeIdx type;
     Token name;
 } ParameterNode;
 
 typedef struct {
-    AstNode this;
-    AstNode *type;
+    NodeIdx type;
     Token name;
 } StructFieldNode;
 
 typedef struct {
-    AstNode this;
-    AstNodeArray fields; // array of StructFieldNode*
+    AstNodeArray fields; // array of StructFieldNode
 } StructFieldListNode;
 
 typedef struct {
-    AstNode this;
     Token error_token;
     byte *msg;
 } ErrorNode;
 
-AstNode *new_primitive_type_node(Token t);
-AstNode *new_struct_type_node(Token name);
-AstNode *new_array_type_node(AstNode *base_type, usize dimensions);
-AstNode *new_fn_type_node(AstNode *param_types, AstNode *return_type);
-AstNode *new_parameter_list_node(AstNodeArray parameters);
-AstNode *new_argument_list_node(AstNodeArray arguments);
-AstNode *new_struct_field_list_node(AstNodeArray fields);
-AstNode *new_elif_clause_node(AstNode *condition, AstNode *block);
-AstNode *new_if_stmt_node(AstNode *condition, AstNode *then_block, AstNode *elifs, AstNode *else_block);
-AstNode *new_for_stmt_node(AstNode *init, AstNode *condition, AstNode *increment, AstNode *body);
-AstNode *new_while_stmt_node(AstNode *condition, AstNode *body);
-AstNode *new_assign_stmt_node(AstNode *lvalue, AstNode *value);
-AstNode *new_expr_stmt_node(AstNode *expression);
-AstNode *new_print_stmt_node(AstNode *expression);
-AstNode *new_return_stmt_node(AstNode *expression);
-AstNode *new_break_stmt_node(void);
-AstNode *new_continue_stmt_node(void);
-AstNode *new_block_node(AstNodeArray statements);
-AstNode *new_program_node(AstNodeArray declarations);
-AstNode *new_number_literal_node(Token value);
-AstNode *new_string_literal_node(Token value);
-AstNode *new_bool_literal_node(Token token);
-AstNode *new_identifier_node(Token name);
-AstNode *new_binary_expr_node(AstNode *left, AstNode *right, Token op_token);
-AstNode *new_unary_expr_node(AstNode *operand, Token op_token);
-AstNode *new_paren_expr_node(AstNode *expression);
-AstNode *new_assign_expr_node(AstNode *lvalue, AstNode *value);
-AstNode *new_function_decl_node(AstNode *return_type, Token name, AstNode *parameters, AstNode *body);
-AstNode *new_struct_decl_node(Token name, AstNode *fields);
-AstNode *new_var_decl_node(AstNode *type, Token name, AstNode *initializer);
-AstNode *new_import_node(Token path);
-AstNode *new_lvalue_node(AstNode *base, AstNode *accesses);
-AstNode *new_field_access_node(AstNode *object, Token field_name);
-AstNode *new_index_access_node(AstNode *array, AstNode *index);
-AstNode *new_call_expr_node(AstNode *callee, AstNode *arguments);
-AstNode *new_array_literal_node(AstNodeArray elements);
-AstNode *new_struct_literal_node(AstNodeArray fields);
-AstNode *new_struct_field_assign_node(Token field_name, AstNode *value);
-AstNode *new_parameter_node(AstNode *type, Token name);
-AstNode *new_struct_field_node(AstNode *type, Token name);
-AstNode *new_error_node(Token error_token, byte *message);
-AstNode *new_elif_clause_list_node(AstNodeArray elifs);
-AstNode *new_access_list_node(AstNodeArray accesses);
-
-void init_special_nodes(void);
-void free_special_nodes(void);
-
-#endif
\ No newline at end of file
+static inline
+AstNodeType ast_type(Ast *ast, NodeIdx n) {
+    return (AstNodeType)ast->tags[n];
+}
+
+static inline
+Token ast_token(Ast *ast, TokenIdx t) {
+    if (t == NO_TOKEN) return (Token) {0};
+    return ast->source.items[t];
+}
+
+static inline
+s8 token_str(Ast *ast, Token t) {
+    return s8(ast->text.s + t.offset, t.len);
+}
+
+static inline
+u32 token_line(Ast *ast, Token t) {
+    return source_line(&ast->text, t.offset);
+}
+
+// List nodes keep the position of their items in 'extra' and the count
+static inline
+AstNodeArray _ast_list(Ast *ast, NodeIdx n) {
+    AstData d = ast->data[n];
+    return (AstNodeArray) {
+        .items    = ast->extra.items + d.lhs,
+        .capacity = d.rhs,
+        .count    = d.rhs
+    };
+}
+
+static inline
+PrimitiveTypeNode get_primitive_type_node(Ast *ast, NodeIdx n) {
+    return (PrimitiveTypeNode) {
+        .type_token = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+StructTypeNode get_struct_type_node(Ast *ast, NodeIdx n) {
+    return (StructTypeNode) {
+        .name = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+ArrayTypeNode get_array_type_node(Ast *ast, NodeIdx n) {
+    return (ArrayTypeNode) {
+        .base_type  = ast->data[n].lhs,
+        .dimensions = ast->data[n].rhs
+    };
+}
+
+static inline
+FnTypeNode get_fn_type_node(Ast *ast, NodeIdx n) {
+    return (FnTypeNode) {
+        .param_types = ast->data[n].lhs,
+        .return_type = ast->data[n].rhs
+    };
+}
+
+static inline
+ParameterListNode get_parameter_list_node(Ast *ast, NodeIdx n) {
+    return (ParameterListNode) {
+        .parameters = _ast_list(ast, n)
+    };
+}
+
+static inline
+ArgumentListNode get_argument_list_node(Ast *ast, NodeIdx n) {
+    return (ArgumentListNode) {
+        .arguments = _ast_list(ast, n)
+    };
+}
+
+static inline
+ElifClauseNode get_elif_clause_node(Ast *ast, NodeIdx n) {
+    return (ElifClauseNode) {
+        .condition = ast->data[n].lhs,
+        .block     = ast->data[n].rhs
+    };
+}
+
+static inline
+ElifClauseListNode get_elif_clause_list_node(Ast *ast, NodeIdx n) {
+    return (ElifClauseListNode) {
+        .elifs = _ast_list(ast, n)
+    };
+}
+
+static inline
+IfStmtNode get_if_stmt_node(Ast *ast, NodeIdx n) {
+    NodeIdx *e = &ast->extra.items[ast->data[n].lhs];
+    return (IfStmtNode) {
+        .condition  = e[0],
+        .then_block = e[1],
+        .elifs      = e[2],
+        .else_block = e[3]
+    };
+}
+
+static inline
+ForStmtNode get_for_stmt_node(Ast *ast, NodeIdx n) {
+    NodeIdx *e = &ast->extra.items[ast->data[n].lhs];
+    return (ForStmtNode) {
+        .init      = e[0],
+        .condition = e[1],
+        .increment = e[2],
+        .body      = e[3]
+    };
+}
+
+static inline
+WhileStmtNode get_while_stmt_node(Ast *ast, NodeIdx n) {
+    return (WhileStmtNode) {
+        .condition = ast->data[n].lhs,
+        .body      = ast->data[n].rhs
+    };
+}
+
+static inline
+AssignStmtNode get_assign_stmt_node(Ast *ast, NodeIdx n) {
+    return (AssignStmtNode) {
+        .lvalue = ast->data[n].lhs,
+        .value  = ast->data[n].rhs
+    };
+}
+
+static inline
+ExprStmtNode get_expr_stmt_node(Ast *ast, NodeIdx n) {
+    return (ExprStmtNode) {
+        .expression = ast->data[n].lhs
+    };
+}
+
+static inline
+PrintStmtNode get_print_stmt_node(Ast *ast, NodeIdx n) {
+    return (PrintStmtNode) {
+        .expression = ast->data[n].lhs
+    };
+}
+
+static inline
+ReturnStmtNode get_return_stmt_node(Ast *ast, NodeIdx n) {
+    return (ReturnStmtNode) {
+        .expression = ast->data[n].lhs
+    };
+}
+
+static inline
+BlockNode get_block_node(Ast *ast, NodeIdx n) {
+    return (BlockNode) {
+        .statements = _ast_list(ast, n)
+    };
+}
+
+static inline
+ProgramNode get_program_node(Ast *ast, NodeIdx n) {
+    return (ProgramNode) {
+        .declarations = _ast_list(ast, n)
+    };
+}
+
+static inline
+NumberLiteralNode get_number_literal_node(Ast *ast, NodeIdx n) {
+    return (NumberLiteralNode) {
+        .value = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+StringLiteralNode get_string_literal_node(Ast *ast, NodeIdx n) {
+    return (StringLiteralNode) {
+        .value = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+BoolLiteralNode get_bool_literal_node(Ast *ast, NodeIdx n) {
+    return (BoolLiteralNode) {
+        .token = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+IdentifierNode get_identifier_node(Ast *ast, NodeIdx n) {
+    return (IdentifierNode) {
+        .name    = ast_token(ast, ast->tokens[n]),
+        .binding = { ast->data[n].lhs, ast->data[n].rhs }
+    };
+}
+
+static inline
+void set_identifier_binding(Ast *ast, NodeIdx n, Binding binding) {
+    ast->data[n] = (AstData) { .lhs = binding.kind, .rhs = binding.idx };
+}
+
+static inline
+BinaryExprNode get_binary_expr_node(Ast *ast, NodeIdx n) {
+    return (BinaryExprNode) {
+        .left     = ast->data[n].lhs,
+        .right    = ast->data[n].rhs,
+        .op_token = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+UnaryExprNode get_unary_expr_node(Ast *ast, NodeIdx n) {
+    return (UnaryExprNode) {
+        .operand  = ast->data[n].lhs,
+        .op_token = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+ParenExprNode get_paren_expr_node(Ast *ast, NodeIdx n) {
+    return (ParenExprNode) {
+        .expression = ast->data[n].lhs
+    };
+}
+
+static inline
+AssignExprNode get_assign_expr_node(Ast *ast, NodeIdx n) {
+    return (AssignExprNode) {
+        .lvalue = ast->data[n].lhs,
+        .value  = ast->data[n].rhs
+    };
+}
+
+static inline
+FunctionDeclNode get_function_decl_node(Ast *ast, NodeIdx n) {
+    NodeIdx *e = &ast->extra.items[ast->data[n].lhs];
+    return (FunctionDeclNode) {
+        .return_type = e[0],
+        .name        = ast_token(ast, ast->tokens[n]),
+        .parameters  = e[1],
+        .body        = e[2],
+        .idx         = ast->data[n].rhs
+    };
+}
+
+static inline
+void set_function_decl_idx(Ast *ast, NodeIdx n, u32 idx) {
+    ast->data[n].rhs = idx;
+}
+
+static inline
+StructDeclNode get_struct_decl_node(Ast *ast, NodeIdx n) {
+    return (StructDeclNode) {
+        .name   = ast_token(ast, ast->tokens[n]),
+        .fields = ast->data[n].lhs
+    };
+}
+
+static inline
+VarDeclNode get_var_decl_node(Ast *ast, NodeIdx n) {
+    return (VarDeclNode) {
+        .type        = ast->data[n].lhs,
+        .name        = ast_token(ast, ast->tokens[n]),
+        .initializer = ast->data[n].rhs
+    };
+}
+
+static inline
+ImportNode get_import_node(Ast *ast, NodeIdx n) {
+    return (ImportNode) {
+        .path = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+LValueNode get_lvalue_node(Ast *ast, NodeIdx n) {
+    return (LValueNode) {
+        .base     = ast->data[n].lhs,
+        .accesses = ast->data[n].rhs
+    };
+}
+
+static inline
+AccessListNode get_access_list_node(Ast *ast, NodeIdx n) {
+    return (AccessListNode) {
+        .accesses = _ast_list(ast, n)
+    };
+}
+
+static inline
+FieldAccessNode get_field_access_node(Ast *ast, NodeIdx n) {
+    return (FieldAccessNode) {
+        .object     = ast->data[n].lhs,
+        .field_name = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+IndexAccessNode get_index_access_node(Ast *ast, NodeIdx n) {
+    return (IndexAccessNode) {
+        .array = ast->data[n].lhs,
+        .index = ast->data[n].rhs
+    };
+}
+
+static inline
+CallExprNode get_call_expr_node(Ast *ast, NodeIdx n) {
+    return (CallExprNode) {
+        .callee    = ast->data[n].lhs,
+        .arguments = ast->data[n].rhs
+    };
+}
+
+static inline
+ArrayLiteralNode get_array_literal_node(Ast *ast, NodeIdx n) {
+    return (ArrayLiteralNode) {
+        .elements = _ast_list(ast, n)
+    };
+}
+
+static inline
+StructLiteralNode get_struct_literal_node(Ast *ast, NodeIdx n) {
+    return (StructLiteralNode) {
+        .fields = _ast_list(ast, n)
+    };
+}
+
+static inline
+StructFieldAssignNode get_struct_field_assign_node(Ast *ast, NodeIdx n) {
+    return (StructFieldAssignNode) {
+        .field_name = ast_token(ast, ast->tokens[n]),
+        .value      = ast->data[n].lhs
+    };
+}
+
+static inline
+ParameterNode get_parameter_node(Ast *ast, NodeIdx n) {
+    return (ParameterNode) {
+        .type = ast->data[n].lhs,
+        .name = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+StructFieldNode get_struct_field_node(Ast *ast, NodeIdx n) {
+    return (StructFieldNode) {
+        .type = ast->data[n].lhs,
+        .name = ast_token(ast, ast->tokens[n])
+    };
+}
+
+static inline
+StructFieldListNode get_struct_field_list_node(Ast *ast, NodeIdx n) {
+    return (StructFieldListNode) {
+        .fields = _ast_list(ast, n)
+    };
+}
+
+static inline
+ErrorNode get_error_node(Ast *ast, NodeIdx n) {
+    return (ErrorNode) {
+        .error_token = ast_token(ast, ast->tokens[n]),
+        .msg         = ast->messages.items[ast->data[n].lhs]
+    };
+}
+
+NodeIdx new_primitive_type_node(Ast *ast, TokenIdx t);
+NodeIdx new_struct_type_node(Ast *ast, TokenIdx name);
+NodeIdx new_array_type_node(Ast *ast, NodeIdx base_type, usize dimensions);
+NodeIdx new_fn_type_node(Ast *ast, NodeIdx param_types, NodeIdx return_type);
+NodeIdx new_parameter_list_node(Ast *ast, AstNodeArray parameters);
+NodeIdx new_argument_list_node(Ast *ast, AstNodeArray arguments);
+NodeIdx new_elif_clause_node(Ast *ast, NodeIdx condition, NodeIdx block);
+NodeIdx new_elif_clause_list_node(Ast *ast, AstNodeArray elifs);
+NodeIdx new_if_stmt_node(Ast *ast, NodeIdx condition, NodeIdx then_block, NodeIdx elifs, NodeIdx else_block);
+NodeIdx new_for_stmt_node(Ast *ast, NodeIdx init, NodeIdx condition, NodeIdx increment, NodeIdx body);
+NodeIdx new_while_stmt_node(Ast *ast, NodeIdx condition, NodeIdx body);
+NodeIdx new_assign_stmt_node(Ast *ast, NodeIdx lvalue, NodeIdx value);
+NodeIdx new_expr_stmt_node(Ast *ast, NodeIdx expression);
+NodeIdx new_print_stmt_node(Ast *ast, NodeIdx expression);
+NodeIdx new_return_stmt_node(Ast *ast, NodeIdx expression);
+NodeIdx new_break_stmt_node(Ast *ast);
+NodeIdx new_continue_stmt_node(Ast *ast);
+NodeIdx new_block_node(Ast *ast, AstNodeArray statements);
+NodeIdx new_program_node(Ast *ast, AstNodeArray declarations);
+NodeIdx new_number_literal_node(Ast *ast, TokenIdx value);
+NodeIdx new_string_literal_node(Ast *ast, TokenIdx value);
+NodeIdx new_bool_literal_node(Ast *ast, TokenIdx token);
+NodeIdx new_identifier_node(Ast *ast, TokenIdx name);
+NodeIdx new_binary_expr_node(Ast *ast, NodeIdx left, NodeIdx right, TokenIdx op_token);
+NodeIdx new_unary_expr_node(Ast *ast, NodeIdx operand, TokenIdx op_token);
+NodeIdx new_paren_expr_node(Ast *ast, NodeIdx expression);
+NodeIdx new_assign_expr_node(Ast *ast, NodeIdx lvalue, NodeIdx value);
+NodeIdx new_function_decl_node(Ast *ast, NodeIdx return_type, TokenIdx name, NodeIdx parameters, NodeIdx body);
+NodeIdx new_struct_decl_node(Ast *ast, TokenIdx name, NodeIdx fields);
+NodeIdx new_var_decl_node(Ast *ast, NodeIdx type, TokenIdx name, NodeIdx initializer);
+NodeIdx new_import_node(Ast *ast, TokenIdx path);
+NodeIdx new_lvalue_node(Ast *ast, NodeIdx base, NodeIdx accesses);
+NodeIdx new_access_list_node(Ast *ast, AstNodeArray accesses);
+NodeIdx new_field_access_node(Ast *ast, NodeIdx object, TokenIdx field_name);
+NodeIdx new_index_access_node(Ast *ast, NodeIdx array, NodeIdx index);
+NodeIdx new_call_expr_node(Ast *ast, NodeIdx callee, NodeIdx arguments);
+NodeIdx new_array_literal_node(Ast *ast, AstNodeArray elements);
+NodeIdx new_struct_literal_node(Ast *ast, AstNodeArray fields);
+NodeIdx new_struct_field_assign_node(Ast *ast, TokenIdx field_name, NodeIdx value);
+NodeIdx new_parameter_node(Ast *ast, NodeIdx type, TokenIdx name);
+NodeIdx new_struct_field_node(Ast *ast, NodeIdx type, TokenIdx name);
+NodeIdx new_struct_field_list_node(Ast *ast, AstNodeArray fields);
+NodeIdx new_error_node(Ast *ast, TokenIdx error_token, byte *message);
+
+// Copies a token some node refers to into the Ast
+TokenIdx keep_token(Ast *ast, Token token);
+
+void init_special_nodes(Ast *ast);
+void free_special_nodes(Ast *ast);
+
+#endif
@@ -0,0 +1,164 @@
+#include "symbols.h"
+#include "da.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SYMBOLS_INIT_CAP 1024
+#define SYMBOL_MAP_INIT_CAP 64
+
+
+static inline
+u32 _hash(s8 str) {
+    // FNV-1a
+    u32 h = 2166136261u;
+    for (isize i = 0; i < str.len; ++i) {
+        h ^= (u8)str.s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline
+b32 _s8_eq(s8 s1, s8 s2) {
+    return s1.len == s2.len &&
+        memcmp(s1.s, s2.s, s1.len) == 0;
+}
+
+static
+void _insert_slot(SymbolTable *table, SymbolId id) {
+    usize mask = table->capacity - 1;
+    usize i = table->hashes[id] & mask;
+    while (table->slots[i] != NO_SYMBOL) i = (i + 1) & mask;
+    table->slots[i] = id;
+}
+
+static
+void _grow(SymbolTable *table) {
+    free(table->slots);
+    table->capacity = table->capacity ? table->capacity * 2 : SYMBOLS_INIT_CAP;
+    table->slots = calloc(table->capacity, sizeof(*table->slots));
+    if (table->slots == NULL) {
+        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+        exit(-1);
+    }
+
+    for (SymbolId id = NO_SYMBOL + 1; id < table->names.count; ++id)
+        _insert_slot(table, id);
+}
+
+static
+SymbolId _add(SymbolTable *table, s8 name, u32 hash) {
+    SymbolId id = table->names.count;
+    usize old_capacity = table->names.capacity;
+    da_append(&table->names, name);
+
+    // Parallel to 'names', so it follows its growth
+    if (table->names.capacity != old_capacity) {
+        table->hashes = realloc(table->hashes, table->names.capacity * sizeof(*table->hashes));
+        if (table->hashes == NULL) {
+            fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+            exit(-1);
+        }
+    }
+    table->hashes[id] = hash;
+
+    // Kept at most half full. NO_SYMBOL never gets a slot.
+    if (2 * table->names.count > table->capacity) _grow(table);
+    else if (id != NO_SYMBOL) _insert_slot(table, id);
+    return id;
+}
+
+static
+void _init_symbols(SymbolTable *table) {
+    _add(table, (s8) {0}, 0);
+    _add(table, s8("main"), _hash(s8("main")));
+}
+
+SymbolId intern(SymbolTable *table, s8 name) {
+    if (table->names.count == 0) _init_symbols(table);
+
+    u32 hash = _hash(name);
+    usize mask = table->capacity - 1;
+    for (usize i = hash & mask; table->slots[i] != NO_SYMBOL; i = (i + 1) & mask) {
+        SymbolId id = table->slots[i];
+        if (table->hashes[id] == hash && _s8_eq(table->names.items[id], name))
+            return id;
+    }
+
+    return _add(table, name, hash);
+}
+
+s8 symbol_name(SymbolTable *table, SymbolId id) {
+    return table->names.items[id];
+}
+
+usize symbol_count(SymbolTable *table) {
+    return table->names.count;
+}
+
+void free_symbols(SymbolTable *table) {
+    da_free(table->names);
+    free(table->hashes);
+    free(table->slots);
+    *table = (SymbolTable) {0};
+}
+
+// Ids are dense, so a multiplicative hash spreads them well enough
+static inline
+usize _map_slot(SymbolMap *map, SymbolId key) {
+    usize mask = map->capacity - 1;
+    usize i = (key * 2654435769u) & mask;
+    while (map->keys[i] != NO_SYMBOL && map->keys[i] != key) i = (i + 1) & mask;
+    return i;
+}
+
+static
+void _map_grow(SymbolMap *map) {
+    SymbolMap old = *map;
+    map->capacity = old.capacity ? old.capacity * 2 : SYMBOL_MAP_INIT_CAP;
+    map->keys = calloc(map->capacity, sizeof(*map->keys));
+    map->values = malloc(map->capacity * sizeof(*map->values));
+    if (map->keys == NULL || map->values == NULL) {
+        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+        exit(-1);
+    }
+
+    for (usize i = 0; i < old.capacity; ++i) {
+        if (old.keys[i] == NO_SYMBOL) continue;
+        usize slot = _map_slot(map, old.keys[i]);
+        map->keys[slot] = old.keys[i];
+        map->values[slot] = old.values[i];
+    }
+
+    free(old.keys);
+    free(old.values);
+}
+
+u32 symbol_map_get(SymbolMap *map, SymbolId key, u32 missing) {
+    if (map->count == 0) return missing;
+    usize slot = _map_slot(map, key);
+    return map->keys[slot] == key ? map->values[slot] : missing;
+}
+
+void symbol_map_put(SymbolMap *map, SymbolId key, u32 value) {
+    if (2 * (map->count + 1) > map->capacity) _map_grow(map);
+
+    usize slot = _map_slot(map, key);
+    if (map->keys[slot] == NO_SYMBOL) {
+        map->keys[slot] = key;
+        map->count++;
+    }
+    map->values[slot] = value;
+}
+
+void symbol_map_clear(SymbolMap *map) {
+    if (map->count == 0) return;
+    memset(map->keys, 0, map->capacity * sizeof(*map->keys));
+    map->count = 0;
+}
+
+void symbol_map_free(SymbolMap *map) {
+    free(map->keys);
+    free(map->values);
+    *map = (SymbolMap) {0};
+}
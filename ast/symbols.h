@@ -0,0 +1,50 @@
+#ifndef SYMBOLS_INCLUDE
+#define SYMBOLS_INCLUDE
+
+#include "types.h"
+#include "s8.h"
+
+// Every identifier is interned once by the scanner. Equal names get
+// the same id, so later phases compare names as integers.
+typedef u32 SymbolId;
+
+// Ids the table starts with
+enum {
+    NO_SYMBOL,  // tokens that are not identifiers
+    SYM_MAIN,
+    FIRST_SYMBOL
+};
+
+// Open addressing table of ids, 0 marks an empty slot. The names
+// themselves are kept in insertion order, so an id is an index.
+// A zeroed table is ready to use.
+typedef struct {
+    s8Array names;
+    u32 *hashes;   // hash of every name, parallel to 'names'
+    SymbolId *slots;
+    usize capacity; // number of slots, always a power of two
+} SymbolTable;
+
+// Open addressing map from symbol ids to u32 values
+typedef struct {
+    SymbolId *keys; // NO_SYMBOL marks an empty slot
+    u32 *values;
+    usize count;
+    usize capacity; // power of two
+} SymbolMap;
+
+SymbolId intern(SymbolTable *table, s8 name);
+s8 symbol_name(SymbolTable *table, SymbolId id);
+usize symbol_count(SymbolTable *table);
+
+// Returns 'missing' if the key is not in the map
+u32 symbol_map_get(SymbolMap *map, SymbolId key, u32 missing);
+void symbol_map_put(SymbolMap *map, SymbolId key, u32 value);
+void symbol_map_clear(SymbolMap *map);
+void symbol_map_free(SymbolMap *map);
+
+// The interned names point into the source, so the table
+// must be freed before or together with it
+void free_symbols(SymbolTable *table);
+
+#endif
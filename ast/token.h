@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include "s8.h"
+#include "symbols.h"
 
 typedef enum {
     // Single-character tokens
@@ -61,10 +62,13 @@ typedef enum {
     TOKEN_ERROR
 } TokenType;
 
+// The text of a token is found through its offset into the source,
+// its line is looked up only when a message needs it
 typedef struct {
-    TokenType type;
-    s8 str;
-    u32 line;
+    u8 type;      // TokenType
+    u32 offset;
+    u32 len;
+    SymbolId sym; // interned name of identifiers, NO_SYMBOL otherwise
 } Token;
 
 typedef struct {
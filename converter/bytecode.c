@@ -0,0 +1,318 @@
+#include "bytecode.h"
+#include "da.h"
+#include "macros.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static inline
+void _bytecode_error(const byte *fmt, ...) {
+    fprintf(stderr, "Bytecode error: ");
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+// Misses of the compile cache are not the user's business
+static inline
+void _load_error(b32 quiet, const byte *fmt, ...) {
+    if (quiet) return;
+    fprintf(stderr, "Bytecode error: ");
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+b32 is_bytecode(byte *data) {
+    return memcmp(data, BYTECODE_MAGIC, 4) == 0;
+}
+
+BytecodeSection put_section(ByteArray *out, void *items, usize count, usize size) {
+    while (out->count % BYTECODE_ALIGN) da_append(out, 0);
+
+    BytecodeSection section = { .offset = out->count, .count = count };
+    if (count > 0) da_append_many(out, (byte *)items, count * size);
+    return section;
+}
+
+b32 write_bytecode(LinkResult *program, FILE *f) {
+    ByteArray out = {0};
+    BytecodeHeader header = {
+        .magic = BYTECODE_MAGIC,
+        .version = BYTECODE_VERSION,
+        .value_size = sizeof(Value),
+        .address_size = ADDRESS_SIZE,
+        .function_size = sizeof(FunctionEntry),
+        .header_size = sizeof(BytecodeHeader),
+        .first_instr = program->first_instr,
+        .globals_count = program->globals_count
+    };
+    da_append_many(&out, (byte *)&header, sizeof(header));
+
+    // The padding inside a Value is zeroed, so the same program
+    // always gives the same bytes
+    ValueArray constants = {0};
+    for (usize i = 0; i < program->constants.count; ++i) {
+        Value val;
+        memset(&val, 0, sizeof(val));
+        val.type = program->constants.items[i].type;
+        switch (val.type) {
+            case VAL_BOOL: val.bool = program->constants.items[i].bool; break;
+            case VAL_NUM:  val.num = program->constants.items[i].num;   break;
+            case VAL_STR:  val.ref = program->constants.items[i].ref;   break;
+            default: UNREACHABLE();
+        }
+        da_append(&constants, val);
+    }
+
+    header.constants = put_section(&out, constants.items, constants.count, sizeof(Value));
+    header.code = put_section(&out, program->code.items, program->code.count, 1);
+    header.functions = put_section(&out, program->functions.items,
+                                    program->functions.count, sizeof(FunctionEntry));
+    header.strings = put_section(&out, program->strings.items, program->strings.count, 1);
+    memcpy(out.items, &header, sizeof(header));
+
+    b32 result = fwrite(out.items, 1, out.count, f) == out.count;
+    da_free(constants);
+    da_free(out);
+    return result;
+}
+
+b32 save_bytecode(LinkResult *program, byte *path) {
+    FILE *f = fopen(path, "wb");
+    b32 written = f != NULL && write_bytecode(program, f);
+    if (f != NULL && fclose(f) != 0) written = false;
+    if (!written) _bytecode_error("could not write \"%s\"", path);
+    return written;
+}
+
+b32 section_fits(BytecodeSection section, usize size, usize file_size) {
+    return section.offset % BYTECODE_ALIGN == 0 &&
+           section.offset <= file_size &&
+           section.count <= (file_size - section.offset) / size;
+}
+
+// The sections are used in place, their contents are checked
+// once they are mapped
+static
+b32 _check_header(BytecodeHeader *header, usize file_size, byte *path, b32 quiet) {
+    if (header->version != BYTECODE_VERSION) {
+        _load_error(quiet, "\"%s\" has version %u, expected %u",
+            path, header->version, BYTECODE_VERSION);
+        return false;
+    }
+    if (header->value_size != sizeof(Value) ||
+        header->address_size != ADDRESS_SIZE ||
+        header->function_size != sizeof(FunctionEntry) ||
+        header->header_size != sizeof(BytecodeHeader)) {
+        _load_error(quiet, "\"%s\" was written for a different platform", path);
+        return false;
+    }
+    if (!section_fits(header->constants, sizeof(Value), file_size) ||
+        !section_fits(header->code, 1, file_size) ||
+        !section_fits(header->functions, sizeof(FunctionEntry), file_size) ||
+        !section_fits(header->strings, 1, file_size)) {
+        _load_error(quiet, "\"%s\" is truncated", path);
+        return false;
+    }
+    // Every global is stored by at least one instruction
+    if (header->globals_count > header->code.count) {
+        _load_error(quiet, "\"%s\" contains invalid code", path);
+        return false;
+    }
+    return true;
+}
+
+static
+b32 _ref_fits(LinkResult *program, StrRef ref) {
+    return (u64)ref.offset + ref.len <= program->strings.count;
+}
+
+static
+b32 _read_index(CodeArray *code, usize *ip, usize *value) {
+    *value = 0;
+    for (u32 shift = 0; shift < 64; shift += 7) {
+        if (*ip >= code->count) return false;
+        u8 b = code->items[(*ip)++];
+        *value |= (usize)(b & 0x7f) << shift;
+        if (b < 0x80) return true;
+    }
+    return false;
+}
+
+static
+b32 _read_address(CodeArray *code, usize *ip, b32 wide, usize *value) {
+    usize size = wide ? WIDE_ADDRESS_SIZE : ADDRESS_SIZE;
+    if (code->count - *ip < size) return false;
+    *value = wide ? decode_wide_address(code->items, ip) : decode_address(code->items, ip);
+    return true;
+}
+
+typedef struct {
+    usize *items;
+    usize count;
+    usize capacity;
+} Targets;
+
+// Cached files can be written by anyone, so every operand is checked
+// once here and the VM never reads or writes out of bounds. Locals are
+// the exception, the VM checks them against the frame.
+static
+b32 _check_code(LinkResult *program) {
+    CodeArray *code = &program->code;
+    u8 *starts = calloc(code->count, 1);
+    if (starts == NULL) {
+        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+        exit(-1);
+    }
+
+    Targets targets = {0};
+    Instruction last = iHalt;
+    usize ip = 0;
+    b32 ok = true;
+    while (ok && ip < code->count) {
+        starts[ip] = true;
+        Instruction instr = code->items[ip++];
+        b32 wide = instr == iWide;
+        if (wide) {
+            ok = ip < code->count;
+            if (!ok) break;
+            instr = code->items[ip++];
+            ok = has_address(instr);
+        }
+        if (!ok || instr > iWide) {
+            ok = false;
+            break;
+        }
+
+        usize arg = 0;
+        if (has_address(instr)) {
+            ok = _read_address(code, &ip, wide, &arg);
+            if (ok) da_append(&targets, arg);
+        } else if (has_arg(instr)) {
+            ok = _read_index(code, &ip, &arg);
+            if (ok && instr == iPush_Const) ok = arg < program->constants.count;
+            if (ok && (instr == iStore_Global || instr == iLoad_Global)) ok = arg < program->globals_count;
+        }
+        last = instr;
+    }
+
+    // Running off the end is impossible if the last instruction
+    // never falls through
+    ok = ok && code->count > 0 && (last == iHalt || last == iJmp || last == iRestore);
+    ok = ok && program->first_instr < code->count && starts[program->first_instr];
+    for (usize i = 0; ok && i < targets.count; ++i)
+        ok = targets.items[i] < code->count && starts[targets.items[i]];
+    for (usize i = 0; ok && i < program->functions.count; ++i) {
+        FunctionEntry *fn = &program->functions.items[i];
+        ok = fn->address < code->count && starts[fn->address] && _ref_fits(program, fn->name);
+    }
+
+    da_free(targets);
+    free(starts);
+    return ok;
+}
+
+static
+b32 _check_constants(LinkResult *program) {
+    for (usize i = 0; i < program->constants.count; ++i) {
+        Value *val = &program->constants.items[i];
+        switch (val->type) {
+            case VAL_BOOL: break;
+            case VAL_NUM:
+                if (val->num.num_type != NUM_INT && val->num.num_type != NUM_FLOAT) return false;
+                break;
+            case VAL_STR:
+                if (!_ref_fits(program, val->ref)) return false;
+                break;
+            default: return false;
+        }
+    }
+    return true;
+}
+
+// Reads all of the code once to check it, see _check_code()
+static
+b32 _load(byte *path, LinkResult *program, b32 quiet) {
+    *program = (LinkResult) {0};
+
+    FILE *f = fopen(path, "rb");
+    struct stat st;
+    if (f == NULL || fstat(fileno(f), &st) < 0) {
+        _load_error(quiet, "could not open \"%s\"", path);
+        if (f != NULL) fclose(f);
+        return false;
+    }
+
+    usize size = st.st_size;
+    byte magic[4];
+    if (size < sizeof(magic) || fread(magic, 1, sizeof(magic), f) != sizeof(magic) || !is_bytecode(magic)) {
+        _load_error(quiet, "\"%s\" is not a bytecode file", path);
+        fclose(f);
+        return false;
+    }
+    if (size < sizeof(BytecodeHeader)) {
+        _load_error(quiet, "\"%s\" is truncated", path);
+        fclose(f);
+        return false;
+    }
+
+    byte *image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    fclose(f);
+    if (image == MAP_FAILED) {
+        _load_error(quiet, "could not read \"%s\"", path);
+        return false;
+    }
+
+    BytecodeHeader *header = (BytecodeHeader *)image;
+    if (!_check_header(header, size, path, quiet)) {
+        munmap(image, size);
+        return false;
+    }
+
+    // The arrays have no capacity, nothing ever grows them
+    *program = (LinkResult) {
+        .code = {
+            .items = (u8 *)(image + header->code.offset),
+            .count = header->code.count
+        },
+        .constants = {
+            .items = (Value *)(image + header->constants.offset),
+            .count = header->constants.count
+        },
+        .strings = {
+            .items = image + header->strings.offset,
+            .count = header->strings.count
+        },
+        .functions = {
+            .items = (FunctionEntry *)(image + header->functions.offset),
+            .count = header->functions.count
+        },
+        .globals_count = header->globals_count,
+        .first_instr = header->first_instr,
+        .image = image,
+        .image_size = size
+    };
+
+    if (!_check_constants(program) || !_check_code(program)) {
+        _load_error(quiet, "\"%s\" contains invalid code", path);
+        munmap(image, size);
+        *program = (LinkResult) {0};
+        return false;
+    }
+    return true;
+}
+
+b32 load_bytecode(byte *path, LinkResult *program) {
+    return _load(path, program, false);
+}
+
+b32 load_cached_bytecode(byte *path, LinkResult *program) {
+    return _load(path, program, true);
+}
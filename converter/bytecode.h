@@ -0,0 +1,69 @@
+#ifndef BYTECODE_INCLUDE
+#define BYTECODE_INCLUDE
+
+#include "linker.h"
+#include <stdio.h>
+
+// A linked program on disk, laid out the way it is in memory:
+//
+//   header       BytecodeHeader
+//   constants    Value[constant_count]
+//   code         code_size bytes, see encode_instr()
+//   functions    FunctionEntry[function_count]
+//   strings      string_size bytes, string constants and function names
+//
+// Every section starts at a BYTECODE_ALIGN aligned offset given in the
+// header. Nothing in a linked program is a pointer, so the file is
+// mapped read-only and run in place. Processes running the same file
+// share its pages.
+//
+// The version changes whenever the layout or the instruction set does,
+// older files are rejected instead of being misread. The sizes in the
+// header catch files written by a build with a different ABI.
+#define BYTECODE_MAGIC "PLBC"
+#define BYTECODE_VERSION 4
+#define BYTECODE_ALIGN 16
+
+typedef struct {
+    u64 offset;
+    u64 count;
+} BytecodeSection;
+
+typedef struct {
+    byte magic[4];
+    u32 version;
+    u16 value_size;
+    u16 address_size;
+    u16 function_size;
+    u16 header_size;
+    u64 first_instr;
+    u64 globals_count;
+    BytecodeSection constants;
+    BytecodeSection code;
+    BytecodeSection functions;
+    BytecodeSection strings;
+} BytecodeHeader;
+
+// Appends 'count' items of 'size' bytes at the next aligned offset
+BytecodeSection put_section(ByteArray *out, void *items, usize count, usize size);
+// True if the section is aligned and lies within the file
+b32 section_fits(BytecodeSection section, usize size, usize file_size);
+
+// True if 'data' starts like a bytecode file, it has to hold
+// at least 4 bytes
+b32 is_bytecode(byte *data);
+
+// Both report errors on stderr and return false on failure.
+// A loaded program is released with free_link().
+b32 save_bytecode(LinkResult *program, byte *path);
+b32 load_bytecode(byte *path, LinkResult *program);
+
+// Same as load_bytecode(), but reports nothing. A cached file that
+// can not be used is just a miss.
+b32 load_cached_bytecode(byte *path, LinkResult *program);
+
+// Leaves 'f' open and reports nothing, for callers that write
+// somewhere other than a plain path
+b32 write_bytecode(LinkResult *program, FILE *f);
+
+#endif
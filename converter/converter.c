@@ -1,21 +1,14 @@
 #include "converter.h"
 #include "../ast/special_nodes.h"
 #include "da.h"
+#include "arena.h"
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include "macros.h"
 
-static ConversionResult res;
-
-void _init_converter(void) {
-    res = (ConversionResult) {0};
-}
-
-isize _store_global(s8 str) {
-    da_append(&res.globals, str);
-    return res.globals.count - 1;
-}
-
 b32 _s8_to_b32(s8 str) {
     return str.s[0] == 't';
 }
@@ -35,474 +28,454 @@ Number _s8_to_num(s8 str) {
     }
 }
 
-isize _store_constant(s8 str, ValueType type) {
-    switch (type) {
-        case VAL_STR:
-            da_append(&res.constants, new_val_str(str)); 
-            break;
-        case VAL_NUM:
-            da_append(&res.constants, new_val_num(_s8_to_num(str))); 
-            break;
-        case VAL_BOOL:
-            da_append(&res.constants, new_val_bool(_s8_to_b32(str)));
-            break;
-    
-        default: UNREACHABLE();
-    }
-
-    return res.constants.count - 1;
-}
-
-static inline
-b32 _s8_eq(s8 s1, s8 s2) {
-    return s1.len == s2.len &&
-        memcmp(s1.s, s2.s, s1.len) == 0;
-}
-
-isize _find_global(s8 str) {
-    for (usize i = 0; i < res.globals.count; ++i) {
-        if (_s8_eq(res.globals.items[i], str)) return i;
-    }
-
-    UNREACHABLE();
-}
-
-static inline
-b32 _token_eq(Token a, Token b) {
-    return a.str.len == b.str.len &&
-        memcmp(a.str.s, b.str.s, a.str.len) == 0;
-}
-
+// Names were resolved by the checker. Locals get their frame slots
+// in the same order the checker pushed them, so a local's slot is
+// the one stored in its binding.
+//
+// Top-level code is converted first and registers every function.
+// Function bodies are then converted in parallel, each thread with
+// its own Info. A body only writes its own instruction set and the
+// constant pool of its thread. The pools are merged in function order
+// at the end, so the result does not depend on scheduling.
+#define INFO_ARENA_SIZE (16 * 1024)
+
+// Bodies are handed out one at a time, threads are only started when
+// each of them gets a few
+#define CONVERT_MAX_THREADS 16
+#define CONVERT_BODIES_PER_THREAD 8
+
+// Where the constants of a function ended up
 typedef struct {
-    Token name;
-    isize scope;
-} LocalSymbol;
+    usize pool;
+    usize start;
+    usize count;
+} PoolRange;
 
 typedef struct {
-    LocalSymbol *items;
-    usize count;
-    usize capacity;
-} LocalStack;
+    AstNodeArray bodies;    // function declarations with a body
+    _Atomic usize next;     // next body to convert
+    ValueArray pools[CONVERT_MAX_THREADS];
+    PoolRange *ranges;      // by function index
+} Bodies;
 
+// Every thread has its own Info, the result and the bodies are shared
 typedef struct {
-    LocalStack locals;
-    isize scope;
+    usize local_count; // next free frame slot
     b32 in_func;
     usize fn_idx;
+    Ast *ast;
+    Arena scratch; // lowering temporaries
+    ValueArray *constants; // pool of this thread while in a function
+    ConversionResult *res;
+    Bodies *bodies;
+    b32 error;
 } Info;
 
-static Info info;
-
-static void _init_info(void) {
-    info = (Info) {0};
-}
-
-static inline
-void scope(void) {
-    info.scope++;
-}
-
-static inline
-void rm_scope(void) {
-    info.scope--;
+static void _init_info(Info *info, Ast *ast, ConversionResult *res, Bodies *bodies) {
+    *info = (Info) {0};
+    info->ast = ast;
+    info->res = res;
+    info->bodies = bodies;
+    info->scratch = arena_init(INFO_ARENA_SIZE);
 }
 
-static void _clear_local(void) {
-    info.locals.count = 0;
+isize _store_global(Info *info, s8 name) {
+    da_append(&info->res->globals, name);
+    return info->res->globals.count - 1;
 }
 
-static isize _push_local(LocalSymbol local) {
-    da_append(&info.locals, local);
-    return info.locals.count - 1;
-}
+isize _store_constant(Info *info, s8 str, ValueType type) {
+    ValueArray *pool = info->in_func ? info->constants : &info->res->constants;
+    switch (type) {
+        case VAL_STR:
+            da_append(pool, new_val_str(str)); 
+            break;
+        case VAL_NUM:
+            da_append(pool, new_val_num(_s8_to_num(str))); 
+            break;
+        case VAL_BOOL:
+            da_append(pool, new_val_bool(_s8_to_b32(str)));
+            break;
+    
+        default: UNREACHABLE();
+    }
 
-static LocalSymbol _new_local(Token name) {
-    return (LocalSymbol) {.name = name, .scope = info.scope };
+    return pool->count - 1;
 }
 
-static isize _lookup_local(Token name) {
-    for (usize i = 0; i < info.locals.count; ++i) {
-        if (_token_eq(info.locals.items[i].name, name) 
-            && info.locals.items[i].scope <= info.scope)
-            return i;
+static usize _add_function(Info *info, usize idx, FunctionDeclNode *fn, usize address) {
+    while (info->res->functions.count <= idx) {
+        da_append(&info->res->functions, (FunctionSymbol) {0});
     }
-    return -1;
-}
 
-static usize _lookup_function(Token name) {
-    for (usize i = 0; i < res.functions.count; ++i) {
-        if (_token_eq(res.functions.items[i].name, name))
-            return i;
+    if (info->res->functions.items[idx].instructions.count == 0) {
+        Ast *ast = info->ast;
+        AstNodeArray params = get_parameter_list_node(ast, fn->parameters).parameters;
+        FunctionSymbol *symbol = &info->res->functions.items[idx];
+        *symbol = (FunctionSymbol) {
+            .name = token_str(ast, fn->name),
+            .sym = fn->name.sym,
+            .line = fn->body == NULL_NODE ? token_line(ast, fn->name) : 0,
+            .address = address,
+            .return_type = ast_type(ast, fn->return_type),
+            .param_start = info->res->param_types.count,
+            .param_count = params.count
+        };
+        for (usize i = 0; i < params.count; ++i) {
+            ParameterNode param = get_parameter_node(ast, params.items[i]);
+            da_append(&info->res->param_types, ast_type(ast, param.type));
+        }
     }
-    UNREACHABLE();
+    return idx;
 }
 
-static usize _add_function(Token name, usize address) {
-    FunctionSymbol s = {.name = name, .address = address};
-    for (usize i = 0; i < res.functions.count; ++i) {
-        if (_token_eq(res.functions.items[i].name, name)) {
-            if (res.functions.items[i].instructions.count == 0) {
-                res.functions.items[i] = s;
-            }
-            return i;
+// Indices and labels are stored in IR words. A program that outgrows
+// them is reported and then fails to link, it is never truncated.
+static usize _check_operand(b32 *error, usize operand) {
+    if (operand > IR_OPERAND_MAX) {
+        if (!*error) {
+            fprintf(stderr, "Converter error: operand %zu is larger than %zu, "
+                            "the program is too large\n", operand, (usize)IR_OPERAND_MAX);
         }
+        *error = true;
     }
-
-    da_append(&res.functions, s);
-    return res.functions.count - 1;
+    return operand;
 }
 
-static void _append_i(usize i) {
-    if (info.in_func) {
-        InstructionSet *set = &res.functions.items[info.fn_idx].instructions;
+static void _append_i(Info *info, usize i) {
+    _check_operand(&info->error, i);
+    if (info->in_func) {
+        InstructionSet *set = &info->res->functions.items[info->fn_idx].instructions;
         da_append(set, i);
     } else {
-        da_append(&res.instructions, i);
+        da_append(&info->res->instructions, i);
+    }
+}
+
+static usize _get_label(Info *info) {
+    return _check_operand(&info->error, info->res->functions.items[info->fn_idx].instructions.count);
+}
+
+static void _load_var(Info *info, Binding binding) {
+    switch (binding.kind) {
+        case BIND_LOCAL:  _append_i(info, iLoad_Local);  break;
+        case BIND_GLOBAL: _append_i(info, iLoad_Global); break;
+        default: UNREACHABLE();
     }
+    _append_i(info, binding.idx);
 }
 
-static usize _get_label(void) {
-    return res.functions.items[info.fn_idx].instructions.count;
+static void _store_var(Info *info, Binding binding) {
+    switch (binding.kind) {
+        case BIND_LOCAL:  _append_i(info, iStore_Local);  break;
+        case BIND_GLOBAL: _append_i(info, iStore_Global); break;
+        default: UNREACHABLE();
+    }
+    _append_i(info, binding.idx);
 }
 
-void _convert(AstNode *node) {
-    if (!node) return;
+void _convert(Info *info, NodeIdx node) {
+    if (node == NULL_NODE) return;
 
-    switch (node->ast_type) {
+    Ast *ast = info->ast;
+    switch (ast_type(ast, node)) {
         case AST_PROGRAM: {
-            ProgramNode *n = (ProgramNode *)node;
-            for (usize i = 0; i < n->declarations.count; ++i) {
-                _convert(n->declarations.items[i]);
+            ProgramNode n = get_program_node(ast, node);
+            for (usize i = 0; i < n.declarations.count; ++i) {
+                _convert(info, n.declarations.items[i]);
             }
-            _append_i(iHalt);
+            _append_i(info, iHalt);
             break;
         }
 
-        case AST_FUNCTION_DECL: {
-            FunctionDeclNode *fn = (FunctionDeclNode *)node;
+        case AST_IMPORT:
+            break;
 
-            info.fn_idx = _add_function(fn->name, res.instructions.count);
+        case AST_FUNCTION_DECL: {
+            FunctionDeclNode fn = get_function_decl_node(ast, node);
+            _add_function(info, fn.idx, &fn, info->res->instructions.count);
 
-            
-            if (fn->body) {
-                AstNodeArray params = ((ParameterListNode *)fn->parameters)->parameters;
-                for (usize i = 0; i < params.count; ++i) {
-                    ParameterNode *param = (ParameterNode *)params.items[i];
-                    _push_local(_new_local(param->name));
-                }
-                info.in_func = true;
-    
-                _convert(fn->body);
-                _append_i(iRestore);
-    
-                _clear_local();
-                
-                info.in_func = false;
-            }
+            // Converted by _convert_bodies()
+            if (fn.body != NULL_NODE)
+                da_append(&info->bodies->bodies, node);
             break;
         }
 
         case AST_BLOCK: {
-            BlockNode *block = (BlockNode *)node;
-            scope();
-            usize old_count = info.locals.count;
-            for (usize i = 0; i < block->statements.count; ++i)
-                _convert(block->statements.items[i]);
-            info.locals.count = old_count;
-            rm_scope();
+            BlockNode block = get_block_node(ast, node);
+            usize old_count = info->local_count;
+            for (usize i = 0; i < block.statements.count; ++i)
+                _convert(info, block.statements.items[i]);
+            info->local_count = old_count;
             break;
         }
 
         case AST_RETURN_STMT: {
-            ReturnStmtNode *ret = (ReturnStmtNode *)node;
-            if (ret->expression) {
-                _convert(ret->expression);
+            ReturnStmtNode ret = get_return_stmt_node(ast, node);
+            if (ret.expression != NULL_NODE) {
+                _convert(info, ret.expression);
             }
-            _append_i(iRestore);
+            _append_i(info, iRestore);
             break;
         }
 
         case AST_PRINT_STMT: {
-            PrintStmtNode *p = (PrintStmtNode *)node;
-            _convert(p->expression);
-            _append_i(iPrint);
+            PrintStmtNode p = get_print_stmt_node(ast, node);
+            _convert(info, p.expression);
+            _append_i(info, iPrint);
             break;
         }
 
         case AST_WHILE_STMT: {
-            WhileStmtNode *w = (WhileStmtNode *)node;
-            usize start_label = _get_label();
+            WhileStmtNode w = get_while_stmt_node(ast, node);
+            usize start_label = _get_label(info);
 
             // eval condition
-            _convert(w->condition);
-            _append_i(iJmpZ);
-            usize lbl_end_idx = _get_label();
+            _convert(info, w.condition);
+            _append_i(info, iJmpZ);
+            usize lbl_end_idx = _get_label(info);
             // append instruction to occupy space
-            _append_i(iJmpZ);
+            _append_i(info, iJmpZ);
 
-            _convert(w->body);
-            _append_i(iJmp);
-            _append_i(start_label);
+            _convert(info, w.body);
+            _append_i(info, iJmp);
+            _append_i(info, start_label);
 
-            usize end_label = _get_label();
+            usize end_label = _get_label(info);
             // fix jump to end_label
-            res.functions.items[info.fn_idx].instructions.items[lbl_end_idx] = end_label;
+            info->res->functions.items[info->fn_idx].instructions.items[lbl_end_idx] = end_label;
             break;
         }
 
         case AST_FOR_STMT: {
-            ForStmtNode *f = (ForStmtNode *)node;
-            _convert(f->init);
+            ForStmtNode f = get_for_stmt_node(ast, node);
+            // The loop variable goes out of scope after the loop
+            usize old_count = info->local_count;
+            _convert(info, f.init);
 
-            usize start_label = _get_label();
+            usize start_label = _get_label(info);
             // eval condition
-            _convert(f->condition);
-            _append_i(iJmpZ);
-            usize lbl_end_idx = _get_label();
+            _convert(info, f.condition);
+            _append_i(info, iJmpZ);
+            usize lbl_end_idx = _get_label(info);
             // append instruction to occupy space
-            _append_i(iJmpZ);
+            _append_i(info, iJmpZ);
 
-            _convert(f->body);
-            _convert(f->increment);
-            _append_i(iJmp);
-            _append_i(start_label);
+            _convert(info, f.body);
+            _convert(info, f.increment);
+            _append_i(info, iJmp);
+            _append_i(info, start_label);
 
-            usize end_label = _get_label();
+            usize end_label = _get_label(info);
             // fix jump to end_label
-            res.functions.items[info.fn_idx].instructions.items[lbl_end_idx] = end_label;
+            info->res->functions.items[info->fn_idx].instructions.items[lbl_end_idx] = end_label;
+
+            info->local_count = old_count;
             break;
         }
 
         case AST_IF_STMT: {
+            ScratchArena scratch = scratch_begin(&info->scratch);
             struct {
                 usize *items;
                 usize count;
                 usize capacity;
             } end_indexes = {0};
 
-            IfStmtNode *i = (IfStmtNode *)node;
+            IfStmtNode i = get_if_stmt_node(ast, node);
 
-            _convert(i->condition);
+            _convert(info, i.condition);
 
-            _append_i(iJmpZ);
-            usize end_idx = _get_label();
+            _append_i(info, iJmpZ);
+            usize end_idx = _get_label(info);
             // append instruction to occupy space
-            _append_i(iJmpZ);
+            _append_i(info, iJmpZ);
 
-            _convert(i->then_block);
-            _append_i(iJmp);
-            da_append(&end_indexes, _get_label());
+            _convert(info, i.then_block);
+            _append_i(info, iJmp);
+            arena_da_append(&info->scratch, &end_indexes, _get_label(info));
             // append instruction to occupy space
-            _append_i(iJmp);
+            _append_i(info, iJmp);
 
-            usize end_label = _get_label();
+            usize end_label = _get_label(info);
             // fix jump to end_label for if-then block
-            res.functions.items[info.fn_idx].instructions.items[end_idx] = end_label;
+            info->res->functions.items[info->fn_idx].instructions.items[end_idx] = end_label;
 
-            if (i->elifs) {
-                AstNodeArray elifs = ((ElifClauseListNode *)i->elifs)->elifs;
+            if (i.elifs != NULL_NODE) {
+                AstNodeArray elifs = get_elif_clause_list_node(ast, i.elifs).elifs;
                 for (usize i = 0; i < elifs.count; ++i) {
-                    ElifClauseNode *elif = (ElifClauseNode *)elifs.items[i];
-                    _convert(elif->condition);
+                    ElifClauseNode elif = get_elif_clause_node(ast, elifs.items[i]);
+                    _convert(info, elif.condition);
 
-                    _append_i(iJmpZ);
-                    end_idx = _get_label();
+                    _append_i(info, iJmpZ);
+                    end_idx = _get_label(info);
                     // append instruction to occupy space
-                    _append_i(iJmpZ);
+                    _append_i(info, iJmpZ);
 
-                    _convert(elif->block);
-                    _append_i(iJmp);
-                    da_append(&end_indexes, _get_label());
+                    _convert(info, elif.block);
+                    _append_i(info, iJmp);
+                    arena_da_append(&info->scratch, &end_indexes, _get_label(info));
                     // append instruction to occupy space
-                    _append_i(iJmp);
+                    _append_i(info, iJmp);
 
-                    end_label = _get_label();
+                    end_label = _get_label(info);
                     // fix jump to end_label for elif-then block
-                    res.functions.items[info.fn_idx].instructions.items[end_idx] = end_label;
+                    info->res->functions.items[info->fn_idx].instructions.items[end_idx] = end_label;
                 }
             }
 
-            if (i->else_block) {
-                _convert(i->else_block);
+            if (i.else_block != NULL_NODE) {
+                _convert(info, i.else_block);
             }
 
-            usize absolute_end = _get_label();
+            usize absolute_end = _get_label(info);
             for (usize i = 0; i < end_indexes.count; ++i) {
-                res.functions.items[info.fn_idx].instructions.items[end_indexes.items[i]] = absolute_end;
+                info->res->functions.items[info->fn_idx].instructions.items[end_indexes.items[i]] = absolute_end;
             }
 
-            da_free(end_indexes);
+            scratch_end(scratch);
 
             break;
         }
 
         case AST_EXPR_STMT: {
-            ExprStmtNode *e = (ExprStmtNode *)node;
-            _convert(e->expression);
+            ExprStmtNode e = get_expr_stmt_node(ast, node);
+            _convert(info, e.expression);
             break;
         }
 
         case AST_ASSIGN_STMT: {
-            AssignStmtNode *a = (AssignStmtNode *)node;
-            _convert(a->value);
-
-            IdentifierNode *id = (IdentifierNode *)a->lvalue;
-            isize local_idx = _lookup_local(id->name);
-            if (local_idx >= 0) {
-                _append_i(iStore_Local);
-                _append_i(local_idx);
-            } else {
-                usize global_idx = _find_global(id->name.str);
-                _append_i(iStore_Global);
-                _append_i(global_idx);
-            }
+            AssignStmtNode a = get_assign_stmt_node(ast, node);
+            _convert(info, a.value);
+
+            IdentifierNode id = get_identifier_node(ast, a.lvalue);
+            _store_var(info, id.binding);
             break;
         }
 
         case AST_CALL_EXPR: {
-            CallExprNode *call = (CallExprNode *)node;
-            IdentifierNode *callee = (IdentifierNode *)call->callee;
-            AstNodeArray args = ((ArgumentListNode *)call->arguments)->arguments;
+            CallExprNode call = get_call_expr_node(ast, node);
+            IdentifierNode callee = get_identifier_node(ast, call.callee);
+            AstNodeArray args = get_argument_list_node(ast, call.arguments).arguments;
 
-            _append_i(iSave);
+            _append_i(info, iSave);
 
             for (usize i = 0; i < args.count; ++i)
-                _convert(args.items[i]);
+                _convert(info, args.items[i]);
 
-            usize offset = _lookup_function(callee->name);
-
-            _append_i(iCall);
-            _append_i(offset);
+            if (callee.binding.kind != BIND_FUNCTION) UNREACHABLE();
+            _append_i(info, iCall);
+            _append_i(info, callee.binding.idx);
 
             break;
         }
 
         case AST_VAR_DECL: {
-            VarDeclNode *var = (VarDeclNode *)node;
+            VarDeclNode var = get_var_decl_node(ast, node);
 
-            if (var->initializer) {
-                _convert(var->initializer);
+            if (var.initializer != NULL_NODE) {
+                _convert(info, var.initializer);
             } else {
-                PrimitiveTypeNode *type = (PrimitiveTypeNode *)var->type;
-                if (type->this.ast_type == AST_TYPE_NUM) {
-                    _append_i(iPush_Const);
-                    _append_i(_store_constant(s8("0"), VAL_NUM));
-                } else if (type->this.ast_type == AST_TYPE_BOOL) {
-                    _append_i(iPush_Const);
-                    _append_i(_store_constant(s8("false"), VAL_BOOL));
-                } else if (type->this.ast_type == AST_TYPE_STRING) {
-                    _append_i(iPush_Const);
-                    _append_i(_store_constant(s8(""), VAL_STR));
+                AstNodeType type = ast_type(ast, var.type);
+                if (type == AST_TYPE_NUM) {
+                    _append_i(info, iPush_Const);
+                    _append_i(info, _store_constant(info, s8("0"), VAL_NUM));
+                } else if (type == AST_TYPE_BOOL) {
+                    _append_i(info, iPush_Const);
+                    _append_i(info, _store_constant(info, s8("false"), VAL_BOOL));
+                } else if (type == AST_TYPE_STRING) {
+                    _append_i(info, iPush_Const);
+                    _append_i(info, _store_constant(info, s8(""), VAL_STR));
                 }
             }
 
-            if (info.in_func) {
-                isize local_idx = _push_local(_new_local(var->name));
-                _append_i(iStore_Local);
-                _append_i(local_idx);
+            if (info->in_func) {
+                _append_i(info, iStore_Local);
+                _append_i(info, info->local_count++);
             } else {
-                isize global_idx = _store_global(var->name.str);
-                _append_i(iStore_Global);
-                _append_i(global_idx);
+                isize global_idx = _store_global(info, token_str(ast, var.name));
+                _append_i(info, iStore_Global);
+                _append_i(info, global_idx);
             }
 
             break;
         }
 
         case AST_LITERAL_NUMBER: {
-            NumberLiteralNode *n = (NumberLiteralNode *)node;
-            _append_i(iPush_Const);
-            _append_i(_store_constant(n->value.str, VAL_NUM));
+            NumberLiteralNode n = get_number_literal_node(ast, node);
+            _append_i(info, iPush_Const);
+            _append_i(info, _store_constant(info, token_str(ast, n.value), VAL_NUM));
             break;
         }
 
         case AST_LITERAL_STRING: {
-            StringLiteralNode *n = (StringLiteralNode *)node;
-            _append_i(iPush_Const);
-            _append_i(_store_constant(n->value.str, VAL_STR));
+            StringLiteralNode n = get_string_literal_node(ast, node);
+            _append_i(info, iPush_Const);
+            _append_i(info, _store_constant(info, token_str(ast, n.value), VAL_STR));
             break;
         }
 
         case AST_LITERAL_BOOL: {
-            BoolLiteralNode *n = (BoolLiteralNode *)node;
-            _append_i(iPush_Const);
-            _append_i(_store_constant(n->token.str, VAL_BOOL));
+            BoolLiteralNode n = get_bool_literal_node(ast, node);
+            _append_i(info, iPush_Const);
+            _append_i(info, _store_constant(info, token_str(ast, n.token), VAL_BOOL));
             break;
         }
 
         case AST_IDENTIFIER: {
-            IdentifierNode *id = (IdentifierNode *)node;
-            isize local_idx = _lookup_local(id->name);
-            if (local_idx >= 0) {
-                _append_i(iLoad_Local);
-                _append_i(local_idx);
-            } else {
-                usize global_idx = _find_global(id->name.str);
-                _append_i(iLoad_Global);
-                _append_i(global_idx);
-            }
+            IdentifierNode id = get_identifier_node(ast, node);
+            _load_var(info, id.binding);
             break;
         }
 
         case AST_ASSIGN_EXPR: {
-            AssignExprNode *assign = (AssignExprNode *)node;
-            _convert(assign->value);
-
-            IdentifierNode *id = (IdentifierNode *)assign->lvalue;
-            isize local_idx = _lookup_local(id->name);
-            if (local_idx >= 0) {
-                _append_i(iStore_Local);
-                _append_i(local_idx);
-                _append_i(iLoad_Local);
-                _append_i(local_idx);
-            } else {
-                usize global_idx = _find_global(id->name.str);
-                _append_i(iStore_Global);
-                _append_i(global_idx);
-                _append_i(iLoad_Global);
-                _append_i(global_idx);
-            }
+            AssignExprNode assign = get_assign_expr_node(ast, node);
+            _convert(info, assign.value);
+
+            IdentifierNode id = get_identifier_node(ast, assign.lvalue);
+            _store_var(info, id.binding);
+            _load_var(info, id.binding);
             break;
         }
 
         case AST_BINARY_EXPR: {
-            BinaryExprNode *bin = (BinaryExprNode *)node;
-            _convert(bin->left);
-            _convert(bin->right);
-
-            switch (bin->op_token.type) {
-                case TOKEN_PLUS:          _append_i(iAdd);  break;
-                case TOKEN_MINUS:         _append_i(iSub);  break;
-                case TOKEN_STAR:          _append_i(iMul);  break;
-                case TOKEN_SLASH:         _append_i(iDiv);  break;
-                case TOKEN_AND:           _append_i(iAnd);  break;
-                case TOKEN_OR:            _append_i(iOr);   break;
-                case TOKEN_EQUAL_EQUAL:   _append_i(iEq);   break;
-                case TOKEN_BANG_EQUAL:    _append_i(iNeq);  break;
-                case TOKEN_GREATER:       _append_i(iGt);   break;
-                case TOKEN_GREATER_EQUAL: _append_i(iGte);  break;
-                case TOKEN_LESS:          _append_i(iLt);   break;
-                case TOKEN_LESS_EQUAL:    _append_i(iLte);  break;
+            BinaryExprNode bin = get_binary_expr_node(ast, node);
+            _convert(info, bin.left);
+            _convert(info, bin.right);
+
+            switch (bin.op_token.type) {
+                case TOKEN_PLUS:          _append_i(info, iAdd);  break;
+                case TOKEN_MINUS:         _append_i(info, iSub);  break;
+                case TOKEN_STAR:          _append_i(info, iMul);  break;
+                case TOKEN_SLASH:         _append_i(info, iDiv);  break;
+                case TOKEN_AND:           _append_i(info, iAnd);  break;
+                case TOKEN_OR:            _append_i(info, iOr);   break;
+                case TOKEN_EQUAL_EQUAL:   _append_i(info, iEq);   break;
+                case TOKEN_BANG_EQUAL:    _append_i(info, iNeq);  break;
+                case TOKEN_GREATER:       _append_i(info, iGt);   break;
+                case TOKEN_GREATER_EQUAL: _append_i(info, iGte);  break;
+                case TOKEN_LESS:          _append_i(info, iLt);   break;
+                case TOKEN_LESS_EQUAL:    _append_i(info, iLte);  break;
                 default: UNREACHABLE();
             }
             break;
         }
 
         case AST_UNARY_EXPR: {
-            UnaryExprNode *un = (UnaryExprNode *)node;
-            _convert(un->operand);
+            UnaryExprNode un = get_unary_expr_node(ast, node);
+            _convert(info, un.operand);
 
-            switch (un->op_token.type) {
-                case TOKEN_BANG:  _append_i(iNot); break;
-                case TOKEN_MINUS: _append_i(iNeg); break;
+            switch (un.op_token.type) {
+                case TOKEN_BANG:  _append_i(info, iNot); break;
+                case TOKEN_MINUS: _append_i(info, iNeg); break;
                 default: UNREACHABLE();
             }
             break;
         }
 
         case AST_PAREN_EXPR: {
-            ParenExprNode *paren = (ParenExprNode *)node;
-            _convert(paren->expression);
+            ParenExprNode paren = get_paren_expr_node(ast, node);
+            _convert(info, paren.expression);
             break;
         }
 
@@ -510,13 +483,151 @@ void _convert(AstNode *node) {
     }
 }
 
-ConversionResult convert(AstNode *program) {
-    _init_converter();
-    _init_info();
-    _convert(program);
+static void _convert_body(Info *info, NodeIdx node) {
+    FunctionDeclNode fn = get_function_decl_node(info->ast, node);
+
+    // Parameters take the first slots
+    AstNodeArray params = get_parameter_list_node(info->ast, fn.parameters).parameters;
+    info->local_count = params.count;
+    info->in_func = true;
+    info->fn_idx = fn.idx;
+
+    PoolRange *range = &info->bodies->ranges[fn.idx];
+    range->pool = info->constants - info->bodies->pools;
+    range->start = info->constants->count;
+
+    _convert(info, fn.body);
+    _append_i(info, iRestore);
+
+    range->count = info->constants->count - range->start;
+    info->local_count = 0;
+    info->in_func = false;
+}
+
+typedef struct {
+    Ast *ast;
+    ConversionResult *res;
+    Bodies *bodies;
+    usize pool;
+    ArenaStats scratch;
+    b32 error;
+} Worker;
+
+static void *_body_worker(void *arg) {
+    Worker *w = arg;
+    Info info;
+    _init_info(&info, w->ast, w->res, w->bodies);
+    info.constants = &w->bodies->pools[w->pool];
+    for (;;) {
+        usize i = atomic_fetch_add(&w->bodies->next, 1);
+        if (i >= w->bodies->bodies.count) break;
+        _convert_body(&info, w->bodies->bodies.items[i]);
+    }
+    w->error = info.error;
+    w->scratch = info.scratch.stats;
+    arena_free(&info.scratch);
+    return NULL;
+}
+
+static usize _thread_count(Bodies *bodies) {
+    isize cores = sysconf(_SC_NPROCESSORS_ONLN);
+    usize n = bodies->bodies.count / CONVERT_BODIES_PER_THREAD;
+    if (cores > 0 && n > (usize)cores) n = cores;
+    if (n > CONVERT_MAX_THREADS) n = CONVERT_MAX_THREADS;
+    return n > 0 ? n : 1;
+}
+
+// Constant indices in a body refer to its thread's pool until now
+static void _merge_constants(ConversionResult *res, Bodies *bodies, FunctionSymbol *fn, PoolRange range) {
+    if (range.count == 0) return;
+
+    usize base = res->constants.count - range.start;
+    InstructionSet *set = &fn->instructions;
+    for (usize i = 0; i < set->count; ++i) {
+        Instruction instr = set->items[i];
+        if (instr == iPush_Const) {
+            ++i;
+            set->items[i] = _check_operand(&res->error, set->items[i] + base);
+        }
+        else if (instr == iCall || has_arg(instr) || is_jmp(instr)) ++i;
+    }
+
+    ValueArray *pool = &bodies->pools[range.pool];
+    da_append_many(&res->constants, pool->items + range.start, range.count);
+}
+
+static void _add_stats(ArenaStats *total, ArenaStats *stats) {
+    total->used += stats->used;
+    total->reserved += stats->reserved;
+    total->chunks += stats->chunks;
+    if (total->peak < stats->peak) total->peak = stats->peak;
+}
+
+static void _convert_bodies(Ast *ast, ConversionResult *res, Bodies *bodies) {
+    bodies->ranges = calloc(res->functions.count + 1, sizeof(*bodies->ranges));
+    if (bodies->ranges == NULL) UNREACHABLE();
+    atomic_store(&bodies->next, 0);
+
+    // The calling thread is the first worker
+    usize thread_count = _thread_count(bodies);
+    Worker workers[CONVERT_MAX_THREADS];
+    pthread_t threads[CONVERT_MAX_THREADS];
+    for (usize i = 0; i < thread_count; ++i)
+        workers[i] = (Worker) {.ast = ast, .res = res, .bodies = bodies, .pool = i};
+
+    usize started = 1;
+    for (; started < thread_count; ++started) {
+        if (pthread_create(&threads[started], NULL, _body_worker, &workers[started]) != 0)
+            break;
+    }
+    _body_worker(&workers[0]);
+    for (usize i = 1; i < started; ++i)
+        pthread_join(threads[i], NULL);
+    for (usize i = 0; i < started; ++i) {
+        res->error |= workers[i].error;
+        _add_stats(&res->scratch, &workers[i].scratch);
+    }
+
+    for (usize i = 0; i < res->functions.count; ++i)
+        _merge_constants(res, bodies, &res->functions.items[i], bodies->ranges[i]);
+
+    for (usize i = 0; i < started; ++i)
+        da_free(bodies->pools[i]);
+    free(bodies->ranges);
+    da_free(bodies->bodies);
+}
+
+// Calls to imported functions go through external entries, the
+// linker finds their code in the other modules by name
+static void _add_externals(ConversionResult *res, Imports *imports) {
+    for (usize i = 0; imports != NULL && i < imports->count; ++i) {
+        ImportedFunctions *functions = &imports->items[i];
+        for (usize j = 0; j < functions->count; ++j) {
+            ImportedFunction *import = &functions->items[j];
+            while (res->functions.count <= import->idx) {
+                da_append(&res->functions, (FunctionSymbol) {0});
+            }
+            res->functions.items[import->idx] = (FunctionSymbol) {
+                .name = import->name,
+                .sym = import->sym,
+                .external = true
+            };
+        }
+    }
+}
+
+ConversionResult convert(Ast *ast, Imports *imports) {
+    ConversionResult res = {0};
+    Bodies bodies = {0};
 
-    if (info.locals.items)
-        da_free(info.locals);
+    Info info;
+    _init_info(&info, ast, &res, &bodies);
+    _convert(&info, ast->root);
+    res.error = info.error;
+    res.scratch = info.scratch.stats;
+    arena_free(&info.scratch);
+    _add_externals(&res, imports);
 
+    _convert_bodies(ast, &res, &bodies);
     return res;
 }
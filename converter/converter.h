@@ -5,11 +5,20 @@
 #include "../ast/node.h"
 #include "../ast/token.h"
 #include "value.h"
+#include "../ast/ast_checker.h"
 
+// The signature is kept so modules importing the function can be
+// checked against it, types are AstNodeTypes of builtin types
 typedef struct {
-    Token name;
+    s8 name;
+    SymbolId sym;
+    u32 line; // only known for prototypes, the linker reports missing bodies
     InstructionSet instructions;
     usize address;
+    b32 external; // defined by an imported module, resolved by name
+    u8 return_type;
+    u32 param_start; // into ConversionResult.param_types
+    u32 param_count;
 } FunctionSymbol;
 
 typedef struct {
@@ -18,13 +27,25 @@ typedef struct {
     usize capacity;
 } FunctionTable;
 
+typedef struct {
+    u8 *items;
+    usize count;
+    usize capacity;
+} TypeArray;
+
+// One module, the linker merges several of them into a program
 typedef struct {
     InstructionSet instructions;
     s8Array globals;
     ValueArray constants;
     FunctionTable functions;
+    TypeArray param_types;
+    ArenaStats scratch; // of all scratch arenas, peaks are those of the busiest one
+    b32 error; // an operand did not fit an IrWord, already reported
 } ConversionResult;
 
-ConversionResult convert(AstNode *program);
+// 'imports' are the ones the checker was given, their functions
+// become external ones
+ConversionResult convert(Ast *ast, Imports *imports);
 
 #endif
\ No newline at end of file
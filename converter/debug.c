@@ -25,7 +25,7 @@ void disassemble(ConversionResult result, byte *set_name) {
     for (usize i = 0; i < result.functions.count; ++i) {
         FunctionSymbol *fn = &result.functions.items[i];
         char fn_label[256];
-        snprintf(fn_label, sizeof(fn_label), "function %.*s", (int)fn->name.str.len, fn->name.str.s);
+        snprintf(fn_label, sizeof(fn_label), "function %.*s", (int)fn->name.len, fn->name.s);
         _disassemble_set(&fn->instructions, result, fn_label);
     }
 }
@@ -69,6 +69,7 @@ usize _disassemble_instruction(InstructionSet *instructions, ConversionResult re
         case iLoad_Local:
         case iJmp:
         case iJmpZ:
+        case iJmpNZ:
             return _local_instruction(instruction, offset, instructions);
 
         case iCall:
@@ -129,6 +130,7 @@ usize _local_instruction(Instruction i, usize offset, InstructionSet *instructio
         case iLoad_Local:  printf("iLoad_Local ");  break;
         case iJmp:         printf("iJmp ");         break;
         case iJmpZ:        printf("iJmpZ ");        break;
+        case iJmpNZ:       printf("iJmpNZ ");       break;
         default: UNREACHABLE();
     }
 
@@ -139,7 +141,7 @@ usize _local_instruction(Instruction i, usize offset, InstructionSet *instructio
 static inline
 usize _call_instruction(usize offset, ConversionResult result, InstructionSet *instructions) {
     usize idx = instructions->items[offset + instruction_size];
-    s8 fn_name = result.functions.items[idx].name.str;
+    s8 fn_name = result.functions.items[idx].name;
     printf("iCall %.*s\n", (i32)fn_name.len, fn_name.s);
     return offset + 2 * instruction_size;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define INSTRUCTIONS_INCLUDE
 
 #include "types.h"
+#include <string.h>
 
 typedef enum {
     iPush_Const,
@@ -38,13 +39,137 @@ typedef enum {
     iPrint,
 
     iJmpZ,
-    iJmp
+    iJmpNZ,
+    iJmp,
+
+    iWide // prefix, see encode_instr()
 } Instruction;
 
+// The converter and the optimizer work on whole words, an operand
+// takes the slot after its instruction. The converter refuses
+// operands larger than IR_OPERAND_MAX.
+typedef u32 IrWord;
+#define IR_OPERAND_MAX UINT32_MAX
+
 typedef struct {
-    Instruction* items;
+    IrWord *items;
     usize count;
     usize capacity;
 } InstructionSet;
 
-#endif
\ No newline at end of file
+// Linked code is a stream of bytes, see encoded_size()
+typedef struct {
+    u8 *items;
+    usize count;
+    usize capacity;
+} CodeArray;
+
+static inline
+b32 has_arg(Instruction instr) {
+    return instr == iPush_Const || instr == iStore_Global ||
+           instr == iLoad_Global || instr == iStore_Local ||
+           instr == iLoad_Local;
+}
+
+static inline
+b32 is_jmp(Instruction instr) {
+    return instr == iJmpZ || instr == iJmpNZ || instr == iJmp;
+}
+
+// Words one instruction takes in an InstructionSet
+static inline
+usize ir_width(Instruction instr) {
+    return (instr == iCall || has_arg(instr) || is_jmp(instr)) ? 2 : 1;
+}
+
+// In linked code every opcode is one byte. Indices follow as ULEB128,
+// one byte while they are below 128. Call and jump targets take a
+// fixed ADDRESS_SIZE bytes, so the linker knows the size of a jump
+// before it knows where the jump goes.
+//
+// Programs with more than ADDRESS_MAX bytes of function code are
+// linked 'wide': every call and jump becomes iWide, the opcode and
+// WIDE_ADDRESS_SIZE bytes of target.
+#define ADDRESS_SIZE 4
+#define ADDRESS_MAX UINT32_MAX
+#define WIDE_ADDRESS_SIZE 8
+
+static inline
+b32 has_address(Instruction instr) {
+    return instr == iCall || is_jmp(instr);
+}
+
+static inline
+usize uleb_size(usize value) {
+    usize size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static inline
+usize encoded_size(Instruction instr, usize arg, b32 wide) {
+    if (has_address(instr)) return wide ? 2 + WIDE_ADDRESS_SIZE : 1 + ADDRESS_SIZE;
+    if (has_arg(instr))     return 1 + uleb_size(arg);
+    return 1;
+}
+
+// Writes at 'code', which has room for encoded_size() bytes
+static inline
+u8 *encode_instr(u8 *code, Instruction instr, usize arg, b32 wide) {
+    if (has_address(instr) && wide) {
+        u64 address = arg;
+        *code++ = iWide;
+        *code++ = instr;
+        memcpy(code, &address, WIDE_ADDRESS_SIZE);
+        return code + WIDE_ADDRESS_SIZE;
+    }
+
+    *code++ = instr;
+    if (has_address(instr)) {
+        u32 address = arg;
+        memcpy(code, &address, ADDRESS_SIZE);
+        return code + ADDRESS_SIZE;
+    }
+    if (has_arg(instr)) {
+        while (arg >= 0x80) {
+            *code++ = (arg & 0x7f) | 0x80;
+            arg >>= 7;
+        }
+        *code++ = arg;
+    }
+    return code;
+}
+
+static inline
+usize decode_index(u8 *code, usize *ip) {
+    u8 b = code[(*ip)++];
+    if (b < 0x80) return b;
+
+    usize value = b & 0x7f;
+    for (u32 shift = 7;; shift += 7) {
+        b = code[(*ip)++];
+        value |= (usize)(b & 0x7f) << shift;
+        if (b < 0x80) return value;
+    }
+}
+
+static inline
+usize decode_address(u8 *code, usize *ip) {
+    u32 address;
+    memcpy(&address, code + *ip, ADDRESS_SIZE);
+    *ip += ADDRESS_SIZE;
+    return address;
+}
+
+static inline
+usize decode_wide_address(u8 *code, usize *ip) {
+    u64 address;
+    memcpy(&address, code + *ip, WIDE_ADDRESS_SIZE);
+    *ip += WIDE_ADDRESS_SIZE;
+    return address;
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "s8.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <sys/mman.h>
 
 typedef struct {
     b32 in_use;
@@ -43,100 +44,408 @@ void _linker_error(const byte *fmt, ...) {
     fputc('\n', stderr);
 }
 
-static inline
-b32 _s8_eq(s8 s1, s8 s2) {
-    return s1.len == s2.len &&
-        memcmp(s1.s, s2.s, s1.len) == 0;
+// Linking takes two passes. The first gives every function its start
+// address, depth first from its first call, so a callee usually ends
+// up right behind its caller. The second encodes every function at its
+// address, all calls and jumps are known by then.
+//
+// With a profile the hot functions are laid out first, hottest first,
+// each followed by the hot functions it calls. Everything else goes
+// behind them in the usual order.
+typedef struct {
+    ConversionResult *conv;
+    EntryArr use_arr;
+    CodeArray code;
+    usize *offsets;      // byte offset of every instruction in its function
+    usize *first_offset; // index of a function's first offset
+    usize end_address;   // one past the code laid out so far
+    b32 wide;            // calls and jumps take wide addresses
+    b32 *hot;            // by function, NULL without a profile
+} Linker;
+
+// A function is hot with at least 1/HOT_SHARE of the calls
+// of the hottest one
+#define HOT_SHARE 1024
+
+typedef struct {
+    usize fn_idx;
+    u64 calls;
+} HotFunction;
+
+typedef struct {
+    HotFunction *items;
+    usize count;
+    usize capacity;
+} HotFunctions;
+
+// A function whose calls are still being followed
+typedef struct {
+    usize fn_idx;
+    usize next; // next word to look at
+} LayoutFrame;
+
+typedef struct {
+    LayoutFrame *items;
+    usize count;
+    usize capacity;
+} LayoutStack;
+
+// The encoded size of an instruction does not depend on where it ends
+// up, so every instruction's place in its function is known up front.
+// The offset past a function's last word is the function's size.
+static
+usize _compute_offsets(Linker *linker) {
+    FunctionTable *functions = &linker->conv->functions;
+    free(linker->first_offset);
+    free(linker->offsets);
+    linker->first_offset = malloc(functions->count * sizeof(usize));
+    if (linker->first_offset == NULL) UNREACHABLE();
+
+    usize words = 0;
+    for (usize i = 0; i < functions->count; ++i) {
+        linker->first_offset[i] = words;
+        words += functions->items[i].instructions.count + 1;
+    }
+    linker->offsets = malloc(words * sizeof(usize));
+    if (linker->offsets == NULL) UNREACHABLE();
+
+    usize total = 0;
+    for (usize i = 0; i < functions->count; ++i) {
+        InstructionSet *set = &functions->items[i].instructions;
+        usize *offsets = linker->offsets + linker->first_offset[i];
+
+        usize at = 0;
+        for (usize w = 0; w < set->count; w += ir_width(set->items[w])) {
+            Instruction instr = set->items[w];
+            offsets[w] = at;
+            at += encoded_size(instr, ir_width(instr) == 2 ? set->items[w + 1] : 0, linker->wide);
+        }
+        offsets[set->count] = at;
+        total += at;
+    }
+    return total;
 }
 
-b32 has_arg(Instruction instr) {
-    return instr == iPush_Const || instr == iStore_Global ||
-           instr == iLoad_Global || instr == iStore_Local ||
-           instr == iLoad_Local;
+static
+usize _function_size(Linker *linker, usize fn_idx) {
+    usize words = linker->conv->functions.items[fn_idx].instructions.count;
+    return linker->offsets[linker->first_offset[fn_idx] + words];
 }
 
-b32 is_jmp(Instruction instr) {
-    return instr == iJmpZ || instr == iJmp;
+static
+void _place_function(Linker *linker, LayoutStack *stack, usize fn_idx) {
+    mark_used(linker->use_arr, fn_idx);
+    set_address(linker->use_arr, fn_idx, linker->end_address);
+    linker->end_address += _function_size(linker, fn_idx);
+    da_append(stack, ((LayoutFrame) { .fn_idx = fn_idx }));
 }
 
-usize end_address = 0;
+// The call graph is walked with an explicit stack, long call chains
+// in generated code cannot run out of C stack
+static
+void _walk_calls(Linker *linker, LayoutStack *stack, usize root, b32 hot_only) {
+    FunctionTable *functions = &linker->conv->functions;
+    _place_function(linker, stack, root);
+
+    while (stack->count > 0) {
+        LayoutFrame *frame = &stack->items[stack->count - 1];
+        InstructionSet *set = &functions->items[frame->fn_idx].instructions;
+        if (frame->next >= set->count) {
+            stack->count--;
+            continue;
+        }
 
-static usize dfs_link_function(
-    usize fn_idx,
-    ConversionResult *conv,
-    EntryArr *use_arr,
-    InstructionSet *instructions,
-    usize write_head
-) {
-    if (used(*use_arr, fn_idx)) {
-        return get_address(*use_arr, fn_idx);
+        Instruction instr = set->items[frame->next];
+        usize callee = instr == iCall ? set->items[frame->next + 1] : 0;
+        frame->next += ir_width(instr);
+        if (instr == iCall && !used(linker->use_arr, callee) &&
+            (!hot_only || linker->hot[callee]))
+            _place_function(linker, stack, callee);
     }
+}
 
-    FunctionSymbol *fn = &conv->functions.items[fn_idx];
-    usize start_address = write_head;
-    if (end_address < write_head + fn->instructions.count)
-        end_address = write_head + fn->instructions.count;
-    
-    mark_used(*use_arr, fn_idx);
-    set_address(*use_arr, fn_idx, write_head);
+static
+i32 _hotter(const void *a, const void *b) {
+    const HotFunction *x = a, *y = b;
+    if (x->calls != y->calls) return x->calls < y->calls ? 1 : -1;
+    return (x->fn_idx > y->fn_idx) - (x->fn_idx < y->fn_idx);
+}
 
-    usize i = 0;
-    while (i < fn->instructions.count) {
-        Instruction instr = fn->instructions.items[i];
-        instructions->items[write_head++] = instr;
+// Hot functions, hottest first
+static
+HotFunctions _hot_functions(Linker *linker, Profile *profile) {
+    FunctionTable *functions = &linker->conv->functions;
+    HotFunctions hot = {0};
+    u64 hottest = 0;
+    for (usize i = 0; i < functions->count; ++i) {
+        u64 calls = profile_calls(profile, functions->items[i].name);
+        if (calls > hottest) hottest = calls;
+        if (calls > 0) da_append(&hot, ((HotFunction) { .fn_idx = i, .calls = calls }));
+    }
 
-        if (instr == iCall) {
-            usize callee_idx = fn->instructions.items[++i];
+    usize kept = 0;
+    for (usize i = 0; i < hot.count; ++i) {
+        if (hot.items[i].calls >= hottest / HOT_SHARE) hot.items[kept++] = hot.items[i];
+    }
+    hot.count = kept;
+    if (hot.count > 0) qsort(hot.items, hot.count, sizeof(HotFunction), _hotter);
+    return hot;
+}
 
-            usize callee_addr = dfs_link_function(
-                callee_idx, conv, use_arr, instructions, end_address
-            );
+static
+void _layout_functions(Linker *linker, Profile *profile) {
+    FunctionTable *functions = &linker->conv->functions;
+    LayoutStack stack = {0};
 
-            instructions->items[write_head++] = callee_addr;
-        } else if (has_arg(instr)) {
-            ++i;
-            instructions->items[write_head++] = fn->instructions.items[i];
+    if (profile != NULL && functions->count > 0) {
+        HotFunctions hot = _hot_functions(linker, profile);
+        linker->hot = calloc(functions->count, sizeof(b32));
+        if (linker->hot == NULL) UNREACHABLE();
+        for (usize i = 0; i < hot.count; ++i) linker->hot[hot.items[i].fn_idx] = true;
+
+        for (usize i = 0; i < hot.count; ++i) {
+            if (!used(linker->use_arr, hot.items[i].fn_idx))
+                _walk_calls(linker, &stack, hot.items[i].fn_idx, true);
+        }
+        da_free(hot);
+        free(linker->hot);
+        linker->hot = NULL;
+    }
+
+    for (usize root = 0; root < functions->count; ++root) {
+        if (!used(linker->use_arr, root)) _walk_calls(linker, &stack, root, false);
+    }
+
+    da_free(stack);
+}
+
+static
+void _relocate_function(Linker *linker, usize fn_idx) {
+    InstructionSet *set = &linker->conv->functions.items[fn_idx].instructions;
+    usize *offsets = linker->offsets + linker->first_offset[fn_idx];
+    usize start_address = get_address(linker->use_arr, fn_idx);
+
+    for (usize i = 0; i < set->count; i += ir_width(set->items[i])) {
+        Instruction instr = set->items[i];
+        usize arg = ir_width(instr) == 2 ? set->items[i + 1] : 0;
+
+        if (instr == iCall) {
+            arg = get_address(linker->use_arr, arg);
         } else if (is_jmp(instr)) {
-            ++i;
-            instructions->items[write_head++] = fn->instructions.items[i] + start_address;
+            arg = start_address + offsets[arg];
+        }
+        encode_instr(linker->code.items + start_address + offsets[i], instr, arg, linker->wide);
+    }
+}
+
+static
+void _append_instr(CodeArray *code, Instruction instr, usize arg, b32 wide) {
+    da_reserve(code, code->count + encoded_size(instr, arg, wide));
+    u8 *end = encode_instr(code->items + code->count, instr, arg, wide);
+    code->count = end - code->items;
+}
+
+static
+void _free_conversion(ConversionResult *conv, b32 keep_constants) {
+    for (usize i = 0; i < conv->functions.count; ++i) {
+        da_free(conv->functions.items[i].instructions);
+    }
+    da_free(conv->functions);
+    da_free(conv->globals);
+    da_free(conv->instructions);
+    da_free(conv->param_types);
+    if (!keep_constants) da_free(conv->constants);
+}
+
+#define NOT_MERGED ((u32)-1)
+
+static
+b32 _relocate_word(IrWord *word, usize value) {
+    if (value > IR_OPERAND_MAX) {
+        _linker_error("operand %zu is larger than %zu, the program is too large",
+            value, (usize)IR_OPERAND_MAX);
+        return false;
+    }
+    *word = value;
+    return true;
+}
+
+// Constants, globals and functions of a module move behind the ones
+// of the modules before it
+static
+b32 _relocate_code(InstructionSet *set, usize *remap, usize constant_base, usize global_base) {
+    for (usize i = 0; i < set->count; i += ir_width(set->items[i])) {
+        Instruction instr = set->items[i];
+        IrWord *arg = &set->items[i + 1];
+        b32 ok = true;
+        switch (instr) {
+            case iPush_Const:   ok = _relocate_word(arg, *arg + constant_base); break;
+            case iLoad_Global:
+            case iStore_Global: ok = _relocate_word(arg, *arg + global_base);   break;
+            case iCall:         ok = _relocate_word(arg, remap[*arg]);          break;
+            default: break;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Gives every function of every module its index in the merged table,
+// external ones get the index of the function with their name
+static
+b32 _resolve_functions(ConversionResult *objects, usize count, usize **remap, ConversionResult *merged) {
+    SymbolTable names = {0};
+    SymbolMap defined = {0}; // name -> merged index
+    b32 ok = true;
+
+    for (usize o = 0; o < count; ++o) {
+        FunctionTable *functions = &objects[o].functions;
+        for (usize i = 0; i < functions->count; ++i) {
+            FunctionSymbol fn = functions->items[i];
+            if (fn.external) continue;
+
+            SymbolId id = intern(&names, fn.name);
+            if (symbol_map_get(&defined, id, NOT_MERGED) != NOT_MERGED) {
+                _linker_error("function '%.*s' is defined by more than one module",
+                    (i32)fn.name.len, fn.name.s);
+                ok = false;
+                continue;
+            }
+
+            remap[o][i] = merged->functions.count;
+            symbol_map_put(&defined, id, merged->functions.count);
+
+            fn.param_start = merged->param_types.count;
+            TypeArray *types = &objects[o].param_types;
+            if (fn.param_count > 0)
+                da_append_many(&merged->param_types, types->items + functions->items[i].param_start, fn.param_count);
+            da_append(&merged->functions, fn);
+            functions->items[i].instructions = (InstructionSet) {0};
+        }
+    }
+
+    for (usize o = 0; ok && o < count; ++o) {
+        FunctionTable *functions = &objects[o].functions;
+        for (usize i = 0; i < functions->count; ++i) {
+            FunctionSymbol *fn = &functions->items[i];
+            if (!fn->external) continue;
+
+            u32 idx = symbol_map_get(&defined, intern(&names, fn->name), NOT_MERGED);
+            if (idx == NOT_MERGED) {
+                _linker_error("function '%.*s' is not defined by any module",
+                    (i32)fn->name.len, fn->name.s);
+                ok = false;
+            }
+            remap[o][i] = idx;
         }
-        ++i;
     }
 
-    return start_address;
+    symbol_map_free(&defined);
+    free_symbols(&names);
+    return ok;
+}
+
+// The modules' top-level code runs in their order, the last one is
+// the program itself. Every module is consumed.
+static
+b32 _merge_objects(ConversionResult *objects, usize count, ConversionResult *merged) {
+    *merged = (ConversionResult) {0};
+    b32 ok = true;
+    for (usize o = 0; o < count; ++o) ok = ok && !objects[o].error;
+
+    usize **remap = calloc(count, sizeof(*remap));
+    if (remap == NULL) UNREACHABLE();
+    for (usize o = 0; o < count; ++o) {
+        remap[o] = malloc((objects[o].functions.count + 1) * sizeof(usize));
+        if (remap[o] == NULL) UNREACHABLE();
+    }
+
+    ok = ok && _resolve_functions(objects, count, remap, merged);
+
+    for (usize o = 0; ok && o < count; ++o) {
+        ConversionResult *object = &objects[o];
+        usize constant_base = merged->constants.count;
+        usize global_base = merged->globals.count;
+
+        for (usize i = 0; ok && i < object->functions.count; ++i) {
+            if (object->functions.items[i].external) continue;
+            InstructionSet *set = &merged->functions.items[remap[o][i]].instructions;
+            ok = _relocate_code(set, remap[o], constant_base, global_base);
+        }
+        ok = ok && _relocate_code(&object->instructions, remap[o], constant_base, global_base);
+
+        // Only the last module halts
+        InstructionSet *top = &object->instructions;
+        if (o + 1 < count && top->count > 0 && top->items[top->count - 1] == iHalt) top->count--;
+
+        if (object->constants.count > 0)
+            da_append_many(&merged->constants, object->constants.items, object->constants.count);
+        if (object->globals.count > 0)
+            da_append_many(&merged->globals, object->globals.items, object->globals.count);
+        if (top->count > 0)
+            da_append_many(&merged->instructions, top->items, top->count);
+    }
+
+    for (usize o = 0; o < count; ++o) {
+        _free_conversion(&objects[o], false);
+        free(remap[o]);
+    }
+    free(remap);
+
+    if (!ok) _free_conversion(merged, false);
+    return ok;
+}
+
+// Reported once, later strings are dropped
+static
+StrRef _add_string(ByteArray *strings, s8 str, b32 *error) {
+    if ((usize)str.len > STR_REF_MAX - strings->count) {
+        if (!*error) _linker_error("strings take more than %zu bytes, the program is too large",
+                                   (usize)STR_REF_MAX);
+        *error = true;
+        return (StrRef) {0};
+    }
+    StrRef ref = { .offset = strings->count, .len = str.len };
+    if (str.len > 0) da_append_many(strings, str.s, (usize)str.len);
+    return ref;
 }
 
-LinkResult link(ConversionResult conv) {
+LinkResult link(ConversionResult *objects, usize count, Profile *profile) {
+    ConversionResult conv;
+    if (!_merge_objects(objects, count, &conv)) {
+        return (LinkResult) { .error = true };
+    }
+
     EntryArr use_arr = {0};
     da_reserve(&use_arr, conv.functions.count);
 
-    usize instructions_len = 0;
     for (usize i = 0; i < conv.functions.count; ++i) {
         use_arr.items[i] = (Entry) { .in_use = false };
-        instructions_len += conv.functions.items[i].instructions.count;
 
         if (conv.functions.items[i].instructions.count == 0) {
             _linker_error("function's '%.*s' body not provided. "
                           "Prototype mentioned at line %d",
-                (i32)conv.functions.items[i].name.str.len, 
-                conv.functions.items[i].name.str.s, 
-                conv.functions.items[i].name.line);
+                (i32)conv.functions.items[i].name.len, 
+                conv.functions.items[i].name.s, 
+                conv.functions.items[i].line);
+            da_free(use_arr);
+            _free_conversion(&conv, false);
             return (LinkResult) { .error = true };
         }
     }
 
-    InstructionSet instructions = {0};
-    da_reserve(&instructions, instructions_len);
 
     b32 main_found = false;
     usize main_idx;
     for (usize i = 0; i < conv.functions.count; ++i) {
-        if (_s8_eq(conv.functions.items[i].name.str, s8("main"))) {
+        if (conv.functions.items[i].sym == SYM_MAIN) {
             if (!main_found) {
                 main_found = true;
                 main_idx = i;
             } else {
                 _linker_error("mulitple 'main' functions found");
+                da_free(use_arr);
+                _free_conversion(&conv, false);
                 return (LinkResult) { .error = true };
             }
         }
@@ -144,50 +453,97 @@ LinkResult link(ConversionResult conv) {
 
     if (!main_found) {
         _linker_error("function 'main' not found");
+        da_free(use_arr);
+        _free_conversion(&conv, false);
         return (LinkResult) { .error = true };
     }
 
     // Code from functions
-    end_address = 0;
+    Linker linker = {
+        .conv = &conv,
+        .use_arr = use_arr
+    };
+    // Calls and jumps only ever target function code
+    usize code_size = _compute_offsets(&linker);
+    if (code_size > ADDRESS_MAX) {
+        linker.wide = true;
+        code_size = _compute_offsets(&linker);
+    }
+    da_reserve(&linker.code, code_size);
+    _layout_functions(&linker, profile);
     for (usize i = 0; i < conv.functions.count; ++i) {
-        dfs_link_function(i, &conv, &use_arr, &instructions, end_address);
+        _relocate_function(&linker, i);
     }
-    
-    instructions.count = instructions_len;
-    usize first_instr = instructions.count;
+    free(linker.offsets);
+    free(linker.first_offset);
+
+    CodeArray code = linker.code;
+    code.count = code_size;
+    usize first_instr = code.count;
 
     // Code to run before calling 'main'
-    for (usize i = 0; i < conv.instructions.count; ++i) {
+    for (usize i = 0; i < conv.instructions.count; i += ir_width(conv.instructions.items[i])) {
         Instruction instr = conv.instructions.items[i];
-        da_append(&instructions, instr);
-
-        if (instr == iCall) {
-            usize callee_idx = conv.instructions.items[++i];
-            usize callee_addr = get_address(use_arr, callee_idx);
-            da_append(&instructions, callee_addr);
-        } else if (has_arg(instr)) {
-            da_append(&instructions, conv.instructions.items[++i]);
-        }
+        usize arg = ir_width(instr) == 2 ? conv.instructions.items[i + 1] : 0;
+        if (instr == iCall) arg = get_address(use_arr, arg);
+        _append_instr(&code, instr, arg, linker.wide);
     }
 
     // Override iHalt
-    instructions.items[instructions.count - 1] = iSave;
+    code.items[code.count - 1] = iSave;
     // Call main
-    da_append(&instructions, iCall);
-    da_append(&instructions, get_address(use_arr, main_idx));
-    da_append(&instructions, iHalt);
+    _append_instr(&code, iCall, get_address(use_arr, main_idx), linker.wide);
+    _append_instr(&code, iHalt, 0, false);
+
+    // String constants still point into the source
+    ByteArray strings = {0};
+    b32 too_large = false;
+    for (usize i = 0; i < conv.constants.count; ++i) {
+        Value *val = &conv.constants.items[i];
+        if (val->type == VAL_STR) val->ref = _add_string(&strings, val->str, &too_large);
+    }
+
+    FunctionEntries functions = {0};
+    for (usize i = 0; i < conv.functions.count; ++i) {
+        FunctionEntry entry = {
+            .name = _add_string(&strings, conv.functions.items[i].name, &too_large),
+            .address = get_address(use_arr, i)
+        };
+        da_append(&functions, entry);
+    }
+
+    usize globals_count = conv.globals.count;
+    da_free(use_arr);
+    _free_conversion(&conv, true);
 
-    da_free(conv.functions);
-    da_free(conv.globals);
-    da_free(conv.instructions);
+    if (too_large) {
+        LinkResult partial = { .constants = conv.constants, .code = code, .strings = strings, .functions = functions };
+        free_link(&partial);
+        return (LinkResult) { .error = true };
+    }
 
     return (LinkResult) { 
         .constants = conv.constants, 
-        .instructions = instructions, 
-        .first_instr = first_instr 
+        .code = code, 
+        .strings = strings,
+        .globals_count = globals_count,
+        .first_instr = first_instr,
+        .functions = functions
     };
 }
 
+void free_link(LinkResult *res) {
+    if (res->image) {
+        munmap(res->image, res->image_size);
+    } else {
+        da_free(res->code);
+        da_free(res->constants);
+        da_free(res->strings);
+        da_free(res->functions);
+    }
+    *res = (LinkResult) {0};
+}
+
 void _print_instr(Instruction instr) {
     switch (instr) {
     case iPush_Const:    printf("iPush_Const");      break;
@@ -225,6 +581,9 @@ void _print_instr(Instruction instr) {
 
     case iJmp:           printf("iJmp");           break;
     case iJmpZ:          printf("iJmpZ");          break;
+    case iJmpNZ:         printf("iJmpNZ");         break;
+
+    case iWide:          printf("iWide");          break;
 
     default:
         printf("UNKNOWN_INSTRUCTION");
@@ -236,14 +595,20 @@ void print_link(LinkResult res) {
     printf("== After linking ==\n");
     printf("== Start: %04zu ==\n", res.first_instr);
 
-    for (usize i = 0; i < res.instructions.count; ++i) {
-        Instruction instr = res.instructions.items[i];
-        printf("%04zu ", i);
+    for (usize ip = 0; ip < res.code.count;) {
+        printf("%04zu ", ip);
+        Instruction instr = res.code.items[ip++];
         _print_instr(instr);
 
-        if (instr == iCall || has_arg(instr) || is_jmp(instr)) {
-            usize arg = res.instructions.items[++i];
-            printf(" %zu", arg);
+        if (instr == iWide) {
+            instr = res.code.items[ip++];
+            printf(" ");
+            _print_instr(instr);
+            printf(" %zu", decode_wide_address(res.code.items, &ip));
+        } else if (has_address(instr)) {
+            printf(" %zu", decode_address(res.code.items, &ip));
+        } else if (has_arg(instr)) {
+            printf(" %zu", decode_index(res.code.items, &ip));
         }
         printf("\n");
     }
@@ -4,15 +4,53 @@
 #include "instructions.h"
 #include "value.h"
 #include "converter.h"
+#include "profile.h"
 
 typedef struct {
-    InstructionSet instructions;
+    byte *items;
+    usize count;
+    usize capacity;
+} ByteArray;
+
+// Start of every function in the linked code, by function index
+typedef struct {
+    StrRef name;
+    usize address;
+} FunctionEntry;
+
+typedef struct {
+    FunctionEntry *items;
+    usize count;
+    usize capacity;
+} FunctionEntries;
+
+// Nothing in a linked program holds a pointer, strings and names are
+// offsets into 'strings'. A program loaded from a bytecode file
+// points all arrays into the mapped 'image' instead of owning them.
+typedef struct {
+    CodeArray code;
     ValueArray constants;
+    ByteArray strings;
+    usize globals_count;
     usize first_instr;
+    FunctionEntries functions;
+    void *image;
+    usize image_size;
     b32 error;
 } LinkResult;
 
-LinkResult link(ConversionResult);
+// Links modules into one program, calls to external functions are
+// resolved by name. The modules are consumed. The last one is the
+// program itself, the top-level code of the others runs before its
+// own. A NULL profile keeps the plain call order layout.
+LinkResult link(ConversionResult *objects, usize count, Profile *profile);
 void print_link(LinkResult res);
 
+void free_link(LinkResult *res);
+
+static inline
+s8 link_str(LinkResult *res, StrRef ref) {
+    return s8(res->strings.items + ref.offset, ref.len);
+}
+
 #endif
\ No newline at end of file
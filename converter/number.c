@@ -1,5 +1,6 @@
 #include "number.h"
 #include <stdio.h>
+#include <string.h>
 #include "types.h"
 
 static inline f64 _get_as_f64(Number n) {
@@ -60,12 +61,85 @@ Number num_div(Number n1, Number n2) {
                              : new_num_float(_get_as_f64(n1) / _get_as_f64(n2));
 }
 
-void print_num(Number n) {
-    if (_get_type(n) == NUM_INT) {
-        printf("%d", _get_i32(n));
+// Digits of 'v' backwards from 'end', returns where they start
+static
+byte *_format_u64(u64 v, byte *end) {
+    do {
+        *--end = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+    return end;
+}
+
+static
+usize _format_i32(i32 i, byte *out) {
+    byte buf[16];
+    byte *end = buf + sizeof(buf);
+    byte *start = _format_u64(i < 0 ? -(u32)i : (u32)i, end);
+    if (i < 0) *--start = '-';
+    memcpy(out, start, end - start);
+    return end - start;
+}
+
+// Same text as printf("%lf"). The six digits are rounded from the exact
+// binary fraction, ties to even like printf. Only integer parts over
+// 2^63, infinities and NaNs are left to snprintf.
+static
+usize _format_f64(f64 d, byte *out) {
+    u64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    i32 exp = (bits >> 52) & 0x7ff;
+    u64 mant = bits & ((1ull << 52) - 1);
+
+    // d = m * 2^e
+    u64 m = exp == 0 ? mant : mant | (1ull << 52);
+    i32 e = exp == 0 ? -1074 : exp - 1075;
+    if (exp == 0x7ff || e > 10) return snprintf(out, NUM_STR_MAX, "%lf", d);
+
+    u64 int_part, frac_digits = 0;
+    if (e >= 0) {
+        int_part = m << e;
     } else {
-        printf("%lf", _get_f64(n));
+        u32 k = -e;
+        int_part = k < 64 ? m >> k : 0;
+        u64 frac = k < 64 ? m & ((1ull << k) - 1) : m;
+
+        // Below 2^-74 the fraction rounds to 0 whatever it is
+        if (k < 74) {
+            unsigned __int128 scaled = (unsigned __int128)frac * 1000000;
+            unsigned __int128 rest = scaled & ((((unsigned __int128)1) << k) - 1);
+            unsigned __int128 half = ((unsigned __int128)1) << (k - 1);
+            frac_digits = scaled >> k;
+            if (rest > half || (rest == half && frac_digits % 2 == 1)) frac_digits++;
+            if (frac_digits == 1000000) {
+                frac_digits = 0;
+                int_part++;
+            }
+        }
+    }
+
+    byte buf[32];
+    byte *end = buf + sizeof(buf);
+    byte *start = end - 7;
+    start[0] = '.';
+    for (i32 i = 6; i > 0; --i) {
+        start[i] = '0' + frac_digits % 10;
+        frac_digits /= 10;
     }
+    start = _format_u64(int_part, start);
+    if (bits >> 63) *--start = '-';
+    memcpy(out, start, end - start);
+    return end - start;
+}
+
+usize format_num(Number n, byte *out) {
+    if (_get_type(n) == NUM_INT) return _format_i32(_get_i32(n), out);
+    return _format_f64(_get_f64(n), out);
+}
+
+void print_num(Number n) {
+    byte buf[NUM_STR_MAX];
+    fwrite(buf, 1, format_num(n, buf), stdout);
 }
 
 b32 num_eq(Number n1, Number n2) {
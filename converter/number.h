@@ -33,6 +33,12 @@ b32 num_gt(Number n1, Number n2);
 b32 num_lte(Number n1, Number n2);
 b32 num_gte(Number n1, Number n2);
 
+// Longest text format_num() writes, a double over 300 digits long
+#define NUM_STR_MAX 320
+
+// Writes the number as printf("%d") or printf("%lf") would, without
+// a '\0'. Returns the length.
+usize format_num(Number n, byte *out);
 void print_num(Number n);
 
 #endif
\ No newline at end of file
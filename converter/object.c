@@ -0,0 +1,373 @@
+#include "object.h"
+#include "da.h"
+#include "macros.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+static inline
+void _object_error(const byte *fmt, ...) {
+    fprintf(stderr, "Object error: ");
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+static
+u64 _fnv1a(u64 h, void *data, usize len) {
+    for (usize i = 0; i < len; ++i) {
+        h ^= ((u8 *)data)[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+u64 object_interface(ConversionResult *conv) {
+    u64 h = 14695981039346656037ull;
+    for (usize i = 0; i < conv->functions.count; ++i) {
+        FunctionSymbol *fn = &conv->functions.items[i];
+        if (fn->external) continue;
+
+        u64 len = fn->name.len;
+        h = _fnv1a(h, &len, sizeof(len));
+        h = _fnv1a(h, fn->name.s, fn->name.len);
+        h = _fnv1a(h, &fn->return_type, sizeof(fn->return_type));
+        h = _fnv1a(h, &fn->param_count, sizeof(fn->param_count));
+        h = _fnv1a(h, conv->param_types.items + fn->param_start, fn->param_count);
+    }
+    return h;
+}
+
+// Reported once, later strings are dropped
+static
+StrRef _add_string(ByteArray *strings, s8 str, b32 *error) {
+    if ((usize)str.len > STR_REF_MAX - strings->count) {
+        if (!*error) _object_error("strings take more than %zu bytes, the module is too large",
+                                   (usize)STR_REF_MAX);
+        *error = true;
+        return (StrRef) {0};
+    }
+    StrRef ref = { .offset = strings->count, .len = str.len };
+    if (str.len > 0) da_append_many(strings, str.s, (usize)str.len);
+    return ref;
+}
+
+typedef struct {
+    ObjectFunction *items;
+    usize count;
+    usize capacity;
+} ObjectFunctions;
+
+typedef struct {
+    StrRef *items;
+    usize count;
+    usize capacity;
+} StrRefs;
+
+typedef struct {
+    ObjectImport *items;
+    usize count;
+    usize capacity;
+} ObjectImports;
+
+b32 write_object(ConversionResult *conv, ModuleImports *imports, FILE *f) {
+    ByteArray strings = {0};
+    b32 too_large = false;
+    ObjectFunctions functions = {0};
+    InstructionSet code = {0};
+    for (usize i = 0; i < conv->functions.count; ++i) {
+        FunctionSymbol *fn = &conv->functions.items[i];
+        ObjectFunction entry = {
+            .name = _add_string(&strings, fn->name, &too_large),
+            .flags = fn->external ? OBJECT_EXTERNAL : 0,
+            .line = fn->line,
+            .return_type = fn->return_type,
+            .param_start = fn->param_start,
+            .param_count = fn->param_count,
+            .code_start = code.count,
+            .code_count = fn->instructions.count
+        };
+        if (fn->instructions.count > 0)
+            da_append_many(&code, fn->instructions.items, fn->instructions.count);
+        da_append(&functions, entry);
+    }
+
+    // Padding is zeroed, so a module always gives the same bytes
+    ValueArray constants = {0};
+    for (usize i = 0; i < conv->constants.count; ++i) {
+        Value val;
+        memset(&val, 0, sizeof(val));
+        val.type = conv->constants.items[i].type;
+        switch (val.type) {
+            case VAL_BOOL: val.bool = conv->constants.items[i].bool; break;
+            case VAL_NUM:  val.num = conv->constants.items[i].num;   break;
+            case VAL_STR:  val.ref = _add_string(&strings, conv->constants.items[i].str, &too_large); break;
+            default: UNREACHABLE();
+        }
+        da_append(&constants, val);
+    }
+
+    StrRefs globals = {0};
+    for (usize i = 0; i < conv->globals.count; ++i)
+        da_append(&globals, _add_string(&strings, conv->globals.items[i], &too_large));
+
+    ObjectImports object_imports = {0};
+    for (usize i = 0; i < imports->count; ++i) {
+        ObjectImport import = {
+            .path = _add_string(&strings, imports->items[i].path, &too_large),
+            .interface = imports->items[i].interface
+        };
+        _add_string(&strings, s8("\0"), &too_large);
+        da_append(&object_imports, import);
+    }
+
+    ByteArray out = {0};
+    ObjectHeader header = {
+        .magic = OBJECT_MAGIC,
+        .version = OBJECT_VERSION,
+        .value_size = sizeof(Value),
+        .header_size = sizeof(ObjectHeader)
+    };
+    da_append_many(&out, (byte *)&header, sizeof(header));
+    header.functions = put_section(&out, functions.items, functions.count, sizeof(ObjectFunction));
+    header.code = put_section(&out, code.items, code.count, sizeof(IrWord));
+    header.top_level = put_section(&out, conv->instructions.items, conv->instructions.count, sizeof(IrWord));
+    header.constants = put_section(&out, constants.items, constants.count, sizeof(Value));
+    header.param_types = put_section(&out, conv->param_types.items, conv->param_types.count, 1);
+    header.globals = put_section(&out, globals.items, globals.count, sizeof(StrRef));
+    header.imports = put_section(&out, object_imports.items, object_imports.count, sizeof(ObjectImport));
+    header.strings = put_section(&out, strings.items, strings.count, 1);
+    memcpy(out.items, &header, sizeof(header));
+
+    b32 result = !too_large && fwrite(out.items, 1, out.count, f) == out.count;
+    da_free(out);
+    da_free(object_imports);
+    da_free(globals);
+    da_free(constants);
+    da_free(code);
+    da_free(functions);
+    da_free(strings);
+    return result;
+}
+
+static
+byte *_read_file(byte *path, usize *size) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return NULL;
+
+    ByteArray data = {0};
+    byte buf[4096];
+    usize n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        da_append_many(&data, buf, n);
+
+    b32 ok = !ferror(f);
+    fclose(f);
+    if (!ok) {
+        da_free(data);
+        return NULL;
+    }
+    *size = data.count;
+    return data.items;
+}
+
+static
+b32 _check_header(ObjectHeader *header, usize size) {
+    return memcmp(header->magic, OBJECT_MAGIC, 4) == 0 &&
+           header->version == OBJECT_VERSION &&
+           header->value_size == sizeof(Value) &&
+           header->header_size == sizeof(ObjectHeader) &&
+           section_fits(header->functions, sizeof(ObjectFunction), size) &&
+           section_fits(header->code, sizeof(IrWord), size) &&
+           section_fits(header->top_level, sizeof(IrWord), size) &&
+           section_fits(header->constants, sizeof(Value), size) &&
+           section_fits(header->param_types, 1, size) &&
+           section_fits(header->globals, sizeof(StrRef), size) &&
+           section_fits(header->imports, sizeof(ObjectImport), size) &&
+           section_fits(header->strings, 1, size);
+}
+
+// Every offset and every operand is checked, a bad object is
+// compiled again instead of being misread
+typedef struct {
+    byte *data;
+    ObjectHeader *header;
+    b32 ok;
+} Reader;
+
+static
+s8 _string(Reader *r, StrRef ref) {
+    if ((u64)ref.offset + ref.len > r->header->strings.count) {
+        r->ok = false;
+        return (s8) {0};
+    }
+    return s8(r->data + r->header->strings.offset + ref.offset, ref.len);
+}
+
+static
+InstructionSet _words(Reader *r, BytecodeSection section, u64 start, u64 count) {
+    InstructionSet set = {0};
+    if (start > section.count || count > section.count - start) {
+        r->ok = false;
+        return set;
+    }
+    if (count > 0)
+        da_append_many(&set, (IrWord *)(r->data + section.offset) + start, count);
+    return set;
+}
+
+static
+void _read_object(Reader *r, ConversionResult *conv, ModuleImports *imports) {
+    ObjectHeader *header = r->header;
+
+    ObjectFunction *functions = (ObjectFunction *)(r->data + header->functions.offset);
+    for (usize i = 0; r->ok && i < header->functions.count; ++i) {
+        ObjectFunction *entry = &functions[i];
+        if ((u64)entry->param_start + entry->param_count > header->param_types.count) r->ok = false;
+
+        s8 name = _string(r, entry->name);
+        FunctionSymbol fn = {
+            .name = name,
+            .sym = name.len == 4 && memcmp(name.s, "main", 4) == 0 ? SYM_MAIN : NO_SYMBOL,
+            .line = entry->line,
+            .instructions = _words(r, header->code, entry->code_start, entry->code_count),
+            .external = (entry->flags & OBJECT_EXTERNAL) != 0,
+            .return_type = entry->return_type,
+            .param_start = entry->param_start,
+            .param_count = entry->param_count
+        };
+        da_append(&conv->functions, fn);
+    }
+
+    conv->instructions = _words(r, header->top_level, 0, header->top_level.count);
+
+    Value *constants = (Value *)(r->data + header->constants.offset);
+    for (usize i = 0; r->ok && i < header->constants.count; ++i) {
+        Value val = constants[i];
+        if (val.type == VAL_STR) val.str = _string(r, val.ref);
+        da_append(&conv->constants, val);
+    }
+
+    if (header->param_types.count > 0)
+        da_append_many(&conv->param_types, r->data + header->param_types.offset, header->param_types.count);
+
+    StrRef *globals = (StrRef *)(r->data + header->globals.offset);
+    for (usize i = 0; r->ok && i < header->globals.count; ++i)
+        da_append(&conv->globals, _string(r, globals[i]));
+
+    ObjectImport *object_imports = (ObjectImport *)(r->data + header->imports.offset);
+    for (usize i = 0; r->ok && i < header->imports.count; ++i) {
+        StrRef path = object_imports[i].path;
+        path.len++; // the '\0' has to be there too
+        s8 str = _string(r, path);
+        if (!r->ok || str.s[str.len - 1] != '\0') {
+            r->ok = false;
+            break;
+        }
+        ModuleImport import = { .path = s8(str.s, str.len - 1), .interface = object_imports[i].interface };
+        da_append(imports, import);
+    }
+}
+
+// The linker relocates IR as it is, see _relocate_code() and
+// _relocate_function(). Jumps stay within their function, top-level
+// code has none and ends with iHalt. Locals are checked by the VM.
+static
+b32 _check_words(ConversionResult *conv, InstructionSet *set, b32 top_level) {
+    if (set->count == 0) return !top_level;
+
+    u8 *starts = calloc(set->count, 1);
+    if (starts == NULL) {
+        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+        exit(-1);
+    }
+
+    Instruction last = iHalt;
+    b32 ok = true;
+    for (usize i = 0; ok && i < set->count; i += ir_width(last)) {
+        starts[i] = true;
+        last = set->items[i];
+        if (last >= iWide || (ir_width(last) == 2 && i + 1 >= set->count)) {
+            ok = false;
+            break;
+        }
+
+        IrWord arg = ir_width(last) == 2 ? set->items[i + 1] : 0;
+        switch (last) {
+            case iPush_Const:   ok = arg < conv->constants.count; break;
+            case iLoad_Global:
+            case iStore_Global: ok = arg < conv->globals.count;   break;
+            case iCall:         ok = arg < conv->functions.count; break;
+            case iJmpZ:
+            case iJmpNZ:
+            case iJmp:          ok = !top_level;                  break;
+            default: break;
+        }
+    }
+
+    // A function falling through would run into the next one
+    if (top_level) ok = ok && last == iHalt;
+    else           ok = ok && (last == iRestore || last == iJmp);
+
+    for (usize i = 0; ok && i < set->count; i += ir_width(set->items[i])) {
+        if (is_jmp(set->items[i]))
+            ok = set->items[i + 1] < set->count && starts[set->items[i + 1]];
+    }
+
+    free(starts);
+    return ok;
+}
+
+static
+b32 _check_object(ConversionResult *conv) {
+    for (usize i = 0; i < conv->constants.count; ++i) {
+        Value *val = &conv->constants.items[i];
+        if (val->type == VAL_NUM && val->num.num_type != NUM_INT && val->num.num_type != NUM_FLOAT) return false;
+        if (val->type != VAL_BOOL && val->type != VAL_NUM && val->type != VAL_STR) return false;
+    }
+
+    for (usize i = 0; i < conv->functions.count; ++i) {
+        FunctionSymbol *fn = &conv->functions.items[i];
+        if (fn->external ? fn->instructions.count > 0 : !_check_words(conv, &fn->instructions, false))
+            return false;
+    }
+    return _check_words(conv, &conv->instructions, true);
+}
+
+void free_object(ConversionResult *conv, ModuleImports *imports) {
+    for (usize i = 0; i < conv->functions.count; ++i)
+        da_free(conv->functions.items[i].instructions);
+    da_free(conv->functions);
+    da_free(conv->instructions);
+    da_free(conv->constants);
+    da_free(conv->param_types);
+    da_free(conv->globals);
+    da_free(*imports);
+    *conv = (ConversionResult) {0};
+    *imports = (ModuleImports) {0};
+}
+
+b32 load_object(byte *path, ConversionResult *conv, ModuleImports *imports, byte **text) {
+    *conv = (ConversionResult) {0};
+    *imports = (ModuleImports) {0};
+
+    usize size;
+    byte *data = _read_file(path, &size);
+    if (data == NULL) return false;
+
+    Reader r = { .data = data, .header = (ObjectHeader *)data, .ok = true };
+    r.ok = size >= sizeof(ObjectHeader) && _check_header(r.header, size);
+    if (r.ok) _read_object(&r, conv, imports);
+    if (r.ok) r.ok = _check_object(conv);
+
+    if (!r.ok) {
+        free_object(conv, imports);
+        free(data);
+        return false;
+    }
+
+    *text = data;
+    return true;
+}
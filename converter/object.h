@@ -0,0 +1,86 @@
+#ifndef OBJECT_INCLUDE
+#define OBJECT_INCLUDE
+
+#include "bytecode.h"
+
+// A module compiled on its own, before linking. It is kept so an
+// unchanged module is never compiled again:
+//
+//   header       ObjectHeader
+//   functions    ObjectFunction[function_count]
+//   code         IrWord[], the bodies one after another
+//   top_level    IrWord[]
+//   constants    Value[], strings as offsets into 'strings'
+//   param_types  u8[], see FunctionSymbol
+//   globals      StrRef[], names of the globals
+//   imports      ObjectImport[]
+//   strings      bytes, import paths are '\0'-terminated
+//
+// Sections are laid out like the ones of a bytecode file.
+#define OBJECT_MAGIC "PLOB"
+#define OBJECT_VERSION 1
+
+enum {
+    OBJECT_EXTERNAL = 1,
+};
+
+typedef struct {
+    StrRef name;
+    u32 flags;
+    u32 line;
+    u32 return_type;
+    u32 param_start;
+    u32 param_count;
+    u64 code_start; // in words
+    u64 code_count;
+} ObjectFunction;
+
+typedef struct {
+    StrRef path;
+    u64 interface;
+} ObjectImport;
+
+typedef struct {
+    byte magic[4];
+    u32 version;
+    u16 value_size;
+    u16 header_size;
+    BytecodeSection functions;
+    BytecodeSection code;
+    BytecodeSection top_level;
+    BytecodeSection constants;
+    BytecodeSection param_types;
+    BytecodeSection globals;
+    BytecodeSection imports;
+    BytecodeSection strings;
+} ObjectHeader;
+
+// A module the object was checked against. Importers only depend on
+// the functions a module defines, 'interface' hashes their names and
+// types, see object_interface().
+typedef struct {
+    s8 path;
+    u64 interface;
+} ModuleImport;
+
+typedef struct {
+    ModuleImport *items;
+    usize count;
+    usize capacity;
+} ModuleImports;
+
+u64 object_interface(ConversionResult *conv);
+
+// Leaves 'f' open. Only reports a module whose strings do not fit
+// the format.
+b32 write_object(ConversionResult *conv, ModuleImports *imports, FILE *f);
+
+// Names and strings of the loaded module point into '*text', which
+// is freed once the module is linked. Objects only come from the
+// compile cache, so a bad one is not reported, it is just a miss.
+b32 load_object(byte *path, ConversionResult *conv, ModuleImports *imports, byte **text);
+
+// For modules that are not linked after all, the linker frees the others
+void free_object(ConversionResult *conv, ModuleImports *imports);
+
+#endif
@@ -0,0 +1,283 @@
+#include "optimizer.h"
+#include "da.h"
+#include "macros.h"
+#include <stdlib.h>
+
+// Each function body is split into basic blocks. A block is a run of
+// straight-line instructions followed by at most one jump. Jumps are
+// kept symbolic (block indices) until the blocks are laid out again.
+typedef enum {
+    TERM_FALL,  // runs into the next block
+    TERM_JMP,   // iJmp target
+    TERM_JMPZ,  // iJmpZ target, otherwise runs into next
+    TERM_EXIT   // ends with iRestore or iHalt
+} TermKind;
+
+typedef struct {
+    usize start;    // first instruction in the original stream
+    usize end;      // one past the last instruction that is copied as is
+    TermKind term;
+    usize target;   // jump target block
+    usize next;     // fall-through block
+    b32 reachable;
+    usize address;  // start address after layout
+} Block;
+
+typedef struct {
+    Block *items;
+    usize count;
+    usize capacity;
+} BlockArray;
+
+typedef struct {
+    usize *items;
+    usize count;
+    usize capacity;
+} UsizeArray;
+
+#define NO_BLOCK ((usize)-1)
+
+static inline
+b32 _is_exit(Instruction instr) {
+    return instr == iRestore || instr == iHalt;
+}
+
+static
+BlockArray _split_blocks(InstructionSet *set) {
+    b32 *leader = calloc(set->count + 1, sizeof(*leader));
+    usize *block_of = calloc(set->count + 1, sizeof(*block_of));
+    if (!leader || !block_of) UNREACHABLE();
+
+    leader[0] = true;
+    for (usize i = 0; i < set->count; i += ir_width(set->items[i])) {
+        Instruction instr = set->items[i];
+        if (is_jmp(instr)) {
+            leader[set->items[i + 1]] = true;
+            leader[i + 2] = true;
+        } else if (_is_exit(instr)) {
+            leader[i + 1] = true;
+        }
+    }
+
+    BlockArray blocks = {0};
+    for (usize i = 0; i < set->count;) {
+        Block b = {.start = i, .target = NO_BLOCK};
+        block_of[i] = blocks.count;
+
+        usize j = i;
+        for (;;) {
+            Instruction instr = set->items[j];
+            if (instr == iJmp || instr == iJmpZ) {
+                b.end = j;
+                b.term = instr == iJmp ? TERM_JMP : TERM_JMPZ;
+                b.target = set->items[j + 1];
+                j += 2;
+                break;
+            }
+            // iJmpNZ is only produced by this pass
+            if (instr == iJmpNZ) UNREACHABLE();
+
+            j += ir_width(instr);
+            if (_is_exit(instr)) {
+                b.end = j;
+                b.term = TERM_EXIT;
+                break;
+            }
+            if (j >= set->count || leader[j]) {
+                b.end = j;
+                b.term = TERM_FALL;
+                break;
+            }
+        }
+
+        b.next = j < set->count ? blocks.count + 1 : NO_BLOCK;
+        da_append(&blocks, b);
+        i = j;
+    }
+
+    // Jump targets were instruction indices until now
+    for (usize i = 0; i < blocks.count; ++i) {
+        Block *b = &blocks.items[i];
+        if (b->target != NO_BLOCK) b->target = block_of[b->target];
+    }
+
+    free(leader);
+    free(block_of);
+    return blocks;
+}
+
+// Follows blocks that consist of a lone iJmp. Bounded, so a jump cycle
+// can not hang the compiler.
+static
+usize _thread(BlockArray *blocks, usize b) {
+    for (usize hops = 0; hops < blocks->count && b != NO_BLOCK; ++hops) {
+        Block *t = &blocks->items[b];
+        if (t->start != t->end || t->term != TERM_JMP) break;
+        b = t->target;
+    }
+    return b;
+}
+
+static
+void _thread_jumps(BlockArray *blocks) {
+    for (usize i = 0; i < blocks->count; ++i) {
+        Block *b = &blocks->items[i];
+        if (b->term == TERM_JMP || b->term == TERM_JMPZ)
+            b->target = _thread(blocks, b->target);
+        if (b->term == TERM_FALL || b->term == TERM_JMPZ)
+            b->next = _thread(blocks, b->next);
+    }
+}
+
+static
+void _mark_reachable(BlockArray *blocks) {
+    UsizeArray work = {0};
+    da_append(&work, 0);
+
+    while (work.count > 0) {
+        usize idx = work.items[--work.count];
+        Block *b = &blocks->items[idx];
+        if (b->reachable) continue;
+        b->reachable = true;
+
+        if (b->term == TERM_FALL || b->term == TERM_JMPZ)
+            da_append(&work, b->next);
+        if (b->term == TERM_JMP || b->term == TERM_JMPZ)
+            da_append(&work, b->target);
+    }
+
+    da_free(work);
+}
+
+static
+usize _position(UsizeArray *order, usize b) {
+    for (usize i = 0; i < order->count; ++i) {
+        if (order->items[i] == b) return i;
+    }
+    UNREACHABLE();
+}
+
+// Loops are lowered as 'head: cond; iJmpZ exit; body; iJmp head; exit:',
+// which takes a branch on every iteration just to get back to the
+// condition. Moving the head after the body lets the body fall into the
+// condition, and the condition jumps back only while the loop runs.
+static
+UsizeArray _layout(BlockArray *blocks) {
+    UsizeArray order = {0};
+    for (usize i = 0; i < blocks->count; ++i) {
+        if (blocks->items[i].reachable) da_append(&order, i);
+    }
+
+    for (usize i = 0; i < blocks->count; ++i) {
+        Block *latch = &blocks->items[i];
+        if (!latch->reachable || latch->term != TERM_JMP) continue;
+
+        usize head_idx = latch->target;
+        Block *head = &blocks->items[head_idx];
+        if (head_idx > i || head->term != TERM_JMPZ || head->target <= i)
+            continue;
+
+        usize from = _position(&order, head_idx);
+        usize to = _position(&order, i);
+        if (from > to) continue;
+        memmove(&order.items[from], &order.items[from + 1],
+                (to - from) * sizeof(*order.items));
+        order.items[to] = head_idx;
+    }
+
+    return order;
+}
+
+static inline
+b32 _is_return_stub(InstructionSet *src, Block *b) {
+    return b->term == TERM_EXIT && b->end - b->start == 1 &&
+           src->items[b->start] == iRestore;
+}
+
+static
+void _emit_jmp(InstructionSet *out, InstructionSet *src, BlockArray *blocks, usize target) {
+    Block *t = &blocks->items[target];
+    // Jumping to a lone iRestore is the same as returning right here
+    if (_is_return_stub(src, t)) {
+        da_append(out, iRestore);
+        return;
+    }
+    da_append(out, iJmp);
+    da_append(out, t->address);
+}
+
+static
+void _emit(InstructionSet *out, InstructionSet *src, BlockArray *blocks, UsizeArray *order) {
+    out->count = 0;
+    // A rotated loop may have moved the entry block away from the start
+    if (order->items[0] != 0)
+        _emit_jmp(out, src, blocks, 0);
+
+    for (usize k = 0; k < order->count; ++k) {
+        usize idx = order->items[k];
+        usize next = k + 1 < order->count ? order->items[k + 1] : NO_BLOCK;
+        Block *b = &blocks->items[idx];
+
+        b->address = out->count;
+        if (b->end > b->start)
+            da_append_many(out, src->items + b->start, b->end - b->start);
+
+        switch (b->term) {
+            case TERM_FALL:
+                if (b->next != next) _emit_jmp(out, src, blocks, b->next);
+                break;
+
+            case TERM_JMP:
+                if (b->target != next) _emit_jmp(out, src, blocks, b->target);
+                break;
+
+            case TERM_JMPZ:
+                if (b->next == next) {
+                    da_append(out, iJmpZ);
+                    da_append(out, blocks->items[b->target].address);
+                } else if (b->target == next) {
+                    da_append(out, iJmpNZ);
+                    da_append(out, blocks->items[b->next].address);
+                } else {
+                    da_append(out, iJmpZ);
+                    da_append(out, blocks->items[b->target].address);
+                    _emit_jmp(out, src, blocks, b->next);
+                }
+                break;
+
+            case TERM_EXIT:
+                break;
+
+            default: UNREACHABLE();
+        }
+    }
+}
+
+static
+void _optimize_function(FunctionSymbol *fn) {
+    InstructionSet *src = &fn->instructions;
+    if (src->count == 0) return;
+
+    BlockArray blocks = _split_blocks(src);
+    _thread_jumps(&blocks);
+    _mark_reachable(&blocks);
+    UsizeArray order = _layout(&blocks);
+
+    // The first pass only assigns block addresses, the second one
+    // emits jumps to them. Both make identical size decisions.
+    InstructionSet out = {0};
+    _emit(&out, src, &blocks, &order);
+    _emit(&out, src, &blocks, &order);
+
+    da_free(*src);
+    *src = out;
+
+    da_free(order);
+    da_free(blocks);
+}
+
+void optimize_jumps(ConversionResult *conv) {
+    for (usize i = 0; i < conv->functions.count; ++i) {
+        _optimize_function(&conv->functions.items[i]);
+    }
+}
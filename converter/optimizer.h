@@ -0,0 +1,8 @@
+#ifndef OPTIMIZER_INCLUDE
+#define OPTIMIZER_INCLUDE
+
+#include "converter.h"
+
+void optimize_jumps(ConversionResult *conv);
+
+#endif
@@ -0,0 +1,101 @@
+#include "profile.h"
+#include "da.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+static inline
+void _profile_error(const byte *fmt, ...) {
+    fprintf(stderr, "Profile error: ");
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+static
+i32 _s8_cmp(s8 a, s8 b) {
+    isize len = a.len < b.len ? a.len : b.len;
+    i32 cmp = len > 0 ? memcmp(a.s, b.s, len) : 0;
+    if (cmp != 0) return cmp;
+    return (a.len > b.len) - (a.len < b.len);
+}
+
+static
+i32 _entry_cmp(const void *a, const void *b) {
+    return _s8_cmp(((ProfileEntry *)a)->name, ((ProfileEntry *)b)->name);
+}
+
+static
+byte *_read_file(byte *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return NULL;
+
+    struct {
+        byte *items;
+        usize count;
+        usize capacity;
+    } text = {0};
+    byte buf[4096];
+    usize n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        da_append_many(&text, buf, n);
+    da_append(&text, '\0');
+
+    b32 ok = !ferror(f);
+    fclose(f);
+    if (!ok) {
+        da_free(text);
+        return NULL;
+    }
+    return text.items;
+}
+
+b32 load_profile(byte *path, Profile *profile) {
+    *profile = (Profile) {0};
+    profile->text = _read_file(path);
+    if (profile->text == NULL) {
+        _profile_error("could not read \"%s\"", path);
+        return false;
+    }
+
+    byte *at = profile->text;
+    for (usize line = 1; *at != '\0'; ++line) {
+        byte *end = strchr(at, '\n');
+        if (end == NULL) end = at + strlen(at);
+
+        byte *name;
+        u64 calls = strtoull(at, &name, 10);
+        if (name == at || *name != ' ' || name + 1 >= end) {
+            _profile_error("\"%s\" line %zu: expected \"<calls> <name>\"", path, line);
+            free_profile(profile);
+            return false;
+        }
+
+        name++;
+        da_append(profile, ((ProfileEntry) { .name = s8(name, end - name), .calls = calls }));
+        at = *end == '\n' ? end + 1 : end;
+    }
+
+    qsort(profile->items, profile->count, sizeof(ProfileEntry), _entry_cmp);
+    return true;
+}
+
+void free_profile(Profile *profile) {
+    da_free(*profile);
+    free(profile->text);
+    *profile = (Profile) {0};
+}
+
+u64 profile_calls(Profile *profile, s8 name) {
+    usize lo = 0, hi = profile->count;
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        i32 cmp = _s8_cmp(profile->items[mid].name, name);
+        if (cmp == 0) return profile->items[mid].calls;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return 0;
+}
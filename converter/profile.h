@@ -0,0 +1,31 @@
+#ifndef PROFILE_INCLUDE
+#define PROFILE_INCLUDE
+
+#include "types.h"
+#include "s8.h"
+
+// Calls per function from a profiling run, see save_profile() in vm.h.
+// On disk it is text, one "<calls> <name>" line per function. Names
+// rather than indices are stored, so a profile still applies after
+// the source was edited.
+typedef struct {
+    s8 name;
+    u64 calls;
+} ProfileEntry;
+
+// Sorted by name, the names point into 'text'
+typedef struct {
+    ProfileEntry *items;
+    usize count;
+    usize capacity;
+    byte *text;
+} Profile;
+
+// Reports errors on stderr and returns false on failure
+b32 load_profile(byte *path, Profile *profile);
+void free_profile(Profile *profile);
+
+// 0 for functions the profile does not know
+u64 profile_calls(Profile *profile, s8 name);
+
+#endif
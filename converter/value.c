@@ -17,32 +17,10 @@ Value new_val_num(Number val) {
     };
 }
 
+// Points into the source, the linker copies the bytes out
 Value new_val_str(s8 val) {
-    void *str = malloc(val.len);
-    if (!str) UNREACHABLE();
-
-    memcpy(str, val.s, val.len);
     return (Value) {
         .type = VAL_STR,
-        .str = s8(str, val.len)
+        .str = val
     };
 }
-
-void print_val(Value val) {
-    switch (val.type) {
-        case VAL_BOOL: {
-            printf("%s", bool_str(val.bool));
-            break;
-        }
-        case VAL_NUM: {
-            print_num(val.num);
-            break;
-        }
-        case VAL_STR: {
-            printf("%.*s", (i32)val.str.len, val.str.s);
-            break;
-        }
-        default: UNREACHABLE();
-    }
-    printf("\n");
-}
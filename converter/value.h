@@ -11,12 +11,22 @@ typedef enum {
     VAL_STR
 } ValueType;
 
+// Strings of a linked program live in one block next to the code.
+// Constants refer to them by offset, so the program does not depend
+// on the address it is loaded at.
+typedef struct {
+    u32 offset;
+    u32 len;
+} StrRef;
+#define STR_REF_MAX UINT32_MAX
+
 typedef struct {
     ValueType type;
     union {
         b32 bool;
         Number num;
-        s8 str;
+        s8 str;     // until the program is linked
+        StrRef ref; // once it is
     };
 } Value;
 
@@ -30,6 +40,4 @@ Value new_val_bool(b32 val);
 Value new_val_num(Number val);
 Value new_val_str(s8 val);
 
-void print_val(Value val);
-
 #endif
\ No newline at end of file
@@ -4,24 +4,61 @@
 #include "da.h"
 #include "macros.h"
 #include <stdio.h>
+#include <string.h>
 
-typedef struct {
-    usize *items;
-    usize count;
-    usize capacity;
-} UsizeStack;
-
-typedef struct {
-    usize base_pointer;
-    usize instr_pointer;
-    ValueArray stack;
-    ValueArray constants;
-    ValueArray globals;
-    ValueArray locals;
-    UsizeStack return_stack;
-    UsizeStack base_stack;
-    UsizeStack top_stack;
-} Vm;
+#define VM_OUT_SIZE (64 * 1024)
+
+static
+void _flush(Vm *vm) {
+    if (vm->out.count == 0) return;
+    fwrite(vm->out.items, 1, vm->out.count, stdout);
+    fflush(stdout);
+    vm->out.count = 0;
+}
+
+// Whatever the program printed before is still written out
+#define VM_UNREACHABLE(vm)  \
+        do {                \
+            _flush(vm);     \
+            UNREACHABLE();  \
+        } while (0)
+
+static
+void _out(Vm *vm, byte *data, usize len) {
+    if (vm->out.count + len > VM_OUT_SIZE) {
+        _flush(vm);
+        // Not worth copying
+        if (len > VM_OUT_SIZE) {
+            fwrite(data, 1, len, stdout);
+            return;
+        }
+    }
+    memcpy(vm->out.items + vm->out.count, data, len);
+    vm->out.count += len;
+}
+
+static
+void _print(Vm *vm, Value val) {
+    byte num[NUM_STR_MAX];
+    switch (val.type) {
+        case VAL_BOOL: {
+            byte *str = bool_str(val.bool);
+            _out(vm, str, strlen(str));
+            break;
+        }
+        case VAL_NUM: {
+            _out(vm, num, format_num(val.num, num));
+            break;
+        }
+        case VAL_STR: {
+            _out(vm, vm->strings + val.ref.offset, val.ref.len);
+            break;
+        }
+        default: VM_UNREACHABLE(vm);
+    }
+    _out(vm, "\n", 1);
+    if (vm->unbuffered) _flush(vm);
+}
 
 static inline
 void pushv(ValueArray *a, Value val) {
@@ -29,11 +66,11 @@ void pushv(ValueArray *a, Value val) {
 }
 
 static inline
-Value popv(ValueArray *a) {
+Value popv(Vm *vm, ValueArray *a) {
     if (a->count > 0) {
         return a->items[--a->count];
     }
-    UNREACHABLE();
+    VM_UNREACHABLE(vm);
 }
 
 static inline
@@ -47,250 +84,362 @@ void pushu(UsizeStack *a, usize val) {
 }
 
 static inline
-usize popu(UsizeStack *a) {
+usize popu(Vm *vm, UsizeStack *a) {
     if (a->count > 0) {
         return a->items[--a->count];
     }
-    UNREACHABLE();
+    VM_UNREACHABLE(vm);
+}
+
+// Calls always land on the start of a function
+static
+void _count_call(Vm *vm, usize addr) {
+    usize lo = 0, hi = vm->calls.count;
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        if (vm->calls.items[mid].address == addr) {
+            vm->calls.items[mid].calls++;
+            return;
+        }
+        if (vm->calls.items[mid].address < addr) lo = mid + 1;
+        else hi = mid;
+    }
+}
+
+static inline
+void _call(Vm *vm, usize addr) {
+    if (vm->profile) _count_call(vm, addr);
+    pushu(&vm->base_stack, vm->base_pointer);
+    vm->base_pointer = vm->locals.count;
+
+    if (vm->top_stack.count == 0) {
+        VM_UNREACHABLE(vm);
+    }
+
+    usize prev_stack_count = vm->top_stack.items[vm->top_stack.count - 1];
+    if (vm->stack.count < prev_stack_count) {
+        // stack underflow relative to saved top
+        VM_UNREACHABLE(vm);
+    }
+
+    usize num_args = vm->stack.count - prev_stack_count;
+    for (usize i = 0; i < num_args; ++i) {
+        usize src = prev_stack_count + i;
+        pushv(&vm->locals, vm->stack.items[src]);
+    }
+
+    // reset stack to the pre-argument-passing size
+    vm->stack.count = prev_stack_count;
+
+    pushu(&vm->return_stack, vm->instr_pointer);
+    vm->instr_pointer = addr;
+}
+
+static inline
+void _jmp_z(Vm *vm, usize addr) {
+    if (vm->stack.count == 0) return;
+
+    Value val = popv(vm, &vm->stack);
+    if (val.type != VAL_BOOL) return;
+
+    if (!val.bool) {
+        vm->instr_pointer = addr;
+    }
 }
 
+// Exact negation of _jmp_z, so the two can be swapped
+// freely when blocks are reordered
 static inline
-Instruction get_instr(InstructionSet i, usize idx) {
-    return i.items[idx];
+void _jmp_nz(Vm *vm, usize addr) {
+    if (vm->stack.count == 0) {
+        vm->instr_pointer = addr;
+        return;
+    }
+
+    Value val = popv(vm, &vm->stack);
+    if (val.type != VAL_BOOL || val.bool) {
+        vm->instr_pointer = addr;
+    }
+}
+
+static
+i32 _call_count_cmp(const void *a, const void *b) {
+    usize x = ((CallCount *)a)->address;
+    usize y = ((CallCount *)b)->address;
+    return (x > y) - (x < y);
+}
+
+static
+void _reset_calls(Vm *vm, LinkResult *program) {
+    vm->calls.count = 0;
+    for (usize i = 0; i < program->functions.count; ++i) {
+        CallCount count = { .address = program->functions.items[i].address, .fn_idx = i };
+        da_append(&vm->calls, count);
+    }
+    qsort(vm->calls.items, vm->calls.count, sizeof(CallCount), _call_count_cmp);
+}
+
+static
+void _reset(Vm *vm, LinkResult *program) {
+    vm->base_pointer = 0;
+    vm->instr_pointer = program->first_instr;
+    vm->constants = program->constants;
+    vm->strings = program->strings.items;
+
+    vm->stack.count = 0;
+    vm->globals.count = 0;
+    vm->locals.count = 0;
+    vm->return_stack.count = 0;
+    vm->base_stack.count = 0;
+    vm->top_stack.count = 0;
+
+    da_reserve(&vm->globals, program->globals_count);
+    da_reserve(&vm->locals, 256);
+    da_reserve(&vm->out, VM_OUT_SIZE);
+    if (vm->profile) _reset_calls(vm, program);
 }
 
-b32 run(LinkResult res) {
-    Vm vm = { 
-        .instr_pointer = res.first_instr,
-        .constants = res.constants
-    };
+void free_vm(Vm *vm) {
+    da_free(vm->stack);
+    da_free(vm->globals);
+    da_free(vm->locals);
+    da_free(vm->return_stack);
+    da_free(vm->base_stack);
+    da_free(vm->top_stack);
+    da_free(vm->calls);
+    da_free(vm->out);
+    *vm = (Vm) {0};
+}
 
-    da_reserve(&vm.globals, 256);
-    da_reserve(&vm.locals, 256);
+b32 save_profile(Vm *vm, LinkResult *program, byte *path) {
+    FILE *f = fopen(path, "w");
+    b32 written = f != NULL;
+    for (usize i = 0; written && i < vm->calls.count; ++i) {
+        CallCount *count = &vm->calls.items[i];
+        s8 name = link_str(program, program->functions.items[count->fn_idx].name);
+        written = fprintf(f, "%llu %.*s\n",
+            (unsigned long long)count->calls, (i32)name.len, name.s) > 0;
+    }
+    if (f != NULL && fclose(f) != 0) written = false;
+    if (!written) fprintf(stderr, "Profile error: could not write \"%s\"\n", path);
+    return written;
+}
 
-    InstructionSet instructions = res.instructions;
+b32 run(Vm *vm, LinkResult *program) {
+    _reset(vm, program);
+    u8 *code = program->code.items;
 
     while (true) {
-        // printf("Instr_ptr: %zu\n", vm.instr_pointer);
-        Instruction instr = get_instr(instructions, vm.instr_pointer++);
+        // printf("Instr_ptr: %zu\n", vm->instr_pointer);
+        Instruction instr = code[vm->instr_pointer++];
 
         switch (instr) {
 
             case iHalt:
+                _flush(vm);
                 return true;
 
             case iPush_Const: {
-                usize idx = get_instr(instructions, vm.instr_pointer++);
-                pushv(&vm.stack, vm.constants.items[idx]);
+                usize idx = decode_index(code, &vm->instr_pointer);
+                pushv(&vm->stack, vm->constants.items[idx]);
                 break;
             }
 
             case iPop: {
-                popv(&vm.stack);
+                popv(vm, &vm->stack);
                 break;
             }
 
             case iStore_Global: {
-                usize idx = get_instr(instructions, vm.instr_pointer++);
-                vm.globals.items[idx] = popv(&vm.stack);
+                usize idx = decode_index(code, &vm->instr_pointer);
+                vm->globals.items[idx] = popv(vm, &vm->stack);
                 break;
             }
 
             case iLoad_Global: {
-                usize idx = get_instr(instructions, vm.instr_pointer++);
-                pushv(&vm.stack, vm.globals.items[idx]);
+                usize idx = decode_index(code, &vm->instr_pointer);
+                pushv(&vm->stack, vm->globals.items[idx]);
                 break;
             }
 
             case iStore_Local: {
-                usize idx = get_instr(instructions, vm.instr_pointer++);
-                if (idx >= vm.locals.count) {
-                    pushv(&vm.locals, popv(&vm.stack));
+                usize idx = decode_index(code, &vm->instr_pointer);
+                // Slots are handed out in order, a new local always
+                // takes the one right after the frame's last
+                usize slot = vm->base_pointer + idx;
+                if (slot >= vm->locals.count) {
+                    pushv(&vm->locals, popv(vm, &vm->stack));
                 } else {
-                    storev(&vm.locals, vm.base_pointer + idx, popv(&vm.stack));
+                    storev(&vm->locals, slot, popv(vm, &vm->stack));
                 }
                 break;
             }
 
             case iLoad_Local: {
-                usize idx = get_instr(instructions, vm.instr_pointer++);
-                pushv(&vm.stack, vm.locals.items[vm.base_pointer + idx]);
+                usize idx = decode_index(code, &vm->instr_pointer);
+                // The only operand a loaded file can not be checked for
+                if (vm->base_pointer + idx >= vm->locals.count) VM_UNREACHABLE(vm);
+                pushv(&vm->stack, vm->locals.items[vm->base_pointer + idx]);
                 break;
             }
 
             case iAdd: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_num(num_add(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_num(num_add(a.num, b.num)));
                 break;
             }
 
             case iSub: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_num(num_sub(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_num(num_sub(a.num, b.num)));
                 break;
             }
 
             case iMul: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_num(num_mul(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_num(num_mul(a.num, b.num)));
                 break;
             }
 
             case iDiv: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_num(num_div(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_num(num_div(a.num, b.num)));
                 break;
             }
 
             case iNeg: {
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_num(num_mul(a.num, new_num_int(-1))));
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_num(num_mul(a.num, new_num_int(-1))));
                 break;
             }
 
             case iAnd: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_bool(a.bool && b.bool));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_bool(a.bool && b.bool));
                 break;
             }
 
             case iOr: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_bool(a.bool || b.bool));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_bool(a.bool || b.bool));
                 break;
             }
 
             case iNot: {
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_bool(!a.bool));
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_bool(!a.bool));
                 break;
             }
 
             case iEq: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
                 if (a.type == VAL_NUM)
-                    pushv(&vm.stack, new_val_bool(num_eq(a.num, b.num)));
+                    pushv(&vm->stack, new_val_bool(num_eq(a.num, b.num)));
                 else
-                    pushv(&vm.stack, new_val_bool(a.bool == b.bool));
+                    pushv(&vm->stack, new_val_bool(a.bool == b.bool));
                 break;
             }
 
             case iNeq: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
                 if (a.type == VAL_NUM)
-                    pushv(&vm.stack, new_val_bool(!num_eq(a.num, b.num)));
+                    pushv(&vm->stack, new_val_bool(!num_eq(a.num, b.num)));
                 else
-                    pushv(&vm.stack, new_val_bool(a.bool != b.bool));
+                    pushv(&vm->stack, new_val_bool(a.bool != b.bool));
                 break;
             }
 
             case iLt: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_bool(num_lt(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_bool(num_lt(a.num, b.num)));
                 break;
             }
 
             case iLte: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_bool(num_lte(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_bool(num_lte(a.num, b.num)));
                 break;
             }
 
             case iGt: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_bool(num_gt(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_bool(num_gt(a.num, b.num)));
                 break;
             }
 
             case iGte: {
-                Value b = popv(&vm.stack);
-                Value a = popv(&vm.stack);
-                pushv(&vm.stack, new_val_bool(num_gte(a.num, b.num)));
+                Value b = popv(vm, &vm->stack);
+                Value a = popv(vm, &vm->stack);
+                pushv(&vm->stack, new_val_bool(num_gte(a.num, b.num)));
                 break;
             }
 
             case iSave: {
-                pushu(&vm.top_stack, vm.stack.count);
+                pushu(&vm->top_stack, vm->stack.count);
                 break;
             }
 
             case iRestore: {
-                if (vm.return_stack.count == 0)
-                    UNREACHABLE();
+                if (vm->return_stack.count == 0)
+                    VM_UNREACHABLE(vm);
 
-                vm.instr_pointer = vm.return_stack.items[--vm.return_stack.count];
-                vm.locals.count = vm.base_pointer;
-                vm.base_pointer = popu(&vm.base_stack);
+                vm->instr_pointer = vm->return_stack.items[--vm->return_stack.count];
+                vm->locals.count = vm->base_pointer;
+                vm->base_pointer = popu(vm, &vm->base_stack);
                 break;
             }
 
             case iCall: {
-                usize addr = get_instr(instructions, vm.instr_pointer++);
-                pushu(&vm.base_stack, vm.base_pointer);
-                vm.base_pointer = vm.locals.count;
-
-                if (vm.top_stack.count == 0) {
-                    UNREACHABLE();
-                }
-
-                usize prev_stack_count = vm.top_stack.items[vm.top_stack.count - 1];
-                if (vm.stack.count < prev_stack_count) {
-                    // stack underflow relative to saved top
-                    UNREACHABLE();
-                }
-
-                usize num_args = vm.stack.count - prev_stack_count;
-                for (usize i = 0; i < num_args; ++i) {
-                    usize src = prev_stack_count + i;
-                    pushv(&vm.locals, vm.stack.items[src]);
-                }
-
-                // reset stack to the pre-argument-passing size
-                vm.stack.count = prev_stack_count;
-
-                pushu(&vm.return_stack, vm.instr_pointer);
-                vm.instr_pointer = addr;
+                _call(vm, decode_address(code, &vm->instr_pointer));
                 break;
             }
 
 
             case iPrint: {
-                Value val = popv(&vm.stack);
-                print_val(val);
+                _print(vm, popv(vm, &vm->stack));
                 break;
             }
 
             case iJmpZ: {
-                usize addr = get_instr(instructions, vm.instr_pointer++);
-                if (vm.stack.count == 0) break;
-
-                Value val = popv(&vm.stack);
-                if (val.type != VAL_BOOL) break;
+                _jmp_z(vm, decode_address(code, &vm->instr_pointer));
+                break;
+            }
 
-                if (!val.bool) {
-                    vm.instr_pointer = addr;
-                }
+            case iJmpNZ: {
+                _jmp_nz(vm, decode_address(code, &vm->instr_pointer));
                 break;
             }
 
             case iJmp: {
-                usize addr = get_instr(instructions, vm.instr_pointer++);
-                vm.instr_pointer = addr;
+                vm->instr_pointer = decode_address(code, &vm->instr_pointer);
+                break;
+            }
+
+            case iWide: {
+                Instruction op = code[vm->instr_pointer++];
+                usize addr = decode_wide_address(code, &vm->instr_pointer);
+                switch (op) {
+                    case iCall:  _call(vm, addr);          break;
+                    case iJmpZ:  _jmp_z(vm, addr);         break;
+                    case iJmpNZ: _jmp_nz(vm, addr);        break;
+                    case iJmp:   vm->instr_pointer = addr; break;
+                    default: VM_UNREACHABLE(vm);
+                }
                 break;
             }
 
-            default: UNREACHABLE();
+            default: VM_UNREACHABLE(vm);
         }
     }
 }
@@ -3,6 +3,56 @@
 
 #include "linker.h"
 
-b32 run(LinkResult);
+typedef struct {
+    usize *items;
+    usize count;
+    usize capacity;
+} UsizeStack;
+
+// While profiling every call is counted by its target
+typedef struct {
+    usize address;
+    usize fn_idx; // into the program's functions
+    u64 calls;
+} CallCount;
+
+typedef struct {
+    CallCount *items; // sorted by address
+    usize count;
+    usize capacity;
+} CallCounts;
+
+// What print writes, handed to stdout in large blocks
+typedef struct {
+    byte *items;
+    usize count;
+    usize capacity;
+} OutBuffer;
+
+// Owned by the caller, so every thread can run its own programs.
+// A zeroed Vm is ready to use, it keeps its buffers between runs.
+typedef struct {
+    usize base_pointer;
+    usize instr_pointer;
+    ValueArray stack;
+    ValueArray constants;
+    byte *strings; // the constants' string bytes
+    ValueArray globals;
+    ValueArray locals;
+    UsizeStack return_stack;
+    UsizeStack base_stack;
+    UsizeStack top_stack;
+    b32 profile; // set before running to count calls per function
+    CallCounts calls;
+    b32 unbuffered; // set before running to write every print right away
+    OutBuffer out;  // written out when full, on halt and before the VM gives up
+} Vm;
+
+b32 run(Vm *vm, LinkResult *program);
+void free_vm(Vm *vm);
+
+// Writes the call counts of the last profiled run of 'program',
+// in the format load_profile() reads. Reports errors on stderr.
+b32 save_profile(Vm *vm, LinkResult *program, byte *path);
 
 #endif
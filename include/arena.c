@@ -0,0 +1,2 @@
+#define ARENA_IMPL
+#include "arena.h"
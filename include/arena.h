@@ -16,50 +16,184 @@
 #define alloc1_(a_ptr, t)               arena_alloc_(a_ptr, sizeof(t), alignof(t), 1)
 #define alloc2_(a_ptr, t, n)            arena_alloc_(a_ptr, sizeof(t), alignof(t), n)
 
+#define ARENA_MAX_CHUNK     (256 * 1024 * 1024)
+#define ARENA_DA_INIT_CAP   16
+
+// Chunks are chained through 'prev', the newest one is the one
+// allocations are served from.
+typedef struct ArenaChunk {
+    struct ArenaChunk *prev;
+    void *end;
+    void *cur;        // where allocations stopped, set once a newer chunk is pushed
+    isize size;
+    isize chunk_size; // the arena's chunk_size before this chunk was pushed
+    b32 mapped;
+} ArenaChunk;
+
+typedef struct {
+    isize used;      // bytes handed out, padding included
+    isize peak;      // highest 'used' seen
+    isize reserved;  // bytes held in chunks
+    isize chunks;
+} ArenaStats;
+
 typedef struct {
     void *cur, *end;
-    void *buffer;
+    ArenaChunk *chunk;
+    isize chunk_size; // size of the next chunk, doubles on every growth
+    ArenaStats stats;
 } Arena;
 
+// Marker for temporary allocations. Everything allocated after
+// scratch_begin is released by the matching scratch_end.
 typedef struct {
     Arena *arena;
     void *cur;
+    ArenaChunk *chunk;
+    isize used;
 } ScratchArena;
 
 Arena arena_init(isize alloc_size);
+Arena arena_reserve(isize reserve_size);
 void arena_free(Arena *arena);
 void arena_clear(Arena *arena);
 void *arena_alloc_(Arena *arena, isize size, isize align, isize n);
+void *arena_realloc_(Arena *arena, void *ptr, isize old_size, isize new_size, isize align);
+void arena_print_stats(ArenaStats *stats, const byte *name);
 
-// TODO 
+ScratchArena scratch_begin(Arena *arena);
+void scratch_end(ScratchArena scratch);
+
+// Same as da_append, but the items live in the arena. Growing the
+// most recent allocation happens in place.
+#define arena_da_append(a, da, item)                                                    \
+    do {                                                                                \
+        if ((da)->count >= (da)->capacity) {                                            \
+            usize new_cap_ = (da)->capacity ? (da)->capacity * 2 : ARENA_DA_INIT_CAP;   \
+            (da)->items = arena_realloc_((a), (da)->items,                              \
+                                         (da)->capacity * sizeof(*(da)->items),         \
+                                         new_cap_ * sizeof(*(da)->items),               \
+                                         alignof(max_align_t));                         \
+            if ((da)->items == NULL) {                                                  \
+                fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);          \
+                exit(-1);                                                               \
+            }                                                                           \
+            (da)->capacity = new_cap_;                                                  \
+        }                                                                               \
+        (da)->items[(da)->count++] = (item);                                            \
+    } while (0)
+
+// TODO
 // 1. Rework arena_alloc to work with default function arguments struct macro trick
-// 2. Add ScratchArena functionality
-// 3. Add helper function to check malloc in arena_init
+// 2. Add helper function to check malloc in arena_init
 //    or use DI and give buffer as an argument.
-// 4. arena_resize? Linked list approach?
 
 #ifdef ARENA_IMPL
 
+#include <sys/mman.h>
+
+static inline
+void _arena_push_chunk( Arena *arena, ArenaChunk *chunk, isize size, b32 mapped )
+{
+    if (arena->chunk) arena->chunk->cur = arena->cur;
+
+    chunk->prev = arena->chunk;
+    chunk->end = (byte *)(chunk + 1) + size;
+    chunk->cur = chunk + 1;
+    chunk->size = size;
+    chunk->chunk_size = arena->chunk_size;
+    chunk->mapped = mapped;
+
+    arena->chunk = chunk;
+    arena->cur = chunk + 1;
+    arena->end = chunk->end;
+
+    arena->stats.reserved += size;
+    arena->stats.chunks++;
+}
+
+static inline
+void _arena_pop_chunk( Arena *arena )
+{
+    ArenaChunk *chunk = arena->chunk;
+    arena->chunk = chunk->prev;
+    arena->stats.reserved -= chunk->size;
+    arena->stats.chunks--;
+
+    // Growing again after a scratch scope gets the same size back,
+    // repeated scopes must not keep doubling it. An oversized chunk
+    // does not change the size either.
+    arena->chunk_size = chunk->chunk_size;
+
+    if (chunk->mapped)
+        munmap( chunk, sizeof(ArenaChunk) + chunk->size );
+    else
+        free( chunk );
+}
+
+static inline
+b32 _arena_new_chunk( Arena *arena, isize min_size )
+{
+    isize size = arena->chunk_size;
+    if (size < min_size) size = min_size;
+
+    ArenaChunk *chunk = malloc( sizeof(ArenaChunk) + size );
+    if (chunk == NULL) return false;
+
+    _arena_push_chunk( arena, chunk, size, false );
+    if (arena->chunk_size < ARENA_MAX_CHUNK)
+        arena->chunk_size *= 2;
+    return true;
+}
+
 Arena arena_init( isize alloc_size )
 {
-    void *buffer = malloc( alloc_size );
+    Arena arena = { .chunk_size = alloc_size };
+    _arena_new_chunk( &arena, alloc_size );
+    return arena;
+}
 
-    Arena arena = {
-        .buffer = buffer,
-        .cur = buffer,
-        .end = buffer + alloc_size
-    };
+// Reserves address space up front and lets the OS back it with pages
+// on first touch. Only runs over into malloc'ed chunks once the whole
+// reservation is used up.
+Arena arena_reserve( isize reserve_size )
+{
+    Arena arena = { .chunk_size = reserve_size };
 
+    void *p = mmap( NULL, sizeof(ArenaChunk) + reserve_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if (p == MAP_FAILED) {
+        _arena_new_chunk( &arena, reserve_size );
+        return arena;
+    }
+
+    _arena_push_chunk( &arena, p, reserve_size, true );
     return arena;
 }
 
 void arena_free( Arena *arena )
-{ free( arena->buffer ); }
+{
+    while (arena->chunk) _arena_pop_chunk( arena );
+    *arena = (Arena) {0};
+}
 
+// Keeps only the first chunk around
 void arena_clear( Arena *arena )
 {
-    memset( arena->buffer, 0, (isize)(arena->cur - arena->buffer) );
-    arena->cur = arena->buffer;
+    if (arena->chunk == NULL) return;
+
+    void *used_end = arena->cur;
+    if (arena->chunk->prev) {
+        while (arena->chunk->prev) _arena_pop_chunk( arena );
+        used_end = arena->chunk->cur;
+    }
+
+    // Only the bytes handed out, untouched pages of a reservation
+    // stay untouched
+    memset( arena->chunk + 1, 0, used_end - (void *)(arena->chunk + 1) );
+    arena->cur = arena->chunk + 1;
+    arena->end = arena->chunk->end;
+    arena->stats.used = 0;
 }
 
 void *arena_alloc_( Arena *arena, isize size, isize align, isize n )
@@ -68,16 +202,73 @@ void *arena_alloc_( Arena *arena, isize size, isize align, isize n )
 
     isize available = arena->end - arena->cur - padding;
     if (available < 0 || n > available / size) {
-        fprintf(stderr, "arena: no memory\n");
-        return NULL;
+        if (n > (PTRDIFF_MAX - align) / size ||
+            !_arena_new_chunk( arena, n * size + align )) {
+            fprintf(stderr, "arena: no memory\n");
+            return NULL;
+        }
+        padding = -(uptr)arena->cur & (align - 1);
     }
 
     void *p = arena->cur + padding;
     arena->cur += padding + n * size;
 
+    arena->stats.used += padding + n * size;
+    if (arena->stats.peak < arena->stats.used)
+        arena->stats.peak = arena->stats.used;
+
     return p;
 }
 
+void *arena_realloc_( Arena *arena, void *ptr, isize old_size, isize new_size, isize align )
+{
+    if (ptr == NULL || old_size == 0)
+        return arena_alloc_( arena, 1, align, new_size );
+
+    if (new_size <= old_size)
+        return ptr;
+
+    // The last allocation can simply be extended
+    if (ptr + old_size == arena->cur && new_size - old_size <= arena->end - arena->cur) {
+        arena->cur += new_size - old_size;
+        arena->stats.used += new_size - old_size;
+        if (arena->stats.peak < arena->stats.used)
+            arena->stats.peak = arena->stats.used;
+        return ptr;
+    }
+
+    void *p = arena_alloc_( arena, 1, align, new_size );
+    if (p) memcpy( p, ptr, old_size );
+    return p;
+}
+
+// Takes the stats only, they can be kept after the arena is freed
+void arena_print_stats( ArenaStats *stats, const byte *name )
+{
+    fprintf(stderr, "arena %s: used %td, peak %td, reserved %td in %td chunk(s)\n",
+        name, stats->used, stats->peak, stats->reserved, stats->chunks);
+}
+
+ScratchArena scratch_begin( Arena *arena )
+{
+    return (ScratchArena) {
+        .arena = arena,
+        .cur = arena->cur,
+        .chunk = arena->chunk,
+        .used = arena->stats.used
+    };
+}
+
+void scratch_end( ScratchArena scratch )
+{
+    Arena *arena = scratch.arena;
+    while (arena->chunk != scratch.chunk) _arena_pop_chunk( arena );
+
+    arena->cur = scratch.cur;
+    arena->end = arena->chunk ? arena->chunk->end : NULL;
+    arena->stats.used = scratch.used;
+}
+
 #endif // ARENA_IMPL
 
 #endif // ARENA_INCLUDE
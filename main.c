@@ -1,93 +1,81 @@
 #include "types.h"
-#include "ast/scanner.h"
-#include "ast/parser.h"
-#include "ast/ast_printer.h"
-#include "ast/ast_checker.h"
-#include "converter/converter.h"
-#include "converter/debug.h"
-#include "converter/linker.h"
-#include "converter/vm.h"
+#include "ast/source.h"
+#include "converter/bytecode.h"
+#include "polo.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-static inline byte *_read_file(byte *path);
+static
+void _usage(byte *name) {
+    fprintf(stderr, "Usage: %s [--profile <out.prof>] [--unbuffered] [--arena-stats] <source-file | bytecode-file>\n", name);
+    fprintf(stderr, "       %s --compile <out.pbc> [--layout <in.prof>] <source-file>\n", name);
+}
 
 i32 main(i32 argc, byte *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <source-file>", argv[0]);
-        return -1;
+    byte *out_path = NULL;
+    byte *profile_path = NULL; // written after the run
+    byte *layout_path = NULL;  // read before linking
+
+    b32 unbuffered = false;    // prints are written right away
+    b32 arena_stats = false;   // of every module compiled, on stderr
+
+    // Options but --unbuffered and --arena-stats take a value, the
+    // file comes last
+    i32 arg = 1;
+    while (arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0) {
+        byte *option = argv[arg++];
+        if (strcmp(option, "--unbuffered") == 0)        unbuffered = true;
+        else if (strcmp(option, "--arena-stats") == 0) arena_stats = true;
+        else if (strcmp(option, "--compile") == 0)     out_path = argv[arg++];
+        else if (strcmp(option, "--profile") == 0)     profile_path = argv[arg++];
+        else if (strcmp(option, "--layout") == 0)      layout_path = argv[arg++];
+        else {
+            arg--;
+            break;
+        }
     }
-
-    byte *file_name = argv[1];
-    byte *source = _read_file(file_name);
-
-    ScanResult scan_result = scan(source);
-    if (scan_result.error) {
+    if (arg != argc - 1 || (out_path != NULL && profile_path != NULL)) {
+        _usage(argv[0]);
         return -1;
     }
 
-    // pretty_print_tokens(scan_result.tokens);
-
-    ParseResult parse_result = parse(scan_result.tokens);
-    if (parse_result.error) {
+    byte *file_name = argv[arg];
+    usize source_size;
+    byte *source = map_source(file_name, &source_size);
+    if (source == NULL) {
         return -1;
     }
 
-    // print_ast(parse_result.program, 0);
-
-    if (semantic_errors(parse_result.program)) {
+    // Bytecode files are recognized by their header, whatever their name.
+    // Plain runs go through the compile cache.
+    PoloOptions options = {
+        .path = file_name,
+        .cache = out_path == NULL,
+        .profile_path = layout_path,
+        .arena_stats = arena_stats
+    };
+    PoloProgram *program;
+    if (is_bytecode(source)) program = polo_load(file_name);
+    else                     program = polo_compile_with(source, &options);
+
+    // The program does not point into the source
+    unmap_source(source, source_size);
+
+    if (program == NULL) {
         return -1;
     }
 
-    ConversionResult conv_result = convert(parse_result.program);
-    // disassemble(conv_result, "resolved before calling 'main'");
-
-    LinkResult link_result = link(conv_result);
-    if (link_result.error) {
-        return -1;
+    if (out_path != NULL) {
+        b32 saved = polo_save(program, out_path);
+        polo_free(program);
+        return saved ? 0 : -1;
     }
-    
-    // print_link(link_result);
-    
-    // scanner is freed
-    free(source);
-    free(scan_result.tokens.items);
-
-    // ast is freed
-    free_ast(parse_result.program);
 
-    // DS from converter are freed in linker.
-    // DS from linker live as long as the vm runs.
-
-    run(link_result);
-    return 0;
-}
-
-static inline 
-byte *_read_file(byte *path) {
-    FILE *file = fopen(path, "rb");
-    if (file == NULL) {
-        fprintf(stderr, "Could not open file \"%s\".\n", path);
-        exit(-1);
-    }
-
-    fseek(file, 0L, SEEK_END);
-    usize file_size = ftell(file);
-    rewind(file);
-
-    byte *buffer = malloc(file_size + 1);
-    if (buffer == NULL) {
-        fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
-        exit(-1);
-    }
-    
-    usize bytes_read = fread(buffer, sizeof(char), file_size, file);
-    if (bytes_read < file_size) {
-        fprintf(stderr, "Could not read file \"%s\".\n", path);
-        exit(-1);
-    }
-    
-    buffer[bytes_read] = '\0';
-    fclose(file);
-    return buffer;
+    Vm vm = { .profile = profile_path != NULL, .unbuffered = unbuffered };
+    polo_run(program, &vm);
+    b32 saved = profile_path == NULL || polo_save_profile(program, &vm, profile_path);
+    polo_free_vm(&vm);
+    polo_free(program);
+    return saved ? 0 : -1;
 }
@@ -0,0 +1,611 @@
+#include "polo.h"
+#include "ast/parser.h"
+#include "ast/ast_printer.h"
+#include "ast/ast_checker.h"
+#include "ast/special_nodes.h"
+#include "ast/source.h"
+#include "converter/converter.h"
+#include "converter/debug.h"
+#include "converter/optimizer.h"
+#include "converter/bytecode.h"
+#include "converter/object.h"
+#include "da.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define POLO_PATH_MAX 4096
+
+static
+PoloProgram *_new_program(LinkResult code) {
+    PoloProgram *program = malloc(sizeof(*program));
+    if (program == NULL) {
+        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+        exit(-1);
+    }
+    program->code = code;
+    return program;
+}
+
+static
+u64 _fnv1a(u64 h, byte *data, usize len) {
+    for (usize i = 0; i < len; ++i) {
+        h ^= (u8)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// The versions go in first, so a new compiler never picks up
+// what an old one stored. Imports resolve relative to the file, so the
+// same source means another program somewhere else and 'path' goes in
+// too.
+static
+u64 _cache_key(byte *path, byte *source, usize len) {
+    byte version[64];
+    i32 n = snprintf(version, sizeof(version), "%s/%d/%d", POLO_VERSION, BYTECODE_VERSION, OBJECT_VERSION);
+    u64 h = _fnv1a(14695981039346656037ull, version, n);
+    h = _fnv1a(h, path, strlen(path) + 1);
+    return _fnv1a(h, source, len);
+}
+
+// Empty if there is no usable directory
+static
+void _default_cache_dir(byte *dir) {
+    byte *env = getenv("POLO_CACHE_DIR");
+    if (env != NULL) {
+        snprintf(dir, POLO_PATH_MAX, "%s", env);
+    } else if ((env = getenv("XDG_CACHE_HOME")) != NULL && *env) {
+        snprintf(dir, POLO_PATH_MAX, "%s/polo", env);
+    } else if ((env = getenv("HOME")) != NULL && *env) {
+        snprintf(dir, POLO_PATH_MAX, "%s/.cache/polo", env);
+    } else {
+        dir[0] = '\0';
+    }
+}
+
+// mkdir -p
+static
+b32 _make_dirs(byte *dir) {
+    byte path[POLO_PATH_MAX];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (byte *c = path + 1; *c; ++c) {
+        if (*c != '/') continue;
+        *c = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) return false;
+        *c = '/';
+    }
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+typedef b32 (*CacheWriter)(void *data, FILE *f);
+
+// Written under a temporary name and renamed into place, so other
+// processes either see the whole file or none at all
+static
+void _store_cached(byte *dir, byte *path, CacheWriter write, void *data) {
+    if (!_make_dirs(dir)) return;
+
+    byte tmp[POLO_PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (i32)sizeof(tmp)) return;
+
+    i32 fd = mkstemp(tmp);
+    if (fd < 0) return;
+    FILE *f = fdopen(fd, "wb");
+    b32 written = f != NULL && write(data, f);
+    if (f == NULL || fclose(f) != 0) written = false;
+
+    if (!written || rename(tmp, path) != 0) remove(tmp);
+}
+
+// False if the path does not fit
+static
+b32 _cache_path(byte *path, byte *dir, u64 key, usize len, byte *ext) {
+    i32 n = snprintf(path, POLO_PATH_MAX, "%s/%016llx-%zu.%s",
+                     dir, (unsigned long long)key, len, ext);
+    return n < POLO_PATH_MAX;
+}
+
+static inline
+void _import_error(const byte *fmt, ...) {
+    fprintf(stderr, "Import error: ");
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+// Every imported module is compiled, or loaded from the cache, once
+// per program. Names and strings of a module point into its text until
+// the program is linked.
+typedef struct {
+    byte *path;     // resolved, so a module is found under any name
+    u64 key;        // of its path and source, see _cache_key()
+    byte *text;     // mapped source or loaded object
+    usize text_size;
+    b32 mapped;
+    ConversionResult conv;
+    u64 interface;
+    ImportedFunctions exports;
+    b32 done;       // false while its own imports are compiled
+} Module;
+
+typedef struct {
+    Module *items;
+    usize count;
+    usize capacity;
+} Modules;
+
+typedef struct {
+    usize *items;
+    usize count;
+    usize capacity;
+} ModuleList;
+
+// The program itself is a module too, unless it has no file. It is
+// never in 'order', it is linked last.
+typedef struct {
+    Modules modules;
+    ModuleList order;    // imports before their importers, the link order
+    ModuleList stack;    // modules whose imports are being compiled
+    byte *cache_dir;     // NULL if nothing is cached
+    b32 import_failed;   // already reported, importers stay quiet
+    b32 arena_stats;     // see PoloOptions
+} Build;
+
+static isize _import(Build *build, byte *path);
+
+// Functions with a body, 'main' stays with its module
+static
+ImportedFunctions _exports(ConversionResult *conv) {
+    ImportedFunctions exports = {0};
+    for (usize i = 0; i < conv->functions.count; ++i) {
+        FunctionSymbol *fn = &conv->functions.items[i];
+        if (fn->external || fn->sym == SYM_MAIN || fn->instructions.count == 0) continue;
+
+        ImportedFunction export = {
+            .name = fn->name,
+            .return_type = fn->return_type,
+            .param_types = conv->param_types.items + fn->param_start,
+            .param_count = fn->param_count
+        };
+        da_append(&exports, export);
+    }
+    return exports;
+}
+
+// Imports are relative to the directory of the importing file
+static
+b32 _import_path(byte *out, byte *importer, s8 path) {
+    usize dir_len = 0;
+    if (importer != NULL && path.len > 0 && path.s[0] != '/') {
+        byte *slash = strrchr(importer, '/');
+        if (slash != NULL) dir_len = slash - importer + 1;
+    }
+    i32 n = snprintf(out, POLO_PATH_MAX, "%.*s%.*s", (i32)dir_len, importer, (i32)path.len, path.s);
+    return n < POLO_PATH_MAX;
+}
+
+static
+void _free_imports(Imports *imports) {
+    for (usize i = 0; i < imports->count; ++i) da_free(imports->items[i]);
+    da_free(*imports);
+}
+
+// Compiles one module, its imports are compiled first. 'path' is
+// where the source came from, NULL for a program without a file.
+static
+b32 _compile_module(Build *build, byte *source, byte *path, ConversionResult *conv, ModuleImports *deps) {
+    SymbolTable symbols = {0};
+    Imports imports = {0};
+    *deps = (ModuleImports) {0};
+
+    ParseResult parse_result = parse(source, &symbols);
+    // print_ast(&parse_result.ast, parse_result.ast.root, 0);
+    Ast *ast = &parse_result.ast;
+    b32 ok = !parse_result.error;
+
+    AstNodeArray decls = ok ? get_program_node(ast, ast->root).declarations : (AstNodeArray) {0};
+    for (usize i = 0; ok && i < decls.count; ++i) {
+        if (ast_type(ast, decls.items[i]) != AST_IMPORT) continue;
+
+        // The token keeps its quotes
+        s8 name = token_str(ast, get_import_node(ast, decls.items[i]).path);
+        name = s8(name.s + 1, name.len - 2);
+        byte import_path[POLO_PATH_MAX];
+        if (!_import_path(import_path, path, name)) {
+            _import_error("path \"%.*s\" is too long", (i32)name.len, name.s);
+            build->import_failed = true;
+            ok = false;
+            break;
+        }
+
+        isize m = _import(build, import_path);
+        if (m < 0) {
+            build->import_failed = true;
+            ok = false;
+            break;
+        }
+
+        // Every importer gets its own copy, the checker fills in indices
+        Module *module = &build->modules.items[m];
+        ImportedFunctions functions = {0};
+        for (usize j = 0; j < module->exports.count; ++j) {
+            ImportedFunction fn = module->exports.items[j];
+            fn.sym = intern(&symbols, fn.name);
+            da_append(&functions, fn);
+        }
+        da_append(&imports, functions);
+
+        ModuleImport dep = { .path = s8(module->path, strlen(module->path)), .interface = module->interface };
+        da_append(deps, dep);
+    }
+
+    ArenaStats checker_stats = {0};
+    if (ok && !semantic_errors(ast, &imports, &checker_stats)) {
+        *conv = convert(ast, &imports);
+        optimize_jumps(conv);
+        // disassemble(*conv, "resolved before calling 'main'");
+        ok = !conv->error;
+        if (build->arena_stats) {
+            fprintf(stderr, "%s:\n", path != NULL ? path : "<source>");
+            arena_print_stats(&parse_result.scratch, "parser");
+            arena_print_stats(&checker_stats, "checker");
+            arena_print_stats(&conv->scratch, "converter");
+        }
+        if (!ok) free_object(conv, &(ModuleImports) {0});
+    } else {
+        ok = false;
+    }
+
+    // Nothing converted points into the ast or the symbols
+    _free_imports(&imports);
+    free_ast(ast);
+    free_symbols(&symbols);
+    if (!ok) da_free(*deps);
+    return ok;
+}
+
+typedef struct {
+    ConversionResult *conv;
+    ModuleImports *deps;
+} ObjectToStore;
+
+static
+b32 _write_object(void *data, FILE *f) {
+    ObjectToStore *object = data;
+    return write_object(object->conv, object->deps, f);
+}
+
+static
+b32 _write_program(void *data, FILE *f) {
+    return write_bytecode(data, f);
+}
+
+// A cached object is only used while the modules it imports still
+// define the same functions. Its imports are the ones of its source,
+// so they are brought in either way.
+static
+i32 _load_cached(Build *build, usize m, byte *object_path) {
+    struct stat st;
+    if (stat(object_path, &st) != 0) return 0;
+
+    ConversionResult conv;
+    ModuleImports deps;
+    byte *text;
+    if (!load_object(object_path, &conv, &deps, &text)) return 0;
+
+    i32 result = 1;
+    for (usize i = 0; i < deps.count; ++i) {
+        isize dep = _import(build, deps.items[i].path.s);
+        if (dep < 0) {
+            result = -1;
+            break;
+        }
+        if (build->modules.items[dep].interface != deps.items[i].interface) result = 0;
+    }
+
+    if (result != 1) {
+        free_object(&conv, &deps);
+        free(text);
+        return result;
+    }
+
+    Module *module = &build->modules.items[m];
+    module->conv = conv;
+    module->text = text;
+    da_free(deps);
+    return 1;
+}
+
+static
+void _report_cycle(Build *build, usize m) {
+    usize from = build->stack.count - 1;
+    while (build->stack.items[from] != m) from--;
+
+    fprintf(stderr, "Import error: cycle ");
+    for (usize i = from; i < build->stack.count; ++i)
+        fprintf(stderr, "\"%s\" -> ", build->modules.items[build->stack.items[i]].path);
+    fprintf(stderr, "\"%s\"\n", build->modules.items[m].path);
+}
+
+// The index of the module, -1 after an error
+static
+isize _import(Build *build, byte *path) {
+    byte *real = realpath(path, NULL);
+    if (real == NULL) {
+        _import_error("could not open \"%s\"", path);
+        return -1;
+    }
+
+    for (usize i = 0; i < build->modules.count; ++i) {
+        if (strcmp(build->modules.items[i].path, real) != 0) continue;
+        free(real);
+        if (!build->modules.items[i].done) {
+            _report_cycle(build, i);
+            return -1;
+        }
+        return i;
+    }
+
+    usize size;
+    byte *source = map_source(real, &size);
+    if (source == NULL) {
+        _import_error("could not import \"%s\"", path);
+        free(real);
+        return -1;
+    }
+
+    usize m = build->modules.count;
+    usize len = strlen(source);
+    u64 key = _cache_key(real, source, len);
+    da_append(&build->modules, ((Module) { .path = real, .key = key }));
+    da_append(&build->stack, m);
+
+    byte object_path[POLO_PATH_MAX];
+    b32 cached = build->cache_dir != NULL && _cache_path(object_path, build->cache_dir, key, len, "pob");
+    i32 loaded = cached ? _load_cached(build, m, object_path) : 0;
+
+    if (loaded == 1) {
+        unmap_source(source, size);
+    } else {
+        ConversionResult conv;
+        ModuleImports deps;
+        if (loaded < 0 || !_compile_module(build, source, real, &conv, &deps)) {
+            // Errors of modules do not tell which file they are in
+            if (!build->import_failed) _import_error("in \"%s\"", real);
+            unmap_source(source, size);
+            build->stack.count--;
+            return -1;
+        }
+        if (cached) _store_cached(build->cache_dir, object_path, _write_object, &(ObjectToStore) { &conv, &deps });
+        da_free(deps);
+
+        Module *module = &build->modules.items[m];
+        module->conv = conv;
+        module->text = source;
+        module->text_size = size;
+        module->mapped = true;
+    }
+
+    Module *module = &build->modules.items[m];
+    module->interface = object_interface(&module->conv);
+    module->exports = _exports(&module->conv);
+    module->done = true;
+    build->stack.count--;
+    da_append(&build->order, m);
+    return m;
+}
+
+static
+void _free_build(Build *build) {
+    for (usize i = 0; i < build->modules.count; ++i) {
+        Module *module = &build->modules.items[i];
+        free_object(&module->conv, &(ModuleImports) {0});
+        if (module->mapped) unmap_source(module->text, module->text_size);
+        else free(module->text);
+        da_free(module->exports);
+        free(module->path);
+    }
+    da_free(build->modules);
+    da_free(build->order);
+    da_free(build->stack);
+}
+
+// Modules that were not linked yet are freed with the build
+static
+LinkResult _link(Build *build, ConversionResult conv, Profile *profile) {
+    ConversionResult *objects = malloc((build->order.count + 1) * sizeof(*objects));
+    if (objects == NULL) {
+        fprintf(stderr, "Buy more RAM, %s, %d\n", __FILE__, __LINE__);
+        exit(-1);
+    }
+    for (usize i = 0; i < build->order.count; ++i) {
+        Module *module = &build->modules.items[build->order.items[i]];
+        objects[i] = module->conv;
+        module->conv = (ConversionResult) {0};
+    }
+    objects[build->order.count] = conv;
+
+    LinkResult result = link(objects, build->order.count + 1, profile);
+    free(objects);
+    return result;
+}
+
+// A cached program depends on the sources of all modules it imports.
+// Their keys go into the key of the program, so a program is only ever
+// found next to the sources it was compiled from. Which modules those
+// are is listed under the key of the program's own source, whichever
+// run wrote the list last.
+static inline
+u64 _program_key(u64 key, u64 module_key) {
+    return _fnv1a(key, (byte *)&module_key, sizeof(module_key));
+}
+
+static
+b32 _write_deps(void *data, FILE *f) {
+    Build *build = data;
+    for (usize i = 0; i < build->order.count; ++i) {
+        Module *module = &build->modules.items[build->order.items[i]];
+        if (fprintf(f, "%s\n", module->path) < 0) return false;
+    }
+    return true;
+}
+
+// The key of the program compiled from the sources as they are now,
+// false if one of them can not be read
+static
+b32 _deps_key(byte *deps_path, u64 key, u64 *program_key) {
+    *program_key = key;
+    FILE *f = fopen(deps_path, "r");
+    if (f == NULL) return errno == ENOENT;
+
+    b32 read = true;
+    byte path[POLO_PATH_MAX];
+    while (read && fscanf(f, "%4095[^\n]\n", path) == 1) {
+        FILE *source = fopen(path, "rb");
+        if (source == NULL) {
+            read = false;
+            break;
+        }
+
+        struct {
+            byte *items;
+            usize count;
+            usize capacity;
+        } text = {0};
+        byte buf[4096];
+        usize n;
+        while ((n = fread(buf, 1, sizeof(buf), source)) > 0) da_append_many(&text, buf, n);
+        read = !ferror(source);
+        fclose(source);
+
+        *program_key = _program_key(*program_key, _cache_key(path, text.items, text.count));
+        da_free(text);
+    }
+    fclose(f);
+    return read;
+}
+
+PoloProgram *polo_compile_with(byte *source, PoloOptions *options) {
+    byte dir[POLO_PATH_MAX] = "";
+    if (options->cache && options->cache_dir != NULL) snprintf(dir, sizeof(dir), "%s", options->cache_dir);
+    else if (options->cache) _default_cache_dir(dir);
+
+    // Without a file imports are relative to the working directory.
+    // A path that does not resolve is used as it is.
+    byte *real = realpath(options->path != NULL ? options->path : ".", NULL);
+    byte *path = options->path != NULL && real != NULL ? real : options->path;
+    byte *base = real != NULL ? real : options->path != NULL ? options->path : "";
+
+    // A profile changes the layout, such programs are not cached.
+    // Their modules still are.
+    usize len = strlen(source);
+    u64 key = _cache_key(base, source, len);
+    byte program_path[POLO_PATH_MAX], deps_path[POLO_PATH_MAX];
+    b32 cached = dir[0] != '\0' && options->profile_path == NULL &&
+                 _cache_path(deps_path, dir, key, len, "deps");
+
+    u64 program_key;
+    struct stat st;
+    if (cached && _deps_key(deps_path, key, &program_key) &&
+        _cache_path(program_path, dir, program_key, len, "pbc") && stat(program_path, &st) == 0) {
+        LinkResult code;
+        if (load_cached_bytecode(program_path, &code)) {
+            free(real);
+            return _new_program(code);
+        }
+    }
+
+    Profile profile;
+    if (options->profile_path != NULL && !load_profile(options->profile_path, &profile)) {
+        free(real);
+        return NULL;
+    }
+
+    // The program is registered first, so importing it again is
+    // found to be a cycle. The build owns its path from here on.
+    Build build = {
+        .cache_dir = dir[0] != '\0' ? dir : NULL,
+        .arena_stats = options->arena_stats
+    };
+    if (path != NULL && path == real) {
+        da_append(&build.modules, ((Module) { .path = real, .key = key }));
+        da_append(&build.stack, 0);
+    } else {
+        free(real);
+    }
+
+    ConversionResult conv;
+    ModuleImports deps;
+    LinkResult link_result = { .error = true };
+    if (_compile_module(&build, source, path, &conv, &deps)) {
+        da_free(deps);
+        // DS from converter are freed in linker
+        link_result = _link(&build, conv, options->profile_path != NULL ? &profile : NULL);
+        // print_link(link_result);
+    }
+
+    if (options->profile_path != NULL) free_profile(&profile);
+    if (link_result.error) {
+        _free_build(&build);
+        return NULL;
+    }
+
+    PoloProgram *program = _new_program(link_result);
+    if (cached) {
+        program_key = key;
+        for (usize i = 0; i < build.order.count; ++i)
+            program_key = _program_key(program_key, build.modules.items[build.order.items[i]].key);
+
+        if (build.order.count > 0) _store_cached(dir, deps_path, _write_deps, &build);
+        if (_cache_path(program_path, dir, program_key, len, "pbc"))
+            _store_cached(dir, program_path, _write_program, &program->code);
+    }
+    _free_build(&build);
+    return program;
+}
+
+PoloProgram *polo_compile(byte *source) {
+    return polo_compile_with(source, &(PoloOptions) {0});
+}
+
+PoloProgram *polo_compile_profiled(byte *source, byte *profile_path) {
+    return polo_compile_with(source, &(PoloOptions) { .profile_path = profile_path });
+}
+
+PoloProgram *polo_compile_cached(byte *source, byte *cache_dir) {
+    return polo_compile_with(source, &(PoloOptions) { .cache = true, .cache_dir = cache_dir });
+}
+
+void polo_free(PoloProgram *program) {
+    if (program == NULL) return;
+    free_link(&program->code);
+    free(program);
+}
+
+b32 polo_save(PoloProgram *program, byte *path) {
+    return save_bytecode(&program->code, path);
+}
+
+PoloProgram *polo_load(byte *path) {
+    LinkResult code;
+    if (!load_bytecode(path, &code)) return NULL;
+    return _new_program(code);
+}
+
+b32 polo_run(PoloProgram *program, Vm *vm) {
+    return run(vm, &program->code);
+}
+
+void polo_free_vm(Vm *vm) {
+    free_vm(vm);
+}
+
+b32 polo_save_profile(PoloProgram *program, Vm *vm, byte *path) {
+    return save_profile(vm, &program->code, path);
+}
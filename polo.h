@@ -0,0 +1,66 @@
+#ifndef POLO_INCLUDE
+#define POLO_INCLUDE
+
+#include "types.h"
+#include "converter/linker.h"
+#include "converter/vm.h"
+
+// Part of the compile cache key. Bump it whenever the compiler
+// starts producing different code for the same source.
+#define POLO_VERSION "0.6"
+
+// Only these functions are exported from libpolo.so
+#define POLO_API __attribute__((visibility("default")))
+
+// A compiled and linked program. It does not point into the source,
+// so the source may be freed right after compiling. The same program
+// can be run any number of times, also from several threads at once
+// as long as every thread has its own Vm.
+typedef struct {
+    LinkResult code;
+} PoloProgram;
+
+// 'source' is '\0'-terminated. Imports are looked up relative to
+// the working directory, see polo_compile_with(). Errors are reported on stderr,
+// NULL is returned if there were any.
+POLO_API PoloProgram *polo_compile(byte *source);
+POLO_API void polo_free(PoloProgram *program);
+
+// Lays out the functions that were called most in a profiling run
+// next to each other, see polo_save_profile()
+POLO_API PoloProgram *polo_compile_profiled(byte *source, byte *profile_path);
+
+// Bytecode files skip the whole front end, see converter/bytecode.h.
+// polo_load() returns NULL if the file can not be used.
+POLO_API b32 polo_save(PoloProgram *program, byte *path);
+POLO_API PoloProgram *polo_load(byte *path);
+
+// Same as polo_compile(), but looks in a cache directory first, keyed
+// by a hash of the source and POLO_VERSION. A miss is compiled and
+// stored. NULL 'cache_dir' means $POLO_CACHE_DIR, then
+// $XDG_CACHE_HOME/polo, then $HOME/.cache/polo. An empty
+// $POLO_CACHE_DIR turns the cache off.
+POLO_API PoloProgram *polo_compile_cached(byte *source, byte *cache_dir);
+
+// Everything the other compile functions do in one. A zeroed
+// PoloOptions is the same as polo_compile().
+typedef struct {
+    byte *path;         // the source file, imports are relative to its directory
+    b32 cache;          // see polo_compile_cached(), imported modules are cached too
+    byte *cache_dir;
+    byte *profile_path; // see polo_compile_profiled()
+    b32 arena_stats;    // printed to stderr for every module compiled
+} PoloOptions;
+
+POLO_API PoloProgram *polo_compile_with(byte *source, PoloOptions *options);
+
+// A zeroed Vm is ready to use. Running resets it, the buffers it
+// grew during earlier runs are kept.
+POLO_API b32 polo_run(PoloProgram *program, Vm *vm);
+POLO_API void polo_free_vm(Vm *vm);
+
+// After a run with 'vm->profile' set, writes how often every
+// function was called
+POLO_API b32 polo_save_profile(PoloProgram *program, Vm *vm, byte *path);
+
+#endif